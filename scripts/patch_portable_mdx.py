@@ -1,5 +1,7 @@
 Import("env")
 
+import re
+import sys
 from pathlib import Path
 
 
@@ -40,6 +42,104 @@ def _patch_psram_alloc(path: Path) -> None:
     path.write_text(text, encoding="utf-8")
 
 
+_OPM_HOOK_DECL = (
+    "\n// PATCH_OPM_WRITE_HOOK: OPM への書き込みを外から覗く/書き換える（firmware 側が定義）\n"
+    "#include <stdint.h>\n"
+    "#ifdef __cplusplus\n"
+    "extern \"C\" {\n"
+    "#endif\n"
+    "extern uint8_t (*portable_mdx_opm_write_hook)(void* user, uint8_t reg, uint8_t data);\n"
+    "extern void* portable_mdx_opm_write_hook_user;\n"
+    "extern const int portable_mdx_opm_write_hook_patched;\n"
+    "const int portable_mdx_opm_write_hook_patched = 1;\n"
+    "#ifdef __cplusplus\n"
+    "}\n"
+    "#endif\n"
+)
+
+_OPMSET_RE = re.compile(
+    r"\b_iocs_opmset\s*\(\s*MxdrvContext\s*\*\s*\w+\s*,"
+    r"\s*[\w ]*?\b(\w+)\s*,\s*[\w ]*?\b(\w+)\s*\)\s*\{"
+)
+
+
+# どちらも当たった（当たっている）ら True。外れたら ymfm が X68Sound に黙って戻るので、ビルドを止める
+def _patch_opm_write_hook(src_dir: Path) -> bool:
+    if not src_dir.exists():
+        return False
+    for path in sorted(src_dir.rglob("*.cpp")):
+        try:
+            text = path.read_text(encoding="utf-8")
+        except (OSError, UnicodeDecodeError):
+            continue
+        if "PATCH_OPM_WRITE_HOOK" in text:
+            return True
+        m = _OPMSET_RE.search(text)
+        if not m:
+            continue
+        reg, data = m.group(1), m.group(2)
+        call = (
+            "\n\tif (portable_mdx_opm_write_hook) {\n"
+            f"\t\t{data} = portable_mdx_opm_write_hook(portable_mdx_opm_write_hook_user, "
+            f"(uint8_t)({reg}), (uint8_t)({data}));\n"
+            "\t}\n"
+        )
+        # 定義の直前の行頭に宣言を置く（static 等の修飾子ごと）
+        line_start = text.rfind("\n", 0, m.start()) + 1
+        text = text[:m.end()] + call + text[m.end():]
+        text = text[:line_start] + _OPM_HOOK_DECL + "\n" + text[line_start:]
+        path.write_text(text, encoding="utf-8")
+        return True
+    return False
+
+
+_OPM_BYPASS_DECL = (
+    "\n// PATCH_OPM_BYPASS: 書き込みフックが入っている間（ymfm で OPM を鳴らしている間）は\n"
+    "// X68Sound の OPM オペレータを回さない（PCM8 / ADPCM とタイマはそのまま）\n"
+    "#ifndef PATCH_OPM_BYPASS_DECL\n"
+    "#define PATCH_OPM_BYPASS_DECL\n"
+    "#include <stdint.h>\n"
+    "#ifdef __cplusplus\n"
+    "extern \"C\" {\n"
+    "#endif\n"
+    "extern uint8_t (*portable_mdx_opm_write_hook)(void* user, uint8_t reg, uint8_t data);\n"
+    "extern const int portable_mdx_opm_bypass_patched;\n"
+    "extern __attribute__((weak)) const int portable_mdx_opm_bypass_patched = 1;\n"
+    "#ifdef __cplusplus\n"
+    "}\n"
+    "#endif\n"
+    "#endif\n"
+)
+
+# X68Sound の 1サンプル毎の OPM 8ch ループ（for (slot = 0; slot < 8; ...) { op[slot][0].Output... }）
+_OPM_SLOT_LOOP_RE = re.compile(
+    r"for\s*\(\s*(?:int\s+)?(\w+)\s*=\s*0\s*;\s*\1\s*<\s*8\s*;[^)]*\)"
+    r"(?=\s*\{[^{}]*\bop\s*\[\s*\1\s*\]\s*\[\s*0\s*\]\s*\.\s*Output)"
+)
+
+
+def _patch_opm_bypass(src_dir: Path) -> bool:
+    if not src_dir.exists():
+        return False
+    done = False
+    for path in sorted(src_dir.rglob("*")):
+        if path.suffix not in (".h", ".hpp", ".cpp") or "x68sound" not in str(path).lower():
+            continue
+        try:
+            text = path.read_text(encoding="utf-8")
+        except (OSError, UnicodeDecodeError):
+            continue
+        if "PATCH_OPM_BYPASS" in text:
+            done = True
+            continue
+        text, n = _OPM_SLOT_LOOP_RE.subn(lambda m: "if (!portable_mdx_opm_write_hook) " + m.group(0), text)
+        if n == 0:
+            continue
+        path.write_text(_OPM_BYPASS_DECL + "\n" + text, encoding="utf-8")
+        done = True
+    return done
+
+
 def patch_portable_mdx(*_args, **_kwargs):
     project_dir = Path(env["PROJECT_DIR"])
     libdeps_dir = project_dir / ".pio" / "libdeps"
@@ -51,6 +151,16 @@ def patch_portable_mdx(*_args, **_kwargs):
         if not pm_dir.exists():
             continue
         _patch_psram_alloc(pm_dir / "src" / "mxdrv" / "mxdrv_context.cpp")
+        failed = [name for name, ok in (
+            ("_iocs_opmset write hook", _patch_opm_write_hook(pm_dir / "src")),
+            ("X68Sound OPM slot-loop bypass", _patch_opm_bypass(pm_dir / "src")),
+        ) if not ok]
+        if failed:
+            sys.stderr.write(
+                "patch_portable_mdx.py: pattern not found in %s: %s\n"
+                "  (portable_mdx differs from the commit pinned in platformio.ini; update the patterns)\n"
+                % (pm_dir, ", ".join(failed)))
+            env.Exit(1)
 
 
 patch_portable_mdx()
@@ -0,0 +1,330 @@
+#!/usr/bin/env python3
+"""Convert .vgm/.vgz to the compact .vgc format played by the firmware.
+
+    python scripts/vgm2vgc.py data/song.vgz            # -> data/song.vgc
+    python scripts/vgm2vgc.py data/*.vgz -o out/ --remove-source
+
+The format is described in src/vgm/vgc_format.hpp. Only chips the firmware
+plays are kept (YM2203 / dual YM2203, YM2608, AY8910, SN76489); writes to
+other chips and unused data blocks are dropped.
+"""
+
+import argparse
+import gzip
+import struct
+import sys
+from collections import Counter
+from pathlib import Path
+
+# VGMChipId (src/vgm/vgm_chips.hpp)
+YM2203, YM2608, AY8910, SN76489, YM2203_2 = 0, 1, 2, 3, 4
+PORT_SHIFT = 4
+
+BLOCK_YM2608_ADPCM_B = 0x81
+
+HEADER_SIZE = 0x48
+MAX_PAIRS = 128
+TOK_WRITE = 0x80
+TOK_WAIT_SHORT_MAX = 0xBF
+TOK_WAIT_735 = 0xC0
+TOK_WAIT_882 = 0xC1
+TOK_WAIT_VAR = 0xC2
+TOK_END = 0xFF
+
+
+def u32(d, off):
+    return struct.unpack_from("<I", d, off)[0] if off + 4 <= len(d) else 0
+
+
+def cmd_length(c):
+    """Bytes including the opcode, for commands that are skipped."""
+    if 0x30 <= c <= 0x3F or c in (0x4F, 0x50, 0x94):
+        return 2
+    if 0x40 <= c <= 0x5F or 0xA0 <= c <= 0xBF or c == 0x61:
+        return 3
+    if 0xC0 <= c <= 0xDF:
+        return 4
+    if c >= 0xE0 or c in (0x90, 0x91, 0x95):
+        return 5
+    if c == 0x92:
+        return 6
+    if c == 0x93:
+        return 11
+    if c == 0x68:
+        return 12
+    if c in (0x62, 0x63, 0x66) or 0x70 <= c <= 0x8F:
+        return 1
+    return 0
+
+
+def dedupable(chip, port, reg):
+    """Registers whose write has no side effect beyond storing the value."""
+    if chip == SN76489:
+        return False  # latch protocol
+    if chip == AY8910:
+        return reg <= 0x0C  # 0x0D restarts the envelope
+    if port == 0 and reg <= 0x0C:
+        return True  # SSG part of OPN
+    # FM operator/channel parameters. 0x28 key, timers and the 0xA0-0xAF
+    # fnum latch pair always stay.
+    return 0x30 <= reg <= 0x9F or 0xB0 <= reg <= 0xB6
+
+
+def gd3_strings(d, off):
+    if off == 0 or off + 12 > len(d) or d[off:off + 4] != b"Gd3 ":
+        return [""] * 4
+    size = u32(d, off + 8)
+    body = d[off + 12:off + 12 + size]
+    fields = body.decode("utf-16-le", errors="replace").split("\x00")
+    fields += [""] * (11 - len(fields))
+    # track en, track jp, game en, author en
+    return [fields[0], fields[1], fields[2], fields[6]]
+
+
+def parse(d):
+    if d[:4] != b"Vgm ":
+        raise ValueError("not a VGM file")
+    rel = u32(d, 0x34)
+    data_start = 0x40 if rel == 0 else 0x34 + rel
+
+    def clock(off):
+        return u32(d, off) & 0x7FFFFFFF if off + 4 <= data_start else 0
+
+    clocks = {
+        "ym2203": clock(0x44),
+        "ym2608": clock(0x48),
+        "ay8910": clock(0x74),
+        "sn76489": clock(0x0C),
+    }
+    present = set()
+    if clocks["ym2203"]:
+        present.add(YM2203)
+        if clocks["ym2203"] & 0x40000000:
+            present.add(YM2203_2)
+    if clocks["ym2608"]:
+        present.add(YM2608)
+    if clocks["ay8910"]:
+        present.add(AY8910)
+    if clocks["sn76489"]:
+        present.add(SN76489)
+    sn_fb = d[0x28:0x2B] if data_start >= 0x2B else b"\x00\x00\x00"
+
+    loop_rel = u32(d, 0x1C)
+    loop_pos = 0x1C + loop_rel if loop_rel else 0
+
+    write_ops = {0x55: (YM2203, 0), 0xA5: (YM2203_2, 0), 0x56: (YM2608, 0), 0x57: (YM2608, 1)}
+
+    events = []  # (t, chip, port, reg, data)
+    blocks = []
+    t = 0
+    loop_ev = None
+    loop_t = 0
+    loops = False
+    pos = data_start
+    while pos < len(d):
+        if loop_ev is None and loop_pos and pos >= loop_pos:
+            loop_ev, loop_t = len(events), t
+        c = d[pos]
+        if c in write_ops:
+            chip, port = write_ops[c]
+            if chip in present:
+                events.append((t, chip, port, d[pos + 1], d[pos + 2]))
+            pos += 3
+        elif c == 0xA0:
+            if AY8910 in present and not d[pos + 1] & 0x80:
+                events.append((t, AY8910, 0, d[pos + 1], d[pos + 2]))
+            pos += 3
+        elif c == 0x50:
+            if SN76489 in present:
+                events.append((t, SN76489, 0, 0, d[pos + 1]))
+            pos += 2
+        elif c == 0x61:
+            t += struct.unpack_from("<H", d, pos + 1)[0]
+            pos += 3
+        elif c == 0x62:
+            t += 735
+            pos += 1
+        elif c == 0x63:
+            t += 882
+            pos += 1
+        elif 0x70 <= c <= 0x7F:
+            t += (c & 0x0F) + 1
+            pos += 1
+        elif 0x80 <= c <= 0x8F:
+            t += c & 0x0F
+            pos += 1
+        elif c == 0x66:
+            loops = loop_ev is not None and loop_t < t
+            break
+        elif c == 0x67:
+            btype = d[pos + 2]
+            size = u32(d, pos + 3)
+            if btype == BLOCK_YM2608_ADPCM_B and YM2608 in present:
+                blocks.append((btype, d[pos + 7:pos + 7 + size]))
+            pos += 7 + size
+        else:
+            n = cmd_length(c)
+            if n == 0:
+                break  # unknown: the firmware stops here too
+            pos += n
+
+    if not loops:
+        loop_ev = None
+    return {
+        "clocks": clocks,
+        "sn_fb": sn_fb,
+        "events": events,
+        "end_t": t,
+        "loop_ev": loop_ev,
+        "loop_t": loop_t,
+        "blocks": blocks,
+        "gd3": gd3_strings(d, (0x14 + u32(d, 0x14)) if u32(d, 0x14) else 0),
+    }
+
+
+def strip_redundant(events, loop_ev):
+    out = []
+    new_loop = None
+    shadow = {}
+    for i, (t, chip, port, reg, data) in enumerate(events):
+        if i == loop_ev:
+            # the second pass enters the loop with different register state,
+            # so every register is written again once after the loop point
+            shadow = {}
+            new_loop = len(out)
+        key = (chip, port, reg)
+        if dedupable(chip, port, reg) and shadow.get(key) == data:
+            continue
+        shadow[key] = data
+        out.append((t, chip, port, reg, data))
+    if loop_ev is not None and new_loop is None:
+        new_loop = len(out)
+    return out, new_loop
+
+
+def leb128(v):
+    out = bytearray()
+    while True:
+        b = v & 0x7F
+        v >>= 7
+        if v:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def encode_wait(out, n):
+    if n <= 0:
+        return
+    if n == 735:
+        out.append(TOK_WAIT_735)
+    elif n == 882:
+        out.append(TOK_WAIT_882)
+    elif n <= TOK_WAIT_SHORT_MAX - TOK_WRITE:
+        out.append(TOK_WRITE + n)
+    else:
+        out.append(TOK_WAIT_VAR)
+        out += leb128(n)
+
+
+def encode(song):
+    events, loop_ev = strip_redundant(song["events"], song["loop_ev"])
+
+    freq = Counter((chip | (port << PORT_SHIFT), reg) for _, chip, port, reg, _ in events)
+    pairs = [p for p, _ in freq.most_common(MAX_PAIRS)]
+    pair_index = {p: i for i, p in enumerate(pairs)}
+
+    stream = bytearray()
+    loop_off = None
+    t = 0
+    for i, (et, chip, port, reg, data) in enumerate(events):
+        if i == loop_ev:
+            encode_wait(stream, song["loop_t"] - t)
+            t = song["loop_t"]
+            loop_off = len(stream)
+        encode_wait(stream, et - t)
+        t = et
+        target = chip | (port << PORT_SHIFT)
+        idx = pair_index.get((target, reg))
+        if idx is not None:
+            stream += bytes((idx, data))
+        else:
+            stream += bytes((TOK_WRITE, target, reg, data))
+    if loop_ev is not None and loop_off is None:
+        encode_wait(stream, song["loop_t"] - t)
+        t = song["loop_t"]
+        loop_off = len(stream)
+    encode_wait(stream, song["end_t"] - t)
+    stream.append(TOK_END)
+
+    pair_bytes = b"".join(bytes(p) for p in pairs)
+    block_bytes = b"".join(struct.pack("<BI", bt, len(b)) + b for bt, b in song["blocks"])
+    gd3_bytes = b"".join(s.encode("utf-8") + b"\x00" for s in song["gd3"])
+
+    stream_off = HEADER_SIZE
+    pairs_off = stream_off + len(stream)
+    blocks_off = pairs_off + len(pair_bytes)
+    gd3_off = blocks_off + len(block_bytes)
+
+    c = song["clocks"]
+    hdr = bytearray(HEADER_SIZE)
+    hdr[0:4] = b"VGC1"
+    struct.pack_into("<HH", hdr, 0x04, 1, HEADER_SIZE)
+    struct.pack_into("<I", hdr, 0x08, song["end_t"])
+    struct.pack_into("<I", hdr, 0x0C, song["loop_t"] if loop_ev is not None else 0xFFFFFFFF)
+    struct.pack_into("<I", hdr, 0x10, stream_off + loop_off if loop_ev is not None else 0)
+    struct.pack_into("<II", hdr, 0x14, stream_off, len(stream))
+    struct.pack_into("<II", hdr, 0x1C, pairs_off, len(pairs))
+    struct.pack_into("<II", hdr, 0x24, blocks_off, len(block_bytes))
+    struct.pack_into("<II", hdr, 0x2C, gd3_off, len(gd3_bytes))
+    struct.pack_into("<IIII", hdr, 0x34, c["ym2203"], c["ym2608"], c["ay8910"], c["sn76489"])
+    hdr[0x44:0x47] = song["sn_fb"]
+
+    removed = len(song["events"]) - len(events)
+    return bytes(hdr) + bytes(stream) + pair_bytes + block_bytes + gd3_bytes, removed
+
+
+def load(path):
+    raw = path.read_bytes()
+    if raw[:2] == b"\x1f\x8b":
+        raw = gzip.decompress(raw)
+    return raw
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("inputs", nargs="+", type=Path)
+    ap.add_argument("-o", "--out-dir", type=Path, help="output directory (default: next to input)")
+    ap.add_argument("--remove-source", action="store_true", help="delete the .vgm/.vgz after converting")
+    args = ap.parse_args()
+
+    failed = 0
+    for src in args.inputs:
+        try:
+            song = parse(load(src))
+            out, removed = encode(song)
+        except (OSError, ValueError, IndexError, struct.error) as e:
+            print(f"{src}: {e}", file=sys.stderr)
+            failed += 1
+            continue
+        if not any(song["clocks"].values()):
+            print(f"{src}: no supported chip, skipped", file=sys.stderr)
+            failed += 1
+            continue
+
+        dst_dir = args.out_dir or src.parent
+        dst_dir.mkdir(parents=True, exist_ok=True)
+        dst = dst_dir / (src.stem + ".vgc")
+        dst.write_bytes(out)
+        src_size = src.stat().st_size
+        print(f"{src} -> {dst}: {src_size} -> {len(out)} bytes, "
+              f"{len(song['events']) - removed} writes ({removed} redundant removed), "
+              f"{song['end_t'] / 44100:.1f}s")
+        if args.remove_source:
+            src.unlink()
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
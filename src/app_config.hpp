@@ -5,10 +5,19 @@
 constexpr uint32_t OUT_SR = 44100;
 constexpr size_t   AUDIO_BLOCK_SAMPLES = 1024;
 constexpr uint8_t  AUDIO_CHANNEL = 0;
+// スピーカを曲毎に音源のレート（チップの native rate / MDX の render rate）で回し、
+// リサンプルを省く。AUDIO_NATIVE_MAX_SR を超える分は整数で割る（55.5kHz の OPN は 27.7kHz）。
+// 割った場合は省けず、2:1 の間引き（Resampler の halfband + FIR）が残る。
+// 出力レートを native rate から決めるので、VGM の間は OPN の fidelity を品質段階で変えない。
+// VGM のタイムラインは OUT_SR の tick のまま
+constexpr bool     AUDIO_NATIVE_RATE = false;
+constexpr uint32_t AUDIO_NATIVE_MAX_SR = OUT_SR;
+static_assert(AUDIO_NATIVE_MAX_SR <= OUT_SR, "native rate must not exceed the VGM tick rate");
 // MDX render rates (portable_mdx output rate).
 constexpr uint32_t MDX_RENDER_SR_DEFAULT = 22050;
 constexpr uint32_t MDX_RENDER_SR_PCM = 22050;
-// MDX low-pass (Q15). 0 disables. Higher = brighter but more aliasing.
+// MDX low-pass (Q15) before fractional-ratio resampling to OUT_SR. 0 disables. Higher = brighter.
+// Not applied on the exact 2x (22050 -> 44100) halfband path.
 constexpr int32_t MDX_LPF_ALPHA_Q15 = 22938; // ~0.70
 constexpr bool MDX_ENABLE_PCM = true;
 // Temporary: set true to listen to PCM-only (mute FM/OPM output)
@@ -19,18 +28,100 @@ constexpr int32_t MDX_OPM_GAIN_Q15 = 32768; // 1.0
 constexpr int32_t MDX_PCM_GAIN_Q15 = 32768; // 1.0
 constexpr int32_t MDX_PCM_GAIN_SHIFT = 4;   // +12-bit -> 16-bit
 constexpr size_t   MDX_RENDER_BLOCK_SAMPLES = AUDIO_BLOCK_SAMPLES;
+// MXDRV のコンテキストは曲をまたいで使い回す。最初からこの大きさの MDX/PDX バッファで開始し、
+// 収まらない曲が来た時だけ作り直す（プールは (MDX + PDX) * 2 + 512KB、最低 2MB）
+constexpr uint32_t MDX_CTX_MIN_MDX_BYTES = 64 * 1024;
+constexpr uint32_t MDX_CTX_MIN_PDX_BYTES = 768 * 1024;
+// PCM 無しの MDX を品質最上位でロードする時のレート（OUT_SR ならリサンプル不要）
+constexpr uint32_t MDX_RENDER_SR_HQ = OUT_SR;
 
-// Audio buffering (ms / us)
-constexpr int32_t  AUDIO_TARGET_BUFFER_MS = 500;
-constexpr int32_t  AUDIO_MIN_BUFFER_MS    = 300;
-constexpr uint32_t AUDIO_PUMP_BUDGET_US   = 12000;
-// Heavier PCM8 mixes need more buffering/budget
-constexpr int32_t  AUDIO_TARGET_BUFFER_MS_PCM = 700;
-constexpr int32_t  AUDIO_MIN_BUFFER_MS_PCM    = 450;
-constexpr uint32_t AUDIO_PUMP_BUDGET_US_PCM   = 20000;
-
-// Speaker config
-constexpr uint16_t SPEAKER_DMA_BUF_LEN   = 1024;
+// MDX の OPM を何で鳴らすか。YMFM は MXDRV の OPM 書き込みを横取りして ymfm::ym2151 で生成し、
+// X68Sound 側は OPM の生成を飛ばして PCM8 だけ混ぜる（タイマと PCM8 はそのまま X68Sound）。
+// フックと OPM の迂回は scripts/patch_portable_mdx.py が入れる。フックが入っていなければ X68Sound に戻る。
+// 両方式の音声1秒あたりのサイクルは test/host の bench_opm_backends でも比べられる
+constexpr uint8_t  MDX_OPM_BACKEND_X68SOUND = 0;
+constexpr uint8_t  MDX_OPM_BACKEND_YMFM     = 1;
+constexpr uint8_t  MDX_OPM_BACKEND          = MDX_OPM_BACKEND_X68SOUND;
+constexpr uint32_t MDX_OPM_CLOCK            = 4000000;
+constexpr int32_t  MDX_YMFM_OPM_GAIN_Q15    = 32768; // 1.0
+// 書き込みはこの長さ毎にまとめて反映（MXDRV_GetPCM もこの単位で呼ぶ）
+constexpr size_t   MDX_YMFM_SLICE_SAMPLES   = 32;
+// ロード時に両方式で MDX_OPM_BENCH_MS ぶん生成し、音声1秒あたりの時間/サイクルを Serial へ
+constexpr bool     MDX_OPM_BENCH_ON_LOAD    = false;
+constexpr uint32_t MDX_OPM_BENCH_MS         = 3000;
+
+// リサンプラ（dsp/resampler.hpp）の段階毎に正弦波の THD+N と出力1サンプルあたりのサイクルを起動時に Serial へ
+constexpr bool     RESAMPLER_BENCH_ON_BOOT = false;
+
+// YM2203: 書き込み間の区間を native rate で一括生成する時の作業バッファ長
+constexpr size_t   CHIP_SPAN_SAMPLES = 256;
+
+// SSG（YM2203 の SSG 部 / AY8910）を ymfm ではなく出力レートの BLEP 合成で鳴らす。
+// YM2203 の SSG は FM とは別レーンになる（2台目のレーンとして別コアで回る）
+constexpr bool     SSG_BLEP_ENABLE = false;
+
+// VGM mix: 1回にまとめて生成する長さと、その間に溜められるチップ毎の書き込み数
+// 2台目以降のチップは生成タスクと反対のコアで生成する（VGM_MIX_CORE、-1 で無効）
+constexpr size_t   VGM_MIX_BLOCK_SAMPLES = AUDIO_BLOCK_SAMPLES;
+constexpr size_t   VGM_MIX_MAX_WRITES    = 256;
+constexpr int      VGM_MIX_CORE          = 1;
+constexpr uint32_t VGM_MIX_TASK_STACK    = 4096;
+constexpr uint32_t VGM_MIX_TASK_PRIO     = 3;
+// 別コアがこれ以上取りかからなければ、その回は生成タスク側で remote レーンも回す
+constexpr uint32_t VGM_MIX_WAIT_US       = 2000;
+
+// VGM streaming: 展開後サイズがこれ以上なら全体をメモリに置かず逐次読み出す
+constexpr size_t   VGM_STREAM_MIN_BYTES     = 512 * 1024;
+constexpr size_t   VGM_STREAM_CHUNK_BYTES   = 4096;   // LittleFS から1回に読む量
+constexpr uint32_t VGM_STREAM_EVENT_WINDOW  = 1024;   // 先読みコンパイルするイベント数
+// コンパイル済みイベントがこれ以下なら内部 DRAM に置く（再生中に毎サンプル引くので）
+constexpr size_t   VGM_HOT_EVENT_BYTES      = 32 * 1024;
+
+// VGM seek: キーフレーム間隔（秒）。シーク時の再適用はこの範囲だけ
+constexpr uint32_t VGM_SEEK_KEYFRAME_SEC = 4;
+// シークで戻すのはレジスタだけ（ymfm の EG・位相は持たない）なので、着地点のこれだけ手前へ飛び、
+// そこからはチップを回して鳴っている音のエンベロープを落ち着かせる（FF_CLOCK_MS 以下）
+constexpr uint32_t VGM_SEEK_SETTLE_MS = 1000;
+
+// VGM: ロード時に旧インタプリタ/コンパイル済みイベントの速度比較をSerialへ出す
+constexpr bool VGM_BENCH_ON_LOAD = false;
+
+// 品質ガバナ：fill_audio_block の所要時間 / その実時間（負荷%）で段階を上下する
+//   0: OPN fidelity MIN, リサンプラ Linear（2 tap）
+//   1: OPN fidelity MIN, リサンプラ Fast（4 tap FIR）
+//   2: OPN fidelity MED, リサンプラ Good（8 tap FIR）, PCM 無し MDX は次のロードから MDX_RENDER_SR_HQ
+constexpr bool     QG_ENABLE         = true;
+constexpr uint8_t  QG_LEVEL_COUNT    = 3;
+constexpr uint8_t  QG_LEVEL_DEFAULT  = 1;
+constexpr uint32_t QG_UP_LOAD_PCT    = 35;     // これ未満が QG_UP_HOLD_MS 続いたら上げる
+constexpr uint32_t QG_DOWN_LOAD_PCT  = 70;     // 平均がこれを超えたら即下げる
+constexpr uint32_t QG_UP_HOLD_MS     = 4000;
+constexpr uint32_t QG_BACKOFF_MAX_MS = 64000;  // 上げて即下げた時は次の上げを倍々で待つ
+constexpr bool     QG_LOG            = false;  // 段階が変わったら Serial へ（生成タスクから出すのでデバッグ用）
+
+// 音声生成タスク（audio/audio_engine.hpp）。生成は AUDIO_RENDER_CORE で PCM ブロックのリングへ、
+// スピーカへの送り出しは SPEAKER_TASK_CORE の別タスク。リングはスピーカのキュー（2ブロック）込みで
+// AUDIO_RING_BLOCKS ブロック = 44.1kHz で約 93ms（ブロック長はレートに比例させるのでどのレートでも同じ）
+constexpr int      AUDIO_RENDER_CORE       = 0;       // -1 でタスクを作らず loop() の中で生成
+constexpr uint32_t AUDIO_RENDER_TASK_STACK = 16384;   // 曲のロード（展開・MXDRV の準備）もこのタスク
+constexpr uint32_t AUDIO_RENDER_TASK_PRIO  = 4;
+constexpr uint32_t AUDIO_RENDER_IDLE_MS    = 5;       // リングが埋まっている時の寝る上限
+constexpr uint32_t AUDIO_FEED_TASK_STACK   = 3072;
+constexpr uint32_t AUDIO_FEED_TASK_PRIO    = 2;       // loop()（1）より上、スピーカのタスクより下
+constexpr uint32_t AUDIO_FEED_POLL_MS      = 2;
+constexpr uint32_t AUDIO_RING_BLOCKS       = 4;
+constexpr uint32_t AUDIO_CMD_QUEUE_LEN     = 16;
+// 音声経路の計測（audio/audio_telemetry.hpp）は常に取る。"stats" / "stats reset" で Serial へ。
+// 画面のパート欄の左にアンダーラン回数とリングのブロック数も出すか
+constexpr bool     AUDIO_STATS_ON_SCREEN   = false;
+// タスクが作れなかった時に loop() の中で1回に生成に使う時間の上限
+constexpr uint32_t AUDIO_PUMP_BUDGET_US    = 8000;
+// VGM の2台目のレーンは生成タスクから完了を spin で待つので、同じコアには置けない
+static_assert(AUDIO_RENDER_CORE < 0 || VGM_MIX_CORE != AUDIO_RENDER_CORE,
+              "VGM_MIX_CORE must differ from AUDIO_RENDER_CORE");
+
+// Speaker config（DMA は 256 x 8 = 44.1kHz で約 46ms。貯めるのは生成側のリングで）
+constexpr uint16_t SPEAKER_DMA_BUF_LEN   = 256;
 constexpr uint8_t  SPEAKER_DMA_BUF_COUNT = 8;
 constexpr uint8_t  SPEAKER_TASK_PRIORITY = 3;
 constexpr uint8_t  SPEAKER_TASK_CORE     = 1;
@@ -43,11 +134,34 @@ constexpr int      VOLUME_STEP     = 5;
 constexpr uint32_t VOLUME_REPEAT_MS = 120;
 constexpr uint32_t VOLUME_SHOW_MS   = 1500;
 
+// Fast-forward (BtnA+BtnB 長押し)：FF_REPEAT_MS 毎に FF_RATE 倍ぶん進める
+constexpr uint32_t FF_RATE          = 32;
+constexpr uint32_t FF_REPEAT_MS     = 100;
+// VGM の早送りは着地点の手前 FF_CLOCK_MS だけチップを native rate で回し（リサンプル・mix 無しで
+// 出力は捨てる）、鳴っている音の EG・SSG エンベロープ・ADPCM を進める。それより前はレジスタ書き込み
+// だけで進める（ボタンの早送り1回 FF_RATE * FF_REPEAT_MS は全部回る長さ。長いシークは最後の区間だけ）。
+// 最後の FF_SETTLE_MS は普通に生成して捨て、リサンプラの履歴を入れ替える
+constexpr uint32_t FF_CLOCK_MS      = 4000;
+constexpr uint32_t FF_SETTLE_MS     = 16;
+// MDX の早送りは MXDRV_PlayAt（毎回曲の先頭からドライバを回し直す）なので、続けて来た分は足し合わせ、
+// これだけ間が空いた所で1回だけ飛ぶ（押している間は無音）
+constexpr uint32_t MDX_FF_COALESCE_MS = FF_REPEAT_MS * 2;
+// ロード時に早送りエンジンで1周回し、実時間比をSerialへ出す
+constexpr bool     FF_BENCH_ON_LOAD = false;
+
+// 生成ループ（fill_audio_block）と UI 1フレームの CPU サイクルを HOT_PATH_REPORT_MS 毎に Serial へ。
+// 置き場所の効果は -D HOT_PATH_DISABLE のビルドと比べる（common/hot_path.hpp）
+constexpr bool     HOT_PATH_REPORT    = false;
+constexpr uint32_t HOT_PATH_REPORT_MS = 10000;
+
 constexpr int SPEC_COLS = 32;
 
 // UI layout/timing
 constexpr uint32_t UI_FPS_MS = 33;  // 30fps
-constexpr uint32_t UI_FPS_MS_PCM = 50;  // 20fps when PCM8 is active
+// 画面のスプライト（240x135x2 = 約 64KB）を内部 RAM に置くのは、その後にこれだけ残る時だけ。
+// 生成タスク 16KB + 送り出し 3KB + VGM の2台目 4KB のスタック、内部 DRAM のイベント 32KB
+// （VGM_HOT_EVENT_BYTES）と余裕 16KB
+constexpr size_t   UI_SPRITE_DRAM_RESERVE = 72 * 1024;
 constexpr int UI_HEADER_H = 16;
 constexpr int UI_GAP = 4;
 constexpr int UI_SPEC_H = 78;
@@ -64,3 +178,5 @@ constexpr int UI_MIN_SPEC_H = 54;
 constexpr float M_ATTACK  = 0.75f;
 constexpr float M_RELEASE = 0.25f;   // 落ちも速く
 constexpr uint32_t PEAK_HOLD_MS = 120;
+// 実出力タップから作るメータの表示範囲：フルスケールから 6dB x この数まで
+constexpr uint32_t METER_TAP_OCTAVES = 8;
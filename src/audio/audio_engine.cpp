@@ -2,49 +2,138 @@
 #include <M5Unified.h>
 #include "../app_config.hpp"
 
-void AudioEngine::begin(uint32_t sample_rate, uint8_t channel) {
-  sr_ = sample_rate;
+void AudioEngine::begin(uint32_t sample_rate, uint8_t channel, FillFn fill, CommandFn on_command) {
+  fill_ = fill;
+  on_command_ = on_command;
   ch_ = channel;
+  spk_sr_ = M5.Speaker.config().sample_rate;
+  spk_volume_ = M5.Speaker.getVolume();
+  volume_.store(spk_volume_, std::memory_order_relaxed);
+  set_sample_rate(sample_rate);
+
+  // 送り出しはスピーカのタスクと同じコアで loop() より上の優先度。生成はもう片方のコア
+  TaskHandle_t h = nullptr;
+  if (xTaskCreatePinnedToCore(&AudioEngine::feed_task_, "audio_feed", AUDIO_FEED_TASK_STACK,
+                              this, AUDIO_FEED_TASK_PRIO, &h, SPEAKER_TASK_CORE) == pdPASS) {
+    feed_task_h_ = h;
+  }
+  h = nullptr;
+  if (AUDIO_RENDER_CORE >= 0 &&
+      xTaskCreatePinnedToCore(&AudioEngine::render_task_, "audio_render", AUDIO_RENDER_TASK_STACK,
+                              this, AUDIO_RENDER_TASK_PRIO, &h, AUDIO_RENDER_CORE) == pdPASS) {
+    render_task_h_ = h;
+  }
+}
+
+void AudioEngine::set_sample_rate(uint32_t sample_rate) {
+  sr_ = sample_rate;
+  uint32_t n = (uint32_t)(((uint64_t)AUDIO_BLOCK_SAMPLES * sample_rate) / OUT_SR);
+  if (n > AUDIO_BLOCK_SAMPLES) n = AUDIO_BLOCK_SAMPLES;
+  if (n < 64) n = 64;
+  block_n_ = n;
 }
 
-void AudioEngine::pump(FillFn fill, bool heavy) {
-  const uint32_t now = millis();
+bool AudioEngine::post(uint8_t op, uint32_t arg) {
+  AudioCommand c;
+  c.op = op;
+  c.arg = arg;
+  if (!cmds_.push(c)) return false;
+  if (render_task_h_) xTaskNotifyGive((TaskHandle_t)render_task_h_);
+  return true;
+}
 
-  // 経過分だけ貯金を減らす（雑だけど効く）
-  if (last_ms_ != 0) {
-    int32_t dec = (int32_t)(now - last_ms_);
-    buffered_ms_ -= dec;
-    if (buffered_ms_ < 0) buffered_ms_ = 0;
+// タスクが作れなかった時の代わり（作れていれば何もしない）
+void AudioEngine::pump() {
+  if (!render_task_h_) {
+    drain_commands_();
+    const uint32_t t0 = micros();
+    while (micros() - t0 < AUDIO_PUMP_BUDGET_US && render_one_()) {}
   }
-  last_ms_ = now;
+  if (!feed_task_h_) feed_();
+}
 
-  // 再生が止まってたら貯金0扱い
-  if (M5.Speaker.isPlaying(ch_) == 0) {
-    buffered_ms_ = 0;
+void AudioEngine::drain_commands_() {
+  AudioCommand c;
+  while (cmds_.pop(c)) {
+    in_command_.store(true, std::memory_order_relaxed);
+    on_command_(c);
+    in_command_.store(false, std::memory_order_relaxed);
   }
+}
 
-  // 目標貯金（ms）：重いときは多めが安定
-  const int32_t TARGET_MS = heavy ? AUDIO_TARGET_BUFFER_MS_PCM : AUDIO_TARGET_BUFFER_MS;
-  const int32_t MIN_MS    = heavy ? AUDIO_MIN_BUFFER_MS_PCM : AUDIO_MIN_BUFFER_MS;
-  const int32_t CHUNK_MS  = (int32_t)((1000LL * AUDIO_BLOCK_SAMPLES) / sr_);
-
-  // 1回のpumpで使う時間上限（UIを止めない）
+// リングに空きがあれば1ブロック作って積む
+bool AudioEngine::render_one_() {
+  Block* b = ring_.slot();
+  if (!b) return false;
+  b->sr = sr_;
+  b->n = block_n_;
   const uint32_t t0 = micros();
-  const uint32_t BUDGET_US = heavy ? AUDIO_PUMP_BUDGET_US_PCM : AUDIO_PUMP_BUDGET_US;
+  fill_(b->pcm, (int)block_n_);
+  telemetry_.on_fill(micros() - t0);
+  ring_.push();
+  return true;
+}
 
-  // 貯金が足りない時だけ詰める。詰めたらその分貯金を増やす。
-  while (buffered_ms_ < TARGET_MS) {
-    if (M5.Speaker.isPlaying(ch_) == 2) break; // キュー満杯なら終了
+// スピーカのキュー（M5 は1チャンネル2つまで、isPlaying がその数）で鳴り終わった分をリングへ返し、
+// 空いた所へ次のブロックを渡す。渡したものが全部鳴り終わっていたらアンダーラン
+void AudioEngine::feed_() {
+  const uint8_t volume = volume_.load(std::memory_order_relaxed);
+  if (volume != spk_volume_) {
+    M5.Speaker.setVolume(volume);
+    spk_volume_ = volume;
+  }
+
+  const uint32_t playing = (uint32_t)M5.Speaker.isPlaying(ch_);
+  const bool busy = in_command_.load(std::memory_order_relaxed);
+  if (queued_ != 0 && playing == 0 && !draining_ && !busy) telemetry_.on_underrun();
+  bool freed = false;
+  while (queued_ > playing) {
+    ring_.pop();
+    --queued_;
+    freed = true;
+  }
+  if (freed && render_task_h_) xTaskNotifyGive((TaskHandle_t)render_task_h_);
 
-    // UI優先で時間切れなら一旦戻る
-    if ((micros() - t0) > BUDGET_US && buffered_ms_ >= MIN_MS) break;
+  while (queued_ < ring_.size() && M5.Speaker.isPlaying(ch_) < 2) {
+    Block& b = ring_.peek(queued_);
+    if (b.sr != spk_sr_) {
+      if (queued_ != 0) {   // 前のレートの分を鳴らし切ってから
+        draining_ = true;
+        break;
+      }
+      reconfigure_speaker_(b.sr);
+      draining_ = false;
+    }
+    M5.Speaker.playRaw(b.pcm, b.n, b.sr, false, 1, ch_, false);
+    ++queued_;
+  }
+  if (!busy) telemetry_.on_feed(ring_.size(), (uint32_t)M5.Speaker.isPlaying(ch_));
+}
 
-    int16_t* p = buf_[idx_];
-    idx_ = (idx_ + 1) % BUFS;
+void AudioEngine::reconfigure_speaker_(uint32_t sample_rate) {
+  M5.Speaker.end();
+  auto spk = M5.Speaker.config();
+  spk.sample_rate = sample_rate;
+  M5.Speaker.config(spk);
+  M5.Speaker.begin();
+  M5.Speaker.setVolume(spk_volume_);
+  spk_sr_ = sample_rate;
+  Serial.printf("speaker rate=%u Hz\n", (unsigned)sample_rate);
+}
 
-    fill(p, (int)AUDIO_BLOCK_SAMPLES);
-    M5.Speaker.playRaw(p, AUDIO_BLOCK_SAMPLES, sr_, false, 1, ch_, false);
+// 指示を先に片付け、リングが埋まったら送り出し側が空けるまで（または次の指示まで）寝る
+void AudioEngine::render_task_(void* arg) {
+  AudioEngine* self = static_cast<AudioEngine*>(arg);
+  for (;;) {
+    self->drain_commands_();
+    if (!self->render_one_()) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIO_RENDER_IDLE_MS));
+  }
+}
 
-    buffered_ms_ += CHUNK_MS;
+void AudioEngine::feed_task_(void* arg) {
+  AudioEngine* self = static_cast<AudioEngine*>(arg);
+  for (;;) {
+    self->feed_();
+    vTaskDelay(pdMS_TO_TICKS(AUDIO_FEED_POLL_MS));
   }
 }
@@ -1,23 +1,74 @@
 #pragma once
+#include <atomic>
 #include <cstdint>
-#include <functional>
+#include "../app_config.hpp"
+#include "../common/spsc_ring.hpp"
+#include "audio_telemetry.hpp"
 
+// loop() → 生成タスクへの指示（op の意味は呼ぶ側で決める）
+struct AudioCommand {
+  uint8_t op = 0;
+  uint32_t arg = 0;
+};
+
+// 生成タスク（AUDIO_RENDER_CORE）が fill で PCM ブロックを作って SPSC リングへ積み、
+// 送り出しタスク（SPEAKER_TASK_CORE）がリングからスピーカのキューへ渡す。
+// loop() 側は post() で指示を送るだけ。fill / on_command は生成タスクの中で呼ばれる。
+// タスクが作れなかった側の仕事は pump() が loop() の中で行う
 class AudioEngine {
 public:
-  using FillFn = std::function<void(int16_t* dst, int n)>;
+  using FillFn = void (*)(int16_t* dst, int n);
+  using CommandFn = void (*)(const AudioCommand& cmd);
+
+  void begin(uint32_t sample_rate, uint8_t channel, FillFn fill, CommandFn on_command);
+  // 生成側から：次に作るブロックからこのレート。スピーカは前のレートのブロックを鳴らし切ってから掛け直す
+  void set_sample_rate(uint32_t sample_rate);
+  // loop() から。キューが満杯なら false
+  bool post(uint8_t op, uint32_t arg = 0);
+  // loop() から。スピーカを触るのは送り出し側だけなので、次の feed で掛ける
+  void set_volume(uint8_t volume) { volume_.store(volume, std::memory_order_relaxed); }
+  void pump();
 
-  void begin(uint32_t sample_rate, uint8_t channel);
-  void pump(FillFn fill, bool heavy);
+  // リングに積んであるブロック数（スピーカに渡し済みで鳴り終わっていない分を含む）
+  uint32_t buffered_blocks() const { return ring_.size(); }
+
+  // アンダーラン・キューの深さ・fill の時間（begin_track は生成側から）
+  AudioTelemetry& telemetry() { return telemetry_; }
 
 private:
-  uint32_t sr_ = 44100;
+  struct Block {
+    uint32_t sr;
+    uint32_t n;
+    int16_t pcm[AUDIO_BLOCK_SAMPLES];
+  };
+
+  void drain_commands_();
+  bool render_one_();
+  void feed_();
+  void reconfigure_speaker_(uint32_t sample_rate);
+  static void render_task_(void* arg);
+  static void feed_task_(void* arg);
+
+  FillFn fill_ = nullptr;
+  CommandFn on_command_ = nullptr;
   uint8_t ch_ = 0;
 
-  uint32_t last_ms_ = 0;
-  int32_t buffered_ms_ = 0;  // いま貯金してる再生時間(ms)の推定
-  
-  static constexpr int BUFS = 48;
-  static constexpr int N = 1024;
-  int16_t buf_[BUFS][N];
-  int idx_ = 0;
+  // 生成側
+  uint32_t sr_ = OUT_SR;
+  uint32_t block_n_ = AUDIO_BLOCK_SAMPLES;   // どのレートでも1ブロックがほぼ同じ時間になる長さ
+
+  SpscRing<Block, AUDIO_RING_BLOCKS> ring_;
+  SpscRing<AudioCommand, AUDIO_CMD_QUEUE_LEN> cmds_;
+  AudioTelemetry telemetry_;
+  std::atomic<bool> in_command_{false};   // 曲のロード中などはリングが空いても数えない
+
+  // 送り出し側
+  uint32_t spk_sr_ = OUT_SR;
+  std::atomic<uint8_t> volume_{0};
+  uint8_t spk_volume_ = 0;
+  uint32_t queued_ = 0;   // リングの先頭からスピーカへ渡し済みのブロック数
+  bool draining_ = false; // レートを変える前に鳴らし切っている
+
+  void* render_task_h_ = nullptr;
+  void* feed_task_h_ = nullptr;
 };
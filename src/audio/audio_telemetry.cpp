@@ -0,0 +1,60 @@
+#include "audio_telemetry.hpp"
+#include <Arduino.h>
+#include <string.h>
+
+void AudioTelemetry::begin_track(const char* name) {
+  track_ = {};
+  strncpy(track_name_, name ? name : "", sizeof(track_name_) - 1);
+  track_name_[sizeof(track_name_) - 1] = 0;
+  track_underrun_base_ = underruns_.load(std::memory_order_relaxed);
+  track_seq_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioTelemetry::on_feed(uint32_t ring_blocks, uint32_t speaker_blocks) {
+  const uint32_t t = track_seq_.load(std::memory_order_relaxed);
+  if (t != feed_track_seen_) {
+    feed_track_seen_ = t;
+    ring_min_track_ = UINT32_MAX;
+  }
+  const uint32_t r = reset_seq_.load(std::memory_order_relaxed);
+  if (r != feed_reset_seen_) {
+    feed_reset_seen_ = r;
+    ring_min_total_ = UINT32_MAX;
+  }
+  ring_now_ = ring_blocks;
+  speaker_now_ = speaker_blocks;
+  if (ring_blocks < ring_min_track_) ring_min_track_ = ring_blocks;
+  if (ring_blocks < ring_min_total_) ring_min_total_ = ring_blocks;
+}
+
+void AudioTelemetry::reset() {
+  total_underrun_base_ = underruns_.load(std::memory_order_relaxed);
+  reset_seq_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioTelemetry::print_stats_(const char* label, const RenderStats& s, uint32_t underruns,
+                                  uint32_t ring_min) {
+  Serial.printf("[stats] %s: %u blocks, fill avg %u us / max %u us, underruns %u, ring min %d\n",
+                label, (unsigned)s.blocks,
+                (unsigned)(s.blocks ? (uint32_t)(s.sum_us / s.blocks) : 0),
+                (unsigned)s.max_us, (unsigned)underruns,
+                ring_min == UINT32_MAX ? -1 : (int)ring_min);
+  // 空でないバケツだけ "下限us:数"
+  char line[160];
+  int len = 0;
+  for (uint32_t b = 0; b < kBuckets && len < (int)sizeof(line) - 16; ++b) {
+    if (s.count[b] == 0) continue;
+    len += snprintf(line + len, sizeof(line) - len, " %u:%u",
+                    (unsigned)(b == 0 ? 0 : 1u << b), (unsigned)s.count[b]);
+  }
+  if (len > 0) Serial.printf("[stats]   fill us histogram%s\n", line);
+}
+
+void AudioTelemetry::print() const {
+  Serial.printf("[stats] now: ring %u blocks, speaker queue %u, last fill %u us\n",
+                (unsigned)ring_now_, (unsigned)speaker_now_, (unsigned)last_fill_us_);
+  print_stats_("total", total_, underruns(), ring_min_total_);
+  char label[64];
+  snprintf(label, sizeof(label), "track %s", track_name_);
+  print_stats_(label, track_, track_underruns(), ring_min_track_);
+}
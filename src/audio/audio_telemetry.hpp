@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// 音声経路の計測。製品でも入れっぱなしにできるよう、1ブロックに数十サイクルの加算だけ。
+// 生成側（fill の時間とヒストグラム）と送り出し側（アンダーランとキューの深さ）はそれぞれ
+// 1タスクだけが書く。読む側（stats コマンド・画面）は表示用なので多少ずれてよい
+class AudioTelemetry {
+public:
+  // 1ブロックの生成時間の log2 バケツ：[0] < 2us、[i] = [2^i, 2^(i+1)) us、最後はそれ以上
+  static constexpr uint32_t kBuckets = 16;
+
+  struct RenderStats {
+    uint32_t count[kBuckets];
+    uint32_t blocks;
+    uint64_t sum_us;
+    uint32_t max_us;
+  };
+
+  // ---- 生成側 ----
+  void on_fill(uint32_t us) {
+    const uint32_t r = reset_seq_.load(std::memory_order_relaxed);
+    if (r != render_reset_seen_) {
+      render_reset_seen_ = r;
+      total_ = {};
+    }
+    add_(total_, us);
+    add_(track_, us);
+    last_fill_us_ = us;
+  }
+  // 曲毎の集計をやり直す（曲名はパス。表示にだけ使う）
+  void begin_track(const char* name);
+
+  // ---- 送り出し側 ----
+  // ring_blocks: リングのブロック数（スピーカ渡し済みを含む）、speaker_blocks: スピーカのキュー（0-2）
+  void on_feed(uint32_t ring_blocks, uint32_t speaker_blocks);
+  void on_underrun() {
+    underruns_.store(underruns_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  // ---- 読む側 ----
+  uint32_t underruns() const { return underruns_.load(std::memory_order_relaxed) - total_underrun_base_; }
+  uint32_t track_underruns() const {
+    return underruns_.load(std::memory_order_relaxed) - track_underrun_base_;
+  }
+  uint32_t ring_blocks() const { return ring_now_; }
+  void reset();   // 全体の集計をやり直す（stats reset）
+  void print() const;
+
+private:
+  static void add_(RenderStats& s, uint32_t us) {
+    uint32_t b = us < 2 ? 0 : 31 - (uint32_t)__builtin_clz(us);
+    if (b >= kBuckets) b = kBuckets - 1;
+    ++s.count[b];
+    ++s.blocks;
+    s.sum_us += us;
+    if (us > s.max_us) s.max_us = us;
+  }
+  static void print_stats_(const char* label, const RenderStats& s, uint32_t underruns,
+                           uint32_t ring_min);
+
+  // 生成側だけが書く
+  RenderStats total_{};
+  RenderStats track_{};
+  char track_name_[48]{};
+  volatile uint32_t last_fill_us_ = 0;
+  volatile uint32_t track_underrun_base_ = 0;
+  uint32_t render_reset_seen_ = 0;
+
+  // アンダーランは増やすだけ。やり直しは基準値（全体は loop()、曲は生成側が書く）
+  std::atomic<uint32_t> underruns_{0};
+  volatile uint32_t total_underrun_base_ = 0;
+
+  // 曲・全体のやり直しは世代で伝え、それぞれの書き手が自分の分を消す
+  std::atomic<uint32_t> track_seq_{0};
+  std::atomic<uint32_t> reset_seq_{0};
+
+  // 送り出し側だけが書く
+  uint32_t feed_track_seen_ = 0;
+  uint32_t feed_reset_seen_ = 0;
+  volatile uint32_t ring_now_ = 0;
+  volatile uint32_t speaker_now_ = 0;
+  volatile uint32_t ring_min_total_ = UINT32_MAX;
+  volatile uint32_t ring_min_track_ = UINT32_MAX;
+};
@@ -0,0 +1,65 @@
+#include "quality_governor.hpp"
+#include "../app_config.hpp"
+
+static constexpr uint8_t kSettleBlocks = 4;
+
+void QualityGovernor::reset(uint8_t level) {
+  level_ = level < QG_LEVEL_COUNT ? level : (uint8_t)(QG_LEVEL_COUNT - 1);
+  avg_q8_ = 0;
+  primed_ = false;
+  settle_ = 0;
+  calm_since_ms_ = 0;
+  hold_ms_ = QG_UP_HOLD_MS;
+  raised_ms_ = 0;
+}
+
+bool QualityGovernor::on_block(uint32_t elapsed_us, uint32_t samples, uint32_t sample_rate, uint32_t now_ms) {
+  if (samples == 0 || sample_rate == 0) return false;
+
+  // 負荷 % = elapsed / (samples / sr)。Q8 で平滑化（1/8 ずつ寄せる）
+  const uint32_t block_us = (uint32_t)(((uint64_t)samples * 1000000u) / sample_rate);
+  uint64_t pct_q8 = ((uint64_t)elapsed_us * (100u << 8)) / (block_us ? block_us : 1);
+  if (pct_q8 > (1000u << 8)) pct_q8 = 1000u << 8;
+  if (!primed_) {
+    avg_q8_ = (uint32_t)pct_q8;
+    primed_ = true;
+  } else {
+    avg_q8_ = (uint32_t)((int32_t)avg_q8_ + (((int32_t)pct_q8 - (int32_t)avg_q8_) >> 3));
+  }
+  if (settle_ > 0) {
+    --settle_;
+    return false;
+  }
+  const uint32_t load = avg_q8_ >> 8;
+
+  if (load > QG_DOWN_LOAD_PCT) {
+    calm_since_ms_ = 0;
+    if (level_ == 0) return false;
+    // 上げた段階で持たなかった：次はもっと長く余裕を確認してから
+    if (raised_ms_ != 0 && now_ms - raised_ms_ < hold_ms_ * 2) {
+      hold_ms_ = (hold_ms_ * 2 < QG_BACKOFF_MAX_MS) ? hold_ms_ * 2 : QG_BACKOFF_MAX_MS;
+    }
+    raised_ms_ = 0;
+    --level_;
+    primed_ = false;   // 新しい段階の負荷で測り直す
+    settle_ = kSettleBlocks;
+    return true;
+  }
+
+  if (load >= QG_UP_LOAD_PCT || level_ + 1 >= QG_LEVEL_COUNT) {
+    calm_since_ms_ = 0;
+    return false;
+  }
+  if (calm_since_ms_ == 0) {
+    calm_since_ms_ = now_ms ? now_ms : 1;
+    return false;
+  }
+  if (now_ms - calm_since_ms_ < hold_ms_) return false;
+
+  ++level_;
+  calm_since_ms_ = 0;
+  raised_ms_ = now_ms ? now_ms : 1;
+  primed_ = false;
+  settle_ = kSettleBlocks;
+  return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+// 生成負荷（1ブロックの生成時間 / そのブロックの再生時間）を見て品質段階を上下する。
+// 段階の意味は呼び出し側が決める（0 が最も軽い）。
+// 下げるのは平均負荷が閾値を超えた時点ですぐ、上げるのは余裕が続いた時だけ。
+// 上げた直後に下げることになったら、次に上げるまでの待ちを倍にする（行ったり来たりしない）
+class QualityGovernor {
+public:
+  void reset(uint8_t level);
+
+  // 1ブロック分の計測値を渡す。段階が変わったら true
+  bool on_block(uint32_t elapsed_us, uint32_t samples, uint32_t sample_rate, uint32_t now_ms);
+
+  uint8_t level() const { return level_; }
+  uint32_t load_pct() const { return avg_q8_ >> 8; }   // 平滑化した負荷 %
+
+private:
+  uint8_t level_ = 0;
+  uint32_t avg_q8_ = 0;          // 負荷 % (Q8)
+  bool primed_ = false;
+  uint8_t settle_ = 0;           // 段階を変えた直後は数ブロック測るだけ
+  uint32_t calm_since_ms_ = 0;   // 0 = 余裕なし
+  uint32_t hold_ms_ = 0;         // 次に上げるまでに必要な余裕の継続時間
+  uint32_t raised_ms_ = 0;       // 直前に上げた時刻（0 = 上げていない）
+};
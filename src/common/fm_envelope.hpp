@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include "../app_config.hpp"
+
+// FM 各 ch のオペレータの EG 減衰（ymfm）をメータ用に読むための窓口。
+// 読むのは生成タスクがメータを進める時（UI_FPS_MS 毎）に1回だけ。チップと同じタスクなので排他は要らない
+struct FmEnvelopeProbe {
+  // att[ch * 4 + op] へ減衰を書く（op は op1..op4 の順、10bit: 1 = 0.09375dB, 0x3FF = 無音）
+  using ReadFn = void (*)(const void* chip, uint16_t* att, uint32_t channels);
+
+  const void* chip = nullptr;
+  ReadFn fn = nullptr;
+
+  explicit operator bool() const { return fn != nullptr; }
+  void read(uint16_t* att, uint32_t channels) const { fn(chip, att, channels); }
+};
+
+// ymfm の fm_engine から ch 毎 4op の EG 減衰を抜き出す
+template <class Engine>
+inline void fm_read_eg_attenuation(const Engine& fm, uint16_t* att, uint32_t channels) {
+  for (uint32_t ch = 0; ch < channels; ++ch) {
+    const auto* c = fm.debug_channel(ch);
+    for (uint32_t op = 0; op < 4; ++op) {
+      att[ch * 4 + op] = (uint16_t)c->debug_operator(op)->debug_eg_attenuation();
+    }
+  }
+}
+
+// アルゴリズム毎のキャリア（bit0 = op1）
+static constexpr uint8_t kFmCarrierMask[8] = { 0x08, 0x08, 0x08, 0x08, 0x0A, 0x0E, 0x0E, 0x0F };
+
+// キャリアのうち一番大きいもの（EG + TL）を 0..1 に。
+// TL は 0.75dB 刻みなので <<3 で EG と同じ単位、6dB ≒ 64 で METER_TAP_OCTAVES 分を表示
+inline float fm_carrier_level(const uint16_t* att4, uint8_t alg, const uint8_t* tl4) {
+  const uint8_t mask = kFmCarrierMask[alg & 7];
+  uint32_t best = 0x3FF;
+  for (uint32_t op = 0; op < 4; ++op) {
+    if (!(mask & (1u << op))) continue;
+    const uint32_t a = att4[op] + ((uint32_t)(tl4[op] & 0x7F) << 3);
+    if (a < best) best = a;
+  }
+  constexpr uint32_t kRange = METER_TAP_OCTAVES * 64;
+  return best >= kRange ? 0.0f : (float)(kRange - best) / (float)kRange;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// 音声生成ループの置き場所。ESP32 では命令を IRAM、よく引く表を内部 DRAM に置き、
+// フラッシュ / PSRAM のキャッシュ（UI の sprite 転送などで追い出される）を通らないようにする。
+// 比較用に -D HOT_PATH_DISABLE でビルドすると従来どおりの置き場所になる
+#if defined(ESP32) && !defined(HOT_PATH_DISABLE)
+#include <esp_attr.h>
+#define HOT_FN   IRAM_ATTR
+#define HOT_DATA DRAM_ATTR
+#define HOT_PATH_PLACED 1
+#else
+#define HOT_FN
+#define HOT_DATA
+#define HOT_PATH_PLACED 0
+#endif
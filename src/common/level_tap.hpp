@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// 出力1本ぶんの peak / RMS を生成側で固定小数のまま溜め、一定サンプル毎に公開する。
+// 生成は別コアのこともあるので公開値は atomic 1語（UI が読むまでの最大を残す）
+//   bit31: 更新あり / bit16-30: peak / bit0-14: RMS（どちらも 0..0x7FFF = 0..1.0）
+class LevelTap {
+public:
+  static constexpr uint32_t kFresh = 0x80000000u;
+
+  void clear() {
+    peak_ = 0;
+    sq_ = 0;
+    n_ = 0;
+    pub_.store(0, std::memory_order_relaxed);
+  }
+
+  // 生成側
+  void add(int32_t v) {
+    const uint32_t a = (uint32_t)(v < 0 ? -v : v);
+    if (a > peak_) peak_ = a;
+    sq_ += (uint64_t)a * a;
+    ++n_;
+  }
+  void add_silence(uint32_t n) { n_ += n; }
+
+  // min_samples 以上溜まっていれば公開してやり直す
+  void publish_if(uint32_t min_samples) {
+    if (n_ < min_samples) return;
+    const uint32_t rms = sat_(isqrt_((uint32_t)(sq_ / n_)));
+    const uint32_t pk = sat_(peak_);
+    uint32_t cur = pub_.load(std::memory_order_relaxed);
+    for (;;) {
+      const uint32_t p = (cur & kFresh) ? (cur >> 16) & 0x7FFF : 0;
+      const uint32_t r = (cur & kFresh) ? cur & 0x7FFF : 0;
+      const uint32_t next = kFresh | ((pk > p ? pk : p) << 16) | (rms > r ? rms : r);
+      if (pub_.compare_exchange_weak(cur, next, std::memory_order_relaxed)) break;
+    }
+    peak_ = 0;
+    sq_ = 0;
+    n_ = 0;
+  }
+
+  // UI 側：前回から公開があれば kFresh 付きの値、無ければ 0
+  uint32_t take() { return pub_.exchange(0, std::memory_order_relaxed); }
+
+  static uint32_t peak_of(uint32_t v) { return (v >> 16) & 0x7FFF; }
+  static uint32_t rms_of(uint32_t v) { return v & 0x7FFF; }
+
+private:
+  static uint32_t sat_(uint32_t v) { return v > 0x7FFF ? 0x7FFF : v; }
+
+  static uint32_t isqrt_(uint32_t v) {
+    uint32_t r = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > v) bit >>= 2;
+    while (bit) {
+      if (v >= r + bit) {
+        v -= r + bit;
+        r = (r >> 1) + bit;
+      } else {
+        r >>= 1;
+      }
+      bit >>= 2;
+    }
+    return r;
+  }
+
+  uint32_t peak_ = 0;
+  uint64_t sq_ = 0;
+  uint32_t n_ = 0;
+  std::atomic<uint32_t> pub_{0};
+};
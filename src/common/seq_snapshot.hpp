@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// 1 writer / 1 reader の値の受け渡し（3面）。書く側・読む側がそれぞれ1面ずつ持ち、
+// 残りの1面を mid_ の番号の交換で受け渡す。読む側が写している面へ書く側が書くことはない。
+// どちらも待たない。T はそのままコピーできるもの
+template <class T>
+class SeqSnapshot {
+public:
+  // ---- writer ----
+  // 次に公開する面。publish() まで読む側は見ない
+  T& back() { return buf_[back_].value; }
+  // back() を受け渡し用の面と入れ替える（読む側がまだ取っていなければ古い方は捨てる）
+  void publish() {
+    buf_[back_].gen = ++gen_;
+    back_ = mid_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndex;
+  }
+
+  // ---- reader ----
+  // seen より新しい世代を out へ写せたら true（seen を進める）
+  bool read(T& out, uint32_t& seen) {
+    if (mid_.load(std::memory_order_relaxed) & kFresh) {
+      front_ = mid_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+    }
+    const Slot& s = buf_[front_];
+    if (s.gen == seen) return false;
+    out = s.value;
+    seen = s.gen;
+    return true;
+  }
+
+private:
+  struct Slot {
+    T value{};
+    uint32_t gen = 0;
+  };
+  static constexpr uint8_t kIndex = 0x03;
+  static constexpr uint8_t kFresh = 0x04;   // mid_ の面が読む側にまだ取られていない
+
+  Slot buf_[3]{};
+  std::atomic<uint8_t> mid_{1};
+  uint8_t back_ = 0;     // writer のみ
+  uint32_t gen_ = 0;     // writer のみ
+  uint8_t front_ = 2;    // reader のみ
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// 1 producer / 1 consumer のロックフリーなリング（N は 2 のべき）。
+// 書く側は slot() に書いて push()、読む側は peek(i) で読んで pop()。
+// 自分の位置は自分だけが書き、相手の位置は acquire で読む
+template <class T, uint32_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  static constexpr uint32_t kCapacity = N;
+
+  // ---- producer ----
+  // 空きが無ければ nullptr
+  T* slot() {
+    const uint32_t h = head_.load(std::memory_order_relaxed);
+    if (h - tail_.load(std::memory_order_acquire) >= N) return nullptr;
+    return &buf_[h & (N - 1)];
+  }
+  void push() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+  bool push(const T& v) {
+    T* s = slot();
+    if (!s) return false;
+    *s = v;
+    push();
+    return true;
+  }
+
+  // ---- consumer ----
+  // 先頭から i 番目（i < size()）。pop するまで書き換えられない
+  T& peek(uint32_t i = 0) { return buf_[(tail_.load(std::memory_order_relaxed) + i) & (N - 1)]; }
+  void pop() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+  bool pop(T& v) {
+    if (size() == 0) return false;
+    v = peek();
+    pop();
+    return true;
+  }
+
+  // どちらの側からでも（相手が動いていれば目安）
+  uint32_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  T buf_[N]{};
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+};
@@ -0,0 +1,500 @@
+#include "resampler.hpp"
+#include "../app_config.hpp"
+#include "../common/hot_path.hpp"
+#include <Arduino.h>
+#include <math.h>
+#include <stdlib.h>
+
+// ===================== 係数表（コンパイル時に生成） =====================
+
+namespace {
+
+constexpr uint32_t kPhaseBits = 7;
+constexpr uint32_t kPhases = 1u << kPhaseBits;
+constexpr uint32_t kPhaseShift = 16 - kPhaseBits;
+// 係数は Q14（遮断 0.5 の位相 0 は 1.0 ちょうどになるので Q15 だと int16 に入らない）
+constexpr uint32_t kCoefBits = 14;
+constexpr int32_t kCoefOne = 1 << kCoefBits;
+
+// 間引き用の表は帯域を in の 3/4 に絞る（in/out が 4/3 以下ならこれで out の Nyquist 未満）
+constexpr double kDownScale = 0.75;
+
+constexpr double kPi = 3.14159265358979323846;
+
+constexpr double c_sin(double x) {
+  while (x > kPi) x -= 2.0 * kPi;
+  while (x < -kPi) x += 2.0 * kPi;
+  double term = x, sum = x;
+  for (int k = 1; k < 14; ++k) {
+    term *= -x * x / (double)((2 * k) * (2 * k + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double c_sqrt(double x) {
+  if (x <= 0.0) return 0.0;
+  double r = x > 1.0 ? x : 1.0;
+  for (int i = 0; i < 40; ++i) r = 0.5 * (r + x / r);
+  return r;
+}
+
+constexpr double c_bessel_i0(double x) {
+  double term = 1.0, sum = 1.0;
+  for (int k = 1; k < 32; ++k) {
+    const double h = x / (2.0 * k);
+    term *= h * h;
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double c_sinc(double x) {
+  return x == 0.0 ? 1.0 : c_sin(kPi * x) / (kPi * x);
+}
+
+constexpr double c_kaiser(double t, double half, double beta) {
+  const double r = t / half;
+  if (r * r >= 1.0) return 0.0;
+  return c_bessel_i0(beta * c_sqrt(1.0 - r * r)) / c_bessel_i0(beta);
+}
+
+template <uint32_t T>
+struct FirTable {
+  int16_t c[kPhases * T];
+  bool fits;              // 全係数が int16 に収まった
+};
+
+// 位相 p は s0（窓の T/2-1 番目）から p/kPhases 進んだ点。fc は in に対する遮断（0.5 = Nyquist）。
+// 位相毎に係数和をちょうど 1.0 にする（丸めの余りは最大の係数へ）
+template <uint32_t T>
+constexpr FirTable<T> make_table(double fc, double beta) {
+  FirTable<T> tab{};
+  tab.fits = true;
+  for (uint32_t p = 0; p < kPhases; ++p) {
+    const double f = (double)p / kPhases;
+    double v[T]{};
+    double sum = 0.0;
+    for (uint32_t j = 0; j < T; ++j) {
+      const double t = ((double)j - (double)(T / 2 - 1)) - f;
+      v[j] = 2.0 * fc * c_sinc(2.0 * fc * t) * c_kaiser(t, T / 2, beta);
+      sum += v[j];
+    }
+    int32_t q[T]{};
+    int32_t isum = 0;
+    uint32_t big = 0;
+    for (uint32_t j = 0; j < T; ++j) {
+      const double x = v[j] / sum * kCoefOne;
+      q[j] = (int32_t)(x >= 0.0 ? x + 0.5 : x - 0.5);
+      isum += q[j];
+      if (q[j] > q[big]) big = j;
+    }
+    q[big] += kCoefOne - isum;
+    for (uint32_t j = 0; j < T; ++j) {
+      if (q[j] < -32768 || q[j] > 32767) tab.fits = false;
+      tab.c[p * T + j] = (int16_t)q[j];
+    }
+  }
+  return tab;
+}
+
+// 段階毎の遮断と窓。Fast / Good は毎サンプル引くので内部 DRAM、Best は 8KB あるのでフラッシュのまま
+constexpr double kFastFc = 0.42, kFastBeta = 3.0;
+constexpr double kGoodFc = 0.45, kGoodBeta = 5.0;
+constexpr double kBestFc = 0.48, kBestBeta = 8.0;
+
+constexpr FirTable<4>  kFastUp   HOT_DATA = make_table<4>(kFastFc, kFastBeta);
+constexpr FirTable<4>  kFastDown HOT_DATA = make_table<4>(kFastFc * kDownScale, kFastBeta);
+constexpr FirTable<8>  kGoodUp   HOT_DATA = make_table<8>(kGoodFc, kGoodBeta);
+constexpr FirTable<8>  kGoodDown HOT_DATA = make_table<8>(kGoodFc * kDownScale, kGoodBeta);
+constexpr FirTable<16> kBestUp   = make_table<16>(kBestFc, kBestBeta);
+constexpr FirTable<16> kBestDown = make_table<16>(kBestFc * kDownScale, kBestBeta);
+
+// ハーフバンド（2倍）：遮断は入力の Nyquist ちょうど。位相 1/2 の係数 t = ±0.5, ±1.5, ... を
+// 中心から外へ K 個（左右対称なので片側だけ）。対の和 2 * Σc を 1.0 にする。
+// 遷移帯が Nyquist をまたぐので、8kHz のイメージを同程度に落とすには一般の表の倍の窓が要る
+template <uint32_t K>
+struct HalfbandTable {
+  int16_t c[K];
+  bool fits;
+};
+
+template <uint32_t K>
+constexpr HalfbandTable<K> make_halfband(double beta) {
+  HalfbandTable<K> tab{};
+  double v[K]{};
+  double sum = 0.0;
+  for (uint32_t j = 0; j < K; ++j) {
+    const double t = 0.5 + j;
+    v[j] = c_sinc(t) * c_kaiser(t, K, beta);
+    sum += 2.0 * v[j];
+  }
+  int32_t q[K]{};
+  int32_t isum = 0;
+  for (uint32_t j = 0; j < K; ++j) {
+    const double x = v[j] / sum * kCoefOne;
+    q[j] = (int32_t)(x >= 0.0 ? x + 0.5 : x - 0.5);
+    isum += 2 * q[j];
+  }
+  q[0] += (kCoefOne - isum) / 2;
+  tab.fits = true;
+  for (uint32_t j = 0; j < K; ++j) {
+    if (q[j] < -32768 || q[j] > 32767) tab.fits = false;
+    tab.c[j] = (int16_t)q[j];
+  }
+  return tab;
+}
+
+constexpr HalfbandTable<1>  kHalfLinear HOT_DATA = { { kCoefOne / 2 }, true };
+constexpr HalfbandTable<4>  kHalfFast   HOT_DATA = make_halfband<4>(3.0);
+constexpr HalfbandTable<8>  kHalfGood   HOT_DATA = make_halfband<8>(7.0);
+constexpr HalfbandTable<16> kHalfBest   HOT_DATA = make_halfband<16>(8.0);
+
+static_assert(kHalfFast.fits && kHalfGood.fits && kHalfBest.fits, "halfband coefficients must fit int16");
+
+static_assert(kFastUp.fits && kFastDown.fits && kGoodUp.fits && kGoodDown.fits &&
+              kBestUp.fits && kBestDown.fits, "FIR coefficients must fit int16");
+
+inline int16_t sat16(int32_t v) {
+  if (v < -32768) return -32768;
+  if (v > 32767) return 32767;
+  return (int16_t)v;
+}
+
+} // namespace
+
+// ===================== 設定 =====================
+
+void Resampler::configure(uint32_t in_sr, uint32_t out_sr, Tier tier) {
+  in_sr_ = in_sr ? in_sr : 1;
+  out_sr_ = out_sr ? out_sr : 1;
+  tier_ = tier;
+  reset();
+  select_();
+}
+
+void Resampler::set_rate(uint32_t in_sr, uint32_t out_sr) {
+  const bool was_pass = passthrough();
+  in_sr_ = in_sr ? in_sr : 1;
+  out_sr_ = out_sr ? out_sr : 1;
+  select_();
+  // 素通しの間は履歴を取っていないので、出入りする時だけ 0 から
+  if (was_pass != passthrough()) reset();
+}
+
+void Resampler::set_tier(Tier tier) {
+  tier_ = tier;
+  select_();
+}
+
+void Resampler::reset() {
+  for (auto& h : hist_) h = 0;
+  w_ = 0;
+  zero_run_ = kMaxTaps;
+  pos_fp_ = 0;
+  reset_pre_();
+}
+
+void Resampler::reset_pre_() {
+  for (auto& st : pre_) {
+    for (auto& h : st.hist) h = 0;
+    st.w = 0;
+    st.zero_run = kPreHist;
+  }
+}
+
+void Resampler::select_() {
+  // ちょうど半分は本段のハーフバンドで。それ以外で本段の表の帯域（in が out の 4/3 倍まで）に
+  // 収まらない分は前段で半分ずつ落とす
+  const uint32_t old_pre = pre_n_;
+  pre_n_ = 0;
+  if ((uint64_t)out_sr_ * 2 != in_sr_) {
+    while (pre_n_ < kMaxPreStages && (uint64_t)in_sr_ * 3 > ((uint64_t)out_sr_ * 4 << pre_n_)) ++pre_n_;
+  }
+  switch (tier_) {
+    case kFast: pre_k_ = 4; pre_coef_ = kHalfFast.c; break;
+    case kGood:
+    case kBest: pre_k_ = 8; pre_coef_ = kHalfGood.c; break;
+    default:    pre_k_ = 1; pre_coef_ = kHalfLinear.c; break;
+  }
+  // 段数が変わると前段の履歴は別のレートのものになる
+  if (pre_n_ != old_pre) reset_pre_();
+
+  // 以降 in は前段の後のレート（out を 2^pre_n_ 倍して比べる）
+  const uint64_t out_eff = (uint64_t)out_sr_ << pre_n_;
+  step_fp_ = (uint32_t)(((uint64_t)in_sr_ << 16) / out_eff);
+  if (step_fp_ == 0) step_fp_ = 1;
+  if (in_sr_ == out_eff) {
+    mode_ = kModeFir;
+    taps_ = 0;
+    coef_ = nullptr;
+    return;
+  }
+  mode_ = pre_n_ ? kModeFir
+        : (uint64_t)in_sr_ * 2 == out_sr_ ? kModeUp2
+        : (uint64_t)out_sr_ * 2 == in_sr_ ? kModeDown2 : kModeFir;
+  if (mode_ != kModeFir) {
+    // taps_ は窓の長さ（K は係数の数）
+    const bool up = mode_ == kModeUp2;
+    switch (tier_) {
+      case kFast: taps_ = up ? 8 : 15;  coef_ = kHalfFast.c; break;
+      case kGood: taps_ = up ? 16 : 31; coef_ = kHalfGood.c; break;
+      case kBest: taps_ = up ? 32 : 63; coef_ = kHalfBest.c; break;
+      default:    taps_ = up ? 2 : 3;   coef_ = kHalfLinear.c; break;
+    }
+    // 位置は 2倍なら 0 か 1/2、半分なら常に 0（input_for と消費数を合わせる）
+    pos_fp_ = up ? (pos_fp_ & 0x8000) : 0;
+    return;
+  }
+  const bool down = in_sr_ > out_eff;
+  Tier t = tier_;
+  if ((uint64_t)in_sr_ * 3 > out_eff * 4) t = kLinear;   // 前段を使い切っても収まらない
+  switch (t) {
+    case kFast: taps_ = 4;  coef_ = down ? kFastDown.c : kFastUp.c; break;
+    case kGood: taps_ = 8;  coef_ = down ? kGoodDown.c : kGoodUp.c; break;
+    case kBest: taps_ = 16; coef_ = down ? kBestDown.c : kBestUp.c; break;
+    default:    taps_ = 2;  coef_ = nullptr; break;
+  }
+}
+
+// ===================== 生成 =====================
+
+// 前段の 1/2 間引き：run_decimate_ と同じ形（窓 4K-1、中心に 1/2、奇数離れた対に c[j]/2）
+int16_t HOT_FN Resampler::pre_out_(uint32_t s, const int16_t*& in) {
+  PreStage& st = pre_[s];
+  for (uint32_t k = 0; k < 2; ++k) {
+    const int16_t x = s == 0 ? *in++ : pre_out_(s - 1, in);
+    st.hist[st.w] = x;
+    st.hist[st.w + kPreHist] = x;
+    st.w = (st.w + 1) & (kPreHist - 1);
+    if (x) st.zero_run = 0;
+    else if (st.zero_run < kPreHist) ++st.zero_run;
+  }
+  const uint32_t K = pre_k_;
+  const int16_t* x = st.hist + st.w + kPreHist - (4 * K - 1);
+  int32_t acc = (int32_t)x[2 * K - 1] * kCoefOne + kCoefOne;
+  for (uint32_t j = 0; j < K; ++j) acc += ((int32_t)x[2 * K - 2 - 2 * j] + x[2 * K + 2 * j]) * pre_coef_[j];
+  return sat16(acc >> (kCoefBits + 1));
+}
+
+// 前段だけで out に揃う（in == out * 2^pre_n_）
+template <bool Add>
+void HOT_FN Resampler::run_pre_only_(const int16_t* in, void* out, uint32_t n) {
+  for (uint32_t i = 0; i < n; ++i) {
+    const int16_t y = next_in_(in);
+    if (Add) static_cast<int32_t*>(out)[i] += y;
+    else static_cast<int16_t*>(out)[i] = y;
+  }
+  zero_run_ = kMaxTaps;   // 本段の窓は使っていない
+}
+
+// 窓は直近 T 個（古い順）。出力点は窓の T/2-1 番目と T/2 番目の間（遅延 T/2-1 サンプル）
+template <uint32_t T, bool Add>
+void HOT_FN Resampler::run_(const int16_t* in, void* out, uint32_t n) {
+  uint32_t pos = pos_fp_;
+  for (uint32_t i = 0; i < n; ++i) {
+    pos += step_fp_;
+    while (pos >= (1u << 16)) {
+      pos -= (1u << 16);
+      push_(next_in_(in));
+    }
+    const int16_t* x = hist_ + w_ + kMaxTaps - T;
+    const int16_t* h = coef_ + (pos >> kPhaseShift) * T;
+    int32_t acc = kCoefOne >> 1;
+    for (uint32_t j = 0; j < T; ++j) acc += (int32_t)x[j] * h[j];
+    const int16_t y = sat16(acc >> kCoefBits);
+    if (Add) static_cast<int32_t*>(out)[i] += y;
+    else static_cast<int16_t*>(out)[i] = y;
+  }
+  pos_fp_ = pos;
+}
+
+// 2 tap は表を引かずに端数そのもので（従来の lerp と同じ結果）
+template <bool Add>
+void HOT_FN Resampler::run_linear_(const int16_t* in, void* out, uint32_t n) {
+  uint32_t pos = pos_fp_;
+  for (uint32_t i = 0; i < n; ++i) {
+    pos += step_fp_;
+    while (pos >= (1u << 16)) {
+      pos -= (1u << 16);
+      push_(next_in_(in));
+    }
+    const int16_t* x = hist_ + w_ + kMaxTaps - 2;
+    const int32_t s0 = x[0], s1 = x[1];
+    const int16_t y = (int16_t)(s0 + (((s1 - s0) * (int32_t)(pos >> 1)) >> 15));   // 積が int32 に収まるよう 15bit
+    if (Add) static_cast<int32_t*>(out)[i] += y;
+    else static_cast<int16_t*>(out)[i] = y;
+  }
+  pos_fp_ = pos;
+}
+
+// 2倍：位置は 0 か 1/2 だけ。窓（直近 2K 個）の K-1 番目が位相 0、
+// 位相 1/2 は K-1-j 番目と K+j 番目の和に c[j]。1入力につき [位相 1/2, 入力を積む, 位相 0] の順
+template <uint32_t K, bool Add>
+void HOT_FN Resampler::run_halfband_(const int16_t* in, void* out, uint32_t n) {
+  int16_t* o16 = static_cast<int16_t*>(out);
+  int32_t* o32 = static_cast<int32_t*>(out);
+  auto put = [&](uint32_t i, int16_t y) {
+    if (Add) o32[i] += y;
+    else o16[i] = y;
+  };
+  auto mid = [&]() -> int16_t {
+    const int16_t* x = hist_ + w_ + kMaxTaps - 2 * K;
+    int32_t acc = kCoefOne >> 1;
+    for (uint32_t j = 0; j < K; ++j) acc += ((int32_t)x[K - 1 - j] + x[K + j]) * coef_[j];
+    return sat16(acc >> kCoefBits);
+  };
+  auto on = [&]() -> int16_t { return hist_[w_ + kMaxTaps - K - 1]; };
+
+  uint32_t i = 0;
+  if (pos_fp_ && n) {             // 前回は位相 1/2 で終わった
+    push_(*in++);
+    put(i++, on());
+    pos_fp_ = 0;
+  }
+  for (; i + 2 <= n; i += 2) {
+    put(i, mid());
+    push_(*in++);
+    put(i + 1, on());
+  }
+  if (i < n) {
+    put(i, mid());
+    pos_fp_ = 1u << 15;
+  }
+}
+
+// 半分：2入力毎に窓（直近 4K-1 個）の中心 2K-1 番目に 1/2、そこから奇数離れた対に c[j]/2。
+// 1/2 の丸めを避けるため 2y を Q14 で溜める
+template <uint32_t K, bool Add>
+void HOT_FN Resampler::run_decimate_(const int16_t* in, void* out, uint32_t n) {
+  constexpr uint32_t T = 4 * K - 1;
+  for (uint32_t i = 0; i < n; ++i) {
+    push_(in[0]);
+    push_(in[1]);
+    in += 2;
+    const int16_t* x = hist_ + w_ + kMaxTaps - T;
+    int32_t acc = (int32_t)x[2 * K - 1] * kCoefOne + kCoefOne;
+    for (uint32_t j = 0; j < K; ++j) acc += ((int32_t)x[2 * K - 2 - 2 * j] + x[2 * K + 2 * j]) * coef_[j];
+    const int16_t y = sat16(acc >> (kCoefBits + 1));
+    if (Add) static_cast<int32_t*>(out)[i] += y;
+    else static_cast<int16_t*>(out)[i] = y;
+  }
+}
+
+template <bool Add>
+void HOT_FN Resampler::dispatch_(const int16_t* in, void* out, uint32_t n) {
+  if (mode_ == kModeUp2) {
+    switch (taps_) {
+      case 8:  run_halfband_<4, Add>(in, out, n); break;
+      case 16: run_halfband_<8, Add>(in, out, n); break;
+      case 32: run_halfband_<16, Add>(in, out, n); break;
+      default: run_halfband_<1, Add>(in, out, n); break;
+    }
+    return;
+  }
+  if (mode_ == kModeDown2) {
+    switch (taps_) {
+      case 15: run_decimate_<4, Add>(in, out, n); break;
+      case 31: run_decimate_<8, Add>(in, out, n); break;
+      case 63: run_decimate_<16, Add>(in, out, n); break;
+      default: run_decimate_<1, Add>(in, out, n); break;
+    }
+    return;
+  }
+  if (taps_ == 0 && pre_n_) {
+    run_pre_only_<Add>(in, out, n);
+    return;
+  }
+  switch (taps_) {
+    case 0:
+      for (uint32_t i = 0; i < n; ++i) {
+        if (Add) static_cast<int32_t*>(out)[i] += in[i];
+        else static_cast<int16_t*>(out)[i] = in[i];
+      }
+      // 素通しは窓が 1 サンプル
+      if (n) zero_run_ = in[n - 1] ? 0 : kMaxTaps;
+      break;
+    case 4:  run_<4, Add>(in, out, n); break;
+    case 8:  run_<8, Add>(in, out, n); break;
+    case 16: run_<16, Add>(in, out, n); break;
+    default: run_linear_<Add>(in, out, n); break;
+  }
+}
+
+void HOT_FN Resampler::process(const int16_t* in, int16_t* out, uint32_t n) {
+  dispatch_<false>(in, out, n);
+}
+
+void HOT_FN Resampler::process_add(const int16_t* in, int32_t* acc, uint32_t n) {
+  dispatch_<true>(in, acc, n);
+}
+
+// ===================== bench =====================
+
+// 正弦波を通し、出力に同じ周波数の正弦を最小二乗で当てはめた残りを THD+N とする
+// （折り返し・イメージ・位相量子化の雑音が全部ここに入る）。サイクルは process だけ
+void Resampler::bench() {
+  static constexpr uint32_t kOut = 1024;
+  static constexpr uint32_t kRounds = 16;
+  struct Pair { uint32_t in, out; };
+  static constexpr Pair kPairs[] = {
+    { MDX_RENDER_SR_DEFAULT, OUT_SR }, { 55466, OUT_SR }, { 55466, 55466 / 2 },
+    { 110933, OUT_SR },   // OPN MED：前段 1段 + 55.5kHz → 44.1kHz
+  };
+  static constexpr float kFreqs[] = { 1000.0f, 8000.0f };
+  static const char* const kNames[] = { "linear", "fast", "good", "best" };
+
+  const uint32_t in_cap = kOut * 3 + 8;   // 比は最大 2.6
+  int16_t* in = (int16_t*)malloc(sizeof(int16_t) * in_cap * kRounds);
+  int16_t* out = (int16_t*)malloc(sizeof(int16_t) * kOut * kRounds);
+  if (!in || !out) {
+    free(in);
+    free(out);
+    return;
+  }
+
+  for (const Pair& pr : kPairs) {
+    const uint32_t in_sr = pr.in;
+    for (uint32_t t = 0; t < kTierCount; ++t) {
+      Serial.printf("[resampler] %u -> %u Hz %-6s", (unsigned)in_sr, (unsigned)pr.out, kNames[t]);
+      for (float freq : kFreqs) {
+        Resampler rs;
+        rs.configure(in_sr, pr.out, (Tier)t);
+        const uint32_t need = rs.input_for(kOut * kRounds);
+        for (uint32_t i = 0; i < need && i < in_cap * kRounds; ++i) {
+          in[i] = (int16_t)lrint(16384.0 * sin(2.0 * M_PI * fmod((double)freq * i / in_sr, 1.0)));
+        }
+        uint32_t cycles = 0;
+        const int16_t* src = in;
+        for (uint32_t r = 0; r < kRounds; ++r) {
+          const uint32_t k = rs.input_for(kOut);
+          const uint32_t c0 = ESP.getCycleCount();
+          rs.process(src, out + r * kOut, kOut);
+          cycles += ESP.getCycleCount() - c0;
+          src += k;
+        }
+
+        // 頭の 1 ブロックは履歴の立ち上がりなので捨てる。周波数は 16.16 の刻みで丸めた分まで合わせる（前段の分は倍に）
+        const double w = 2.0 * M_PI * freq * (double)(rs.step_fp_ << rs.pre_n_) / 65536.0 / in_sr;
+        double cc = 0, ss = 0, cs = 0, yc = 0, ys = 0, yy = 0;
+        for (uint32_t i = kOut; i < kOut * kRounds; ++i) {
+          const double c = cos(w * i), s = sin(w * i), y = out[i];
+          cc += c * c; ss += s * s; cs += c * s;
+          yc += y * c; ys += y * s; yy += y * y;
+        }
+        const double det = cc * ss - cs * cs;
+        const double a = (yc * ss - ys * cs) / det;
+        const double b = (ys * cc - yc * cs) / det;
+        const double fit = a * yc + b * ys;
+        const double resid = yy - fit;
+        const double thdn = 10.0 * log10((resid > 1e-9 ? resid : 1e-9) / (fit > 1e-9 ? fit : 1e-9));
+        Serial.printf("  %5.0f Hz THD+N %6.1f dB", freq, thdn);
+        if (freq == kFreqs[0]) Serial.printf(" (%.1f cyc/smp)", (double)cycles / (kOut * kRounds));
+      }
+      Serial.printf("\n");
+    }
+  }
+
+  free(in);
+  free(out);
+}
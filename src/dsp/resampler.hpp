@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdint>
+
+// モノラル int16 の固定小数点リサンプラ（位置 16.16、係数 Q14、128 位相のポリフェーズ FIR）。
+// 係数表は Kaiser 窓 sinc をコンパイル時に作る。段階でタップ数が変わる：
+//   Linear = 2 tap（従来の線形補間そのもの）/ Fast = 4 / Good = 8 / Best = 16
+// 間引き（in > out）は帯域を out 側に合わせた表を使う。この表で帯域制限になるのは in が
+// out の 4/3 倍までなので、それを超える分は前段のハーフバンドで 1/2 ずつ（最大 kMaxPreStages 段）
+// 落としてから掛ける（OPN の MED 110.9kHz → 44.1kHz なら 1段 + 55.5kHz → 44.1kHz）。
+// 前段の窓は Linear 3 / Fast 15 / Good・Best 31。in == out は素通し。
+// out == in * 2（22.05kHz の MDX）は位相が 0 と 1/2 しか無いので、対称ハーフバンド FIR で
+// 入力1サンプルから2出力をまとめて作る（位相 0 は入力そのもの、1/2 は左右対称の係数を対で掛ける）。
+// 掛け算が半分以下になる分、同じ段階でも窓を倍（Fast 8 / Good 16 / Best 32）に取る。
+// in == out * 2（native rate 出力で 55.5kHz の OPN を半分にする時）は同じ係数のハーフバンドで
+// 2入力から1出力を作る（中心 1/2 と奇数位置の対だけ。窓は Fast 15 / Good 31 / Best 63）。
+// 使い方：input_for(n) 個の入力を用意して process(in, out, n)
+class Resampler {
+public:
+  enum Tier : uint8_t { kLinear = 0, kFast, kGood, kBest, kTierCount };
+  static constexpr uint32_t kMaxTaps = 64;
+  static constexpr uint32_t kMaxPreStages = 3;   // 前段の 1/2 間引き（in が out の 32/3 倍まで）
+
+  // 曲の頭：レートと段階を決めて履歴・位置を 0 に
+  void configure(uint32_t in_sr, uint32_t out_sr, Tier tier);
+  // 再生中の切り替え。履歴と位置はそのまま（段差は遅延差の数サンプルだけ）
+  void set_rate(uint32_t in_sr, uint32_t out_sr);
+  void set_tier(Tier tier);
+  void reset();
+
+  Tier tier() const { return tier_; }
+  uint32_t taps() const { return taps_; }   // 実際に使っているタップ数（素通しは 0。前段は含まない）
+  uint32_t pre_stages() const { return pre_n_; }
+  bool passthrough() const { return taps_ == 0 && pre_n_ == 0; }
+  bool halfband() const { return mode_ != kModeFir; }   // ちょうど2倍（上げ / 下げ）
+
+  // n サンプル出力すると消費する入力数
+  // （step_fp_ と位置は前段の後のレートで数えるので、前段1段につき入力は2倍）
+  uint32_t input_for(uint32_t n) const {
+    return (uint32_t)(((uint64_t)pos_fp_ + (uint64_t)n * step_fp_) >> 16) << pre_n_;
+  }
+  // 入力 in_cap 個以内で出せる出力数（1 以上）
+  uint32_t output_for(uint32_t in_cap) const {
+    const uint32_t n = (uint32_t)(((uint64_t)(in_cap >> pre_n_) << 16) / step_fp_);
+    return n ? n : 1;
+  }
+
+  // 履歴が全部 0。この間は入力も 0 と分かっていれば skip で位置だけ進めてよい
+  bool quiet() const {
+    for (uint32_t s = 0; s < pre_n_; ++s) {
+      if (pre_[s].zero_run < kPreHist) return false;
+    }
+    return zero_run_ >= kMaxTaps;
+  }
+  void skip(uint32_t n) { pos_fp_ = (uint32_t)(((uint64_t)pos_fp_ + (uint64_t)n * step_fp_) & 0xFFFF); }
+
+  void process(const int16_t* in, int16_t* out, uint32_t n);
+  void process_add(const int16_t* in, int32_t* acc, uint32_t n);
+
+  // 段階毎に正弦波を通して THD+N と出力1サンプルあたりのサイクルを Serial へ（RESAMPLER_BENCH_ON_BOOT）
+  static void bench();
+
+private:
+  template <uint32_t T, bool Add> void run_(const int16_t* in, void* out, uint32_t n);
+  template <bool Add> void run_linear_(const int16_t* in, void* out, uint32_t n);
+  template <uint32_t K, bool Add> void run_halfband_(const int16_t* in, void* out, uint32_t n);
+  template <uint32_t K, bool Add> void run_decimate_(const int16_t* in, void* out, uint32_t n);
+  template <bool Add> void run_pre_only_(const int16_t* in, void* out, uint32_t n);
+  template <bool Add> void dispatch_(const int16_t* in, void* out, uint32_t n);
+  void select_();
+  void reset_pre_();
+
+  void push_(int16_t x) {
+    hist_[w_] = x;
+    hist_[w_ + kMaxTaps] = x;
+    w_ = (w_ + 1) & (kMaxTaps - 1);
+    if (x) zero_run_ = 0;
+    else if (zero_run_ < kMaxTaps) ++zero_run_;
+  }
+
+  // 前段：s 段目の出力を1つ（0 段目は入力を2つ、それ以降は1つ前の段の出力を2つ取る）
+  int16_t pre_out_(uint32_t s, const int16_t*& in);
+  // 本段へ入れる次の1サンプル（前段が無ければ入力そのもの）
+  int16_t next_in_(const int16_t*& in) { return pre_n_ ? pre_out_(pre_n_ - 1, in) : *in++; }
+
+  uint32_t in_sr_ = 1;
+  uint32_t out_sr_ = 1;
+  Tier tier_ = kFast;
+  uint32_t taps_ = 0;
+  enum Mode : uint8_t { kModeFir, kModeUp2, kModeDown2 };
+  Mode mode_ = kModeFir;
+  const int16_t* coef_ = nullptr;   // [128 位相][taps_]。ハーフバンドは位相 1/2 の片側 K 個
+
+  uint32_t step_fp_ = 1u << 16;     // 16.16 fixed: in_sr/out_sr
+  uint32_t pos_fp_ = 0;
+
+  // 直近 kMaxTaps 個の入力を2回並べて持つ（窓が常に連続する）
+  int16_t hist_[kMaxTaps * 2]{};
+  uint32_t w_ = 0;
+  uint32_t zero_run_ = kMaxTaps;
+
+  // 前段のハーフバンド。窓は最大 31（K = 8）なので各段 32 個を2回並べる
+  static constexpr uint32_t kPreHist = 32;
+  struct PreStage {
+    int16_t hist[kPreHist * 2];
+    uint32_t w;
+    uint32_t zero_run;
+  };
+  PreStage pre_[kMaxPreStages]{};
+  uint32_t pre_n_ = 0;
+  uint32_t pre_k_ = 1;                  // 係数の数（窓は 4K-1）
+  const int16_t* pre_coef_ = nullptr;
+};
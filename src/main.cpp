@@ -1,22 +1,30 @@
 #include <M5Unified.h>
 #include <LittleFS.h>
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <string>
 #include <string.h>
+#include <stdlib.h>
 
 #include "app_config.hpp"
 
 #include "vgm/track_manager.hpp"
 #include "vgm/vgm_blob.hpp"
 #include "vgm/vgm_player.hpp"
+#include "vgm/vgm_chips.hpp"
 
 #include "opn/opn_state.hpp"
 #include "opm/opm_state.hpp"
 #include "dsp/spectrum.hpp"
+#include "dsp/resampler.hpp"
 #include "ui/ui_renderer.hpp"
 
 #include "audio/audio_engine.hpp"
-#include "ym2203_wrap.hpp"
+#include "audio/quality_governor.hpp"
+#include "common/hot_path.hpp"
+#include "common/seq_snapshot.hpp"
+#include "ymfm_opn.h"
 #include "mdx/mdx_blob.hpp"
 #include "mdx/mdx_player.hpp"
 
@@ -33,7 +41,28 @@ static Spectrum spec;
 static UIRenderer ui;
 
 static AudioEngine audio;
-static YM2203Wrap* chip = nullptr;
+static QualityGovernor governor;
+
+// HOT_PATH_REPORT 用（サイクル数は CPU クロック、32bit なので1区間毎の差だけ使う）。
+// 生成側と UI 側で別々に溜め、生成側の区間は SeqSnapshot で loop() へ渡す
+struct RenderStats {
+  uint64_t cycles = 0;
+  uint32_t samples = 0;
+  uint32_t max = 0;     // 1ブロックの最大
+  uint32_t since_ms = 0;
+};
+struct UiStats {
+  uint64_t cycles = 0;
+  uint32_t frames = 0;
+  uint32_t max = 0;
+  uint32_t since_ms = 0;
+};
+static RenderStats render_stats;                  // 生成タスクだけ
+static SeqSnapshot<RenderStats> render_stats_pub;
+static RenderStats ui_render_stats;               // loop() が最後に写した区間
+static uint32_t ui_render_stats_gen = 0;
+static UiStats ui_stats;                          // loop() だけ
+static VGMChipSet chips;
 static bool is_mdx = false;
 
 static uint32_t last_ui = 0;
@@ -41,27 +70,85 @@ static int volume = VOLUME_DEFAULT;
 
 static uint32_t last_vol_tick = 0;
 static uint32_t last_vol_show = 0;
-
-
-// ===== resample state (chip_sr -> OUT_SR) =====
-static uint32_t rs_step_fp = 0;   // 16.16 fixed: chip_sr/OUT_SR
-static uint32_t rs_frac = 0;
-static int16_t  rs_last = 0;
-
-// ===== MDX render/downsample state (MDX_RENDER_SR -> OUT_SR) =====
-static std::array<int16_t, MDX_RENDER_BLOCK_SAMPLES> mdx_buf{};
-static size_t mdx_buf_pos = 0;
-static size_t mdx_buf_len = 0;
-static uint32_t mdx_rs_step_fp = 0;  // 16.16 fixed: mdx_sr/OUT_SR
-static uint32_t mdx_rs_pos_fp = 0;
-static int16_t mdx_rs_s_1 = 0;
-static int16_t mdx_rs_s0 = 0;
-static int16_t mdx_rs_s1 = 0;
-static int16_t mdx_rs_s2 = 0;
-static bool mdx_rs_ready = false;
+// ch ミュート（bit はメータの並び：VGM は FM1-3 / SSG1-3、MDX は FM1-8 / PCM8 の8本）。
+// loop() 側で持ち、生成タスクへは kOpMute で送る。曲が変わったら 0 に戻す
+static uint32_t mute_mask = 0;
+static uint32_t last_ff_tick = 0;
+// シークできる曲の早送り長押しは位置だけ動かし（表示もこれ）、離した所で1回シークする
+static bool scrubbing = false;
+static uint32_t scrub_ms = 0;
+
+// serial command line
+static char serial_line[64];
+static size_t serial_len = 0;
+
+// loop() → 生成タスク（AudioEngine::post）。曲の操作はすべて生成タスクの中で行う
+enum AudioOp : uint8_t {
+  kOpNext = 1,
+  kOpPrev,
+  kOpFastForward,   // arg: ms
+  kOpSeek,          // arg: ms
+  kOpMute,          // arg: mute_mask
+};
+
+// 生成タスク → UI。数値はブロック毎に書き直す（表示用なので1つずつ読めれば十分。順序は要らないので relaxed）
+struct PlayStatus {
+  std::atomic<uint32_t> position_ms{0};
+  std::atomic<uint32_t> length_ms{0};
+  std::atomic<int32_t> load_pct{-1};
+  std::atomic<uint32_t> channels{0};
+  std::atomic<bool> is_mdx{false};
+  std::atomic<bool> seekable{false};
+};
+static PlayStatus play_status;
+// メータとスペクトラム。opn_state / opm_state / spec は生成タスクだけが触り、
+// UI_FPS_MS 毎に更新した結果をここへ出す（loop() は写しだけを描く）
+struct UiFrame {
+  MeterState meters;
+  SpectrumState spec;
+};
+static SeqSnapshot<UiFrame> ui_frame_pub;
+static UiFrame ui_frame;
+static uint32_t ui_frame_gen = 0;
+static uint32_t last_meter_update = 0;   // 生成タスク側
+// 曲名。ロード毎のほか、ストリーミングの GD3 が終端で届いた時にも出し直す
+struct TrackTitle {
+  char text[128];
+};
+static SeqSnapshot<TrackTitle> title_pub;
+static uint32_t title_gd3_serial = 0;   // 生成タスク：曲名に使った blob.gd3_serial()
+static TrackTitle ui_title_copy;
+static uint32_t ui_title_gen = 0;
+static std::string ui_title;
+// 曲が変わった回数（UI はミュートを戻す）。曲名の出し直しでは進めない
+static std::atomic<uint32_t> track_gen{0};
+static uint32_t ui_track_gen = 0;   // loop() が最後に見た値
+
+// スピーカの出力レート（AUDIO_NATIVE_RATE なら曲毎に変わる）
+static uint32_t out_sr = OUT_SR;
+// VGM の tick（OUT_SR）→ out_sr の換算で持ち越す端数（単位は out_sr / OUT_SR サンプル）
+static uint32_t vgm_tick_rem = 0;
+
+// ===== MDX render/downsample state (MDX_RENDER_SR -> out_sr) =====
+static std::array<int16_t, MDX_RENDER_BLOCK_SAMPLES> mdx_buf{};   // render rate の入力
+static Resampler mdx_rs;             // mdx_render_sr → out_sr
 static uint32_t mdx_render_sr = MDX_RENDER_SR_DEFAULT;
 static int32_t mdx_lpf_y_q15 = 0;
 
+// 品質段階（QG_LEVEL_COUNT 個、0 が最も軽い）
+struct QualityTier {
+  ymfm::opn_fidelity opn_fidelity;
+  Resampler::Tier resample;   // MDX とチップのレーン共通
+  uint32_t mdx_fm_sr;     // ロード時にだけ効く（MXDRV は開始時にレートが決まる）
+};
+static constexpr QualityTier kQualityTiers[] = {
+  { ymfm::OPN_FIDELITY_MIN, Resampler::kLinear, MDX_RENDER_SR_DEFAULT },
+  { ymfm::OPN_FIDELITY_MIN, Resampler::kFast,   MDX_RENDER_SR_DEFAULT },
+  { ymfm::OPN_FIDELITY_MED, Resampler::kGood,   MDX_RENDER_SR_HQ },
+};
+static_assert(sizeof(kQualityTiers) / sizeof(kQualityTiers[0]) == QG_LEVEL_COUNT,
+              "kQualityTiers must match QG_LEVEL_COUNT");
+
 // ===================== Helpers =====================
 static bool ends_with_i(const std::string& s, const char* suf) {
   size_t a = s.size();
@@ -70,34 +157,142 @@ static bool ends_with_i(const std::string& s, const char* suf) {
   return strcasecmp(s.c_str() + (a - b), suf) == 0;
 }
 
+static void render_vgm_block(int16_t* dst, int n);
+static void publish_title();
+
+// VGM の tick で ticks 分、書き込みを適用しながらチップを回して出力は捨てる
+static void clock_vgm_ticks(uint32_t ticks) {
+  while (ticks > 0) {
+    const uint32_t t = player.step_span(ticks);
+    if (t == 0) break;
+    ticks -= t;
+    const uint64_t acc = (uint64_t)t * out_sr + vgm_tick_rem;
+    chips.clock_only((uint32_t)(acc / OUT_SR));
+    vgm_tick_rem = (uint32_t)(acc % OUT_SR);
+  }
+}
+
+// VGM：書き込みだけで進めた後、着地点の手前 FF_CLOCK_MS はチップを回し、
+// 最後の FF_SETTLE_MS は生成して捨てる（app_config.hpp 参照）
+static void fast_forward_ms(uint32_t ms) {
+  if (is_mdx) {
+    mdx_player.fast_forward_ms(ms);
+  } else if (!chips.empty()) {
+    const uint32_t settle_ms = ms < FF_SETTLE_MS ? ms : FF_SETTLE_MS;
+    const uint32_t clock_ms = std::min(ms - settle_ms, FF_CLOCK_MS);
+    player.fast_forward((uint32_t)(((uint64_t)(ms - settle_ms - clock_ms) * OUT_SR) / 1000));
+    clock_vgm_ticks((uint32_t)(((uint64_t)clock_ms * OUT_SR) / 1000));
+    static int16_t discard[256];
+    uint32_t left = (uint32_t)(((uint64_t)settle_ms * out_sr) / 1000);
+    while (left > 0 && player.playing()) {
+      const uint32_t k = std::min(left, (uint32_t)(sizeof(discard) / sizeof(discard[0])));
+      render_vgm_block(discard, (int)k);
+      left -= k;
+    }
+  }
+}
+
+// 表示用の再生位置（ループ曲は2周目以降をループ区間に折り返す）
+static uint32_t play_position_ms() {
+  if (is_mdx) {
+    uint32_t pos = mdx_player.position_ms();
+    uint32_t len = mdx_player.length_ms();
+    uint32_t loop = mdx_player.loop_ms();
+    if (loop != 0 && len >= loop && pos >= len) {
+      uint32_t intro = len - loop;
+      pos = intro + (pos - intro) % loop;
+    }
+    return pos;
+  }
+  return (uint32_t)(((uint64_t)player.position() * 1000) / OUT_SR);
+}
+
+static uint32_t track_length_ms() {
+  if (is_mdx) return mdx_player.length_ms();
+  return (uint32_t)(((uint64_t)player.length() * 1000) / OUT_SR);
+}
+
+static const QualityTier& quality_tier() {
+  return kQualityTiers[QG_ENABLE ? governor.level() : QG_LEVEL_DEFAULT];
+}
+
+// スペクトラムの列を音源の帯域（native rate と出力レートの低い方の半分）までに合わせる
+static float vgm_bin_scale() {
+  const uint32_t src = chips.source_rate();
+  if (src == 0 || src >= out_sr) return 1.0f;
+  return (float)src / (float)out_sr;
+}
+
+// 再生中に変えられるものだけ反映（MDX のレートは次のロードから）
+static void apply_quality() {
+  const QualityTier& q = quality_tier();
+  mdx_rs.set_tier(q.resample);
+  mdx_player.set_resample_tier(q.resample);
+  chips.set_resample_tier(q.resample);
+  if (!is_mdx && !chips.empty()) {
+    chips.set_opn_fidelity(q.opn_fidelity);   // AUDIO_NATIVE_RATE の間は setup の値のまま
+    spec.set_bin_scale(vgm_bin_scale());
+  }
+  if (QG_LOG) {
+    Serial.printf("[quality] level %u (load %u%%)\n",
+                  (unsigned)governor.level(), (unsigned)governor.load_pct());
+  }
+}
+
+static void bench_fast_forward(uint32_t len_ms) {
+  uint32_t t0 = micros();
+  fast_forward_ms(len_ms);
+  if (is_mdx) mdx_player.finish_fast_forward();
+  uint32_t us = micros() - t0;
+  float x = us ? (float)len_ms * 1000.0f / (float)us : 0.0f;
+  Serial.printf("[ff bench] %s: %u ms in %u us (x%.1f realtime)\n",
+                tracks.current().c_str(), (unsigned)len_ms, (unsigned)us, x);
+}
+
+// 曲のロード時に出力レートを決める（スピーカは送り出し側が前の曲を鳴らし切ってから掛け直す）
+static void set_output_rate(uint32_t sr) {
+  out_sr = sr;
+  audio.set_sample_rate(sr);
+}
+
 static bool load_current_track() {
   if (tracks.empty()) return false;
 
   const std::string& path = tracks.current();
+  // 段階は曲をまたいで引き継ぎ、負荷の平均だけ測り直す
+  governor.reset(governor.level());
+  chips.set_resample_tier(quality_tier().resample);
+  mdx_player.set_resample_tier(quality_tier().resample);
+
   if (ends_with_i(path, ".mdx")) {
     is_mdx = true;
+    player.clear();
     blob.clear();
-    delete chip;
-    chip = nullptr;
+    chips.clear();
 
     if (!mdx_blob.load_from_file(path.c_str())) return false;
     opm_state.reset();
     spec.reset();
     mdx_player.stop();
-    if (!mdx_player.load(mdx_blob.data(), mdx_blob.size(), opm_state, path.c_str())) return false;
-    mdx_buf_pos = 0;
-    mdx_buf_len = 0;
+    if (!mdx_player.load(mdx_blob.data(), mdx_blob.size(), opm_state, path.c_str(),
+                         quality_tier().mdx_fm_sr)) {
+      return false;
+    }
     mdx_render_sr = mdx_player.render_sample_rate();
     if (mdx_render_sr == 0) mdx_render_sr = MDX_RENDER_SR_DEFAULT;
-    mdx_rs_step_fp = (uint32_t)(((uint64_t)mdx_render_sr << 16) / OUT_SR);
-    mdx_rs_pos_fp = 0;
-    mdx_rs_s_1 = 0;
-    mdx_rs_s0 = 0;
-    mdx_rs_s1 = 0;
-    mdx_rs_s2 = 0;
-    mdx_rs_ready = false;
+    set_output_rate(AUDIO_NATIVE_RATE ? std::min(mdx_render_sr, AUDIO_NATIVE_MAX_SR) : OUT_SR);
+    mdx_rs.configure(mdx_render_sr, out_sr, quality_tier().resample);
     mdx_lpf_y_q15 = 0;
-    spec.set_bin_scale((float)mdx_render_sr / (float)OUT_SR);
+    spec.set_bin_scale((float)std::min(mdx_render_sr, out_sr) / (float)out_sr);
+    Serial.printf("mdx length=%u ms loop=%u ms render=%u Hz\n",
+                  (unsigned)mdx_player.length_ms(), (unsigned)mdx_player.loop_ms(),
+                  (unsigned)mdx_render_sr);
+    if (MDX_OPM_BENCH_ON_LOAD) mdx_player.bench_opm_backends();
+    opm_state.attach_envelope(mdx_player.fm_envelope());
+    if (FF_BENCH_ON_LOAD && mdx_player.length_ms() > 1) {
+      bench_fast_forward(mdx_player.length_ms() - 1);
+      mdx_player.restart();
+    }
     return true;
   }
 
@@ -106,60 +301,42 @@ static bool load_current_track() {
   mdx_player.stop();
   if (!blob.load_from_file(path.c_str())) return false;
 
-  const uint8_t* d = blob.data();
-  if (!d || blob.size() < 0x100) return false;
+  const uint8_t* d = blob.header();
+  if (!d || (blob.format() == VGMFormat::VGM && blob.size() < 0x100)) return false;
 
-  // YM2203 clock in VGM header (0x44)
-  uint32_t clk = (uint32_t)d[0x44] | ((uint32_t)d[0x45] << 8) | ((uint32_t)d[0x46] << 16) | ((uint32_t)d[0x47] << 24);
-  if (clk == 0) return false;
-
-  delete chip;
-  //chip = new YM2203Wrap(clk, ymfm::OPN_FIDELITY_MIN);
-  chip = new YM2203Wrap(clk, ymfm::OPN_FIDELITY_MIN);
+  // ヘッダのクロック欄 (SN76489 / YM2203 / YM2608 / AY8910) からチップを用意
+  if (!chips.setup(d, quality_tier().opn_fidelity, AUDIO_NATIVE_RATE ? AUDIO_NATIVE_MAX_SR : 0)) {
+    return false;
+  }
+  set_output_rate(chips.output_rate());
+  vgm_tick_rem = 0;
 
   opn_state.reset();
   spec.reset();
-  spec.set_bin_scale(1.0f);
-
-  if (!player.load(blob.data(), blob.size(), *chip, opn_state)) return false;
-
-  // reset resampler for new track/clock
-  rs_step_fp = 0;
-  rs_frac = 0;
-  rs_last = 0;
+  spec.set_bin_scale(vgm_bin_scale());
+
+  auto load_player = [&]() {
+    return blob.streaming()
+        ? player.load_stream(blob, chips, opn_state)
+        : player.load(blob.data(), blob.size(), chips, opn_state);
+  };
+  if (!load_player()) return false;
+
+  Serial.printf("vgm length=%u ms loop=%u ms\n",
+                (unsigned)track_length_ms(),
+                (unsigned)(((uint64_t)player.loop_length() * 1000) / OUT_SR));
+  if (FF_BENCH_ON_LOAD) {
+    uint32_t len_ms = track_length_ms();
+    bench_fast_forward(len_ms ? len_ms : 60000);
+    chips.reset();
+    opn_state.reset();
+    if (!load_player()) return false;
+  }
 
   return true;
 }
 
-// ===== resample state (chip_sr -> OUT_SR) =====
-//static uint32_t rs_step_fp = 0;   // chip_sr/OUT_SR (16.16)
-static uint32_t rs_pos_fp  = 0;   // 0..65535
-static int16_t  rs_s0 = 0, rs_s1 = 0;
-
-static inline int16_t lerp_i16(int16_t a, int16_t b, uint32_t t16) {
-  int32_t da = (int32_t)b - (int32_t)a;
-  int32_t v  = (int32_t)a + (da * (int32_t)t16 >> 16);
-  if (v < -32768) v = -32768;
-  if (v >  32767) v =  32767;
-  return (int16_t)v;
-}
-
-static inline int16_t cubic_i16(int16_t s_1, int16_t s0, int16_t s1, int16_t s2, uint32_t t16) {
-  int64_t t = t16;
-  int64_t t2 = (t * t) >> 16;
-  int64_t t3 = (t2 * t) >> 16;
-  int64_t a0 = 2LL * s0;
-  int64_t a1 = (int64_t)(-s_1 + s1);
-  int64_t a2 = (int64_t)(2 * s_1 - 5 * s0 + 4 * s1 - s2);
-  int64_t a3 = (int64_t)(-s_1 + 3 * s0 - 3 * s1 + s2);
-  int64_t y = a0 + ((a1 * t) >> 16) + ((a2 * t2) >> 16) + ((a3 * t3) >> 16);
-  y >>= 1;
-  if (y < -32768) y = -32768;
-  if (y > 32767) y = 32767;
-  return (int16_t)y;
-}
-
-static inline int16_t mdx_lpf(int16_t x) {
+static inline int16_t HOT_FN mdx_lpf(int16_t x) {
   if (MDX_LPF_ALPHA_Q15 <= 0) return x;
   int32_t y = mdx_lpf_y_q15;
   int32_t xq = ((int32_t)x) << 15;
@@ -171,89 +348,278 @@ static inline int16_t mdx_lpf(int16_t x) {
   return (int16_t)out;
 }
 
-static inline int16_t mdx_next_sample() {
-  if (!mdx_player.playing()) return 0;
-  if (mdx_buf_pos >= mdx_buf_len) {
-    mdx_buf_len = MDX_RENDER_BLOCK_SAMPLES;
-    mdx_player.render_mono(mdx_buf.data(), (int)mdx_buf_len);
-    mdx_buf_pos = 0;
-  }
-  return mdx_lpf(mdx_buf[mdx_buf_pos++]);
+// render rate で n サンプル。LPF は端数比の時だけ（2倍はハーフバンドの阻止域で足りる）
+static void HOT_FN mdx_render_input(int16_t* dst, uint32_t n) {
+  mdx_player.render_mono(dst, (int)n);
+  if (mdx_rs.halfband()) return;
+  for (uint32_t i = 0; i < n; ++i) dst[i] = mdx_lpf(dst[i]);
 }
 
-static void init_resampler() {
-  uint32_t chip_sr = chip->sample_rate_native();
-  rs_step_fp = (uint32_t)(((uint64_t)chip_sr << 16) / OUT_SR);
-  rs_pos_fp  = 0;
-  rs_s0 = chip->render_one_mono_i16_and_outputs();
-  rs_s1 = chip->render_one_mono_i16_and_outputs();
-}
-
-static void fill_audio_block(int16_t* dst, int n) {
+// 戻り値: 実際に音源を回したか（無音で埋めただけなら false）
+static bool HOT_FN render_audio_block(int16_t* dst, int n) {
   if (is_mdx) {
-    if (!mdx_player.playing()) {
+    const bool playing = mdx_player.playing();
+    if (!playing) {
       for (int i=0;i<n;i++) dst[i]=0;
     } else {
-      if (mdx_render_sr == OUT_SR) {
+      if (mdx_rs.passthrough()) {
         mdx_player.render_mono(dst, n);
       } else {
-        if (mdx_rs_step_fp == 0) {
-          mdx_rs_step_fp = (uint32_t)(((uint64_t)mdx_render_sr << 16) / OUT_SR);
-        }
-        if (!mdx_rs_ready) {
-          mdx_rs_s_1 = mdx_next_sample();
-          mdx_rs_s0 = mdx_next_sample();
-          mdx_rs_s1 = mdx_next_sample();
-          mdx_rs_s2 = mdx_next_sample();
-          mdx_rs_ready = true;
-        }
-        for (int i = 0; i < n; ++i) {
-          mdx_rs_pos_fp += mdx_rs_step_fp;
-          while (mdx_rs_pos_fp >= (1u << 16)) {
-            mdx_rs_pos_fp -= (1u << 16);
-            mdx_rs_s_1 = mdx_rs_s0;
-            mdx_rs_s0 = mdx_rs_s1;
-            mdx_rs_s1 = mdx_rs_s2;
-            mdx_rs_s2 = mdx_next_sample();
-          }
-          dst[i] = cubic_i16(mdx_rs_s_1, mdx_rs_s0, mdx_rs_s1, mdx_rs_s2, mdx_rs_pos_fp);
+        const uint32_t span = mdx_rs.output_for((uint32_t)mdx_buf.size());
+        for (int i = 0; i < n; ) {
+          const uint32_t k = std::min((uint32_t)(n - i), span);
+          const uint32_t need = mdx_rs.input_for(k);
+          if (need > 0) mdx_render_input(mdx_buf.data(), need);
+          mdx_rs.process(mdx_buf.data(), dst + i, k);
+          i += (int)k;
         }
       }
     }
     spec.push_pcm_block(dst, n);
-    return;
+    return playing;
   }
 
-  if (!chip || !player.playing()) {
+  if (chips.empty() || !player.playing()) {
     for (int i=0;i<n;i++) dst[i]=0;
     spec.push_pcm_block(dst, n);
-    return;
+    return false;
   }
 
-  if (rs_step_fp == 0) init_resampler();
+  render_vgm_block(dst, n);
+  spec.push_pcm_block(dst, n);
+  return true;
+}
 
-  for (int i=0;i<n;i++) {
-    player.step_one_sample(); // VGM時間は44100基準で進める
+// 次のレジスタ書き込みまでを1区間として進める（書き込みはチップ毎に溜め、まとめて生成）
+static void HOT_FN render_vgm_block(int16_t* dst, int n) {
+  chips.begin_block(dst);
+  int i = 0;
+  while (i < n) {
+    const uint32_t left = (uint32_t)(n - i);
+    uint32_t k;
+    if (out_sr == OUT_SR) {
+      k = player.step_span(left);
+    } else {
+      // tick は OUT_SR のまま進め、出力サンプルへは端数を持ち越して換算（left を超えない tick 数まで）
+      const uint32_t max_ticks =
+          (uint32_t)((((uint64_t)left + 1) * OUT_SR - 1 - vgm_tick_rem) / out_sr);
+      const uint32_t t = player.step_span(max_ticks);
+      const uint64_t acc = (uint64_t)t * out_sr + vgm_tick_rem;
+      k = (uint32_t)(acc / OUT_SR);
+      vgm_tick_rem = (uint32_t)(acc % OUT_SR);
+      if (t != 0 && k == 0) continue;   // 同じ出力サンプル内で次の書き込み
+    }
+    if (k == 0) k = left;  // 再生終了：ブロックの残りはそのまま鳴らし切る
+    chips.advance(k);
+    i += (int)k;
+  }
+  chips.end_block();
+}
 
-    // rs_pos_fp が 1.0(65536) 以上進む分だけ chip を進める
-    rs_pos_fp += rs_step_fp;
-    while (rs_pos_fp >= (1u << 16)) {
-      rs_pos_fp -= (1u << 16);
-      rs_s0 = rs_s1;
-      rs_s1 = chip->render_one_mono_i16_and_outputs();
+// メータ・スペクトラムを進めて UI へ出す（生成タスクから、UI_FPS_MS 毎）
+static void update_ui_frame(uint32_t now) {
+  if (now - last_meter_update < UI_FPS_MS) return;
+  last_meter_update = now;
+  if (is_mdx) {
+    const bool pcm = mdx_player.pdx_loaded();
+    opm_state.set_pcm_enabled(pcm);
+    opm_state.set_pcm_mask(pcm ? mdx_player.pcm_mask() : 0);
+    opm_state.update(now);
+  } else {
+    opn_state.update(now);
+  }
+  spec.update(now);
+
+  UiFrame& f = ui_frame_pub.back();
+  f.meters = is_mdx ? opm_state.meters() : opn_state.meters();
+  f.spec = spec.state();
+  ui_frame_pub.publish();
+}
+
+static void HOT_FN fill_audio_block(int16_t* dst, int n) {
+  const uint32_t t0 = micros();
+  const uint32_t c0 = ESP.getCycleCount();
+  const bool active = render_audio_block(dst, n);
+  const uint32_t now = millis();
+  if (HOT_PATH_REPORT) {
+    if (active) {
+      const uint32_t c = ESP.getCycleCount() - c0;
+      render_stats.cycles += c;
+      render_stats.samples += (uint32_t)n;
+      if (c > render_stats.max) render_stats.max = c;
+    }
+    if (now - render_stats.since_ms >= HOT_PATH_REPORT_MS) {
+      render_stats_pub.back() = render_stats;
+      render_stats_pub.publish();
+      render_stats = {};
+      render_stats.since_ms = now;
     }
+  }
+  if (QG_ENABLE && active &&
+      governor.on_block(micros() - t0, (uint32_t)n, out_sr, now)) {
+    apply_quality();
+  }
+
+  play_status.position_ms.store(play_position_ms(), std::memory_order_relaxed);
+  play_status.load_pct.store(QG_ENABLE ? (int32_t)governor.load_pct() : -1, std::memory_order_relaxed);
+  if (!is_mdx && blob.gd3_serial() != title_gd3_serial) publish_title();
+  update_ui_frame(now);
+}
+
+// 生成側は最後に受け取った区間、UI 側は自分の区間
+static void hot_path_report(uint32_t now) {
+  if (now - ui_stats.since_ms < HOT_PATH_REPORT_MS) return;
+  render_stats_pub.read(ui_render_stats, ui_render_stats_gen);
+  const RenderStats& r = ui_render_stats;
+  const UiStats& u = ui_stats;
+  Serial.printf("[hot path] placed=%d render %u cycles/sample (max %u/block), ui %u cycles/frame (max %u)\n",
+                HOT_PATH_PLACED,
+                (unsigned)(r.samples ? r.cycles / r.samples : 0),
+                (unsigned)r.max,
+                (unsigned)(u.frames ? u.cycles / u.frames : 0),
+                (unsigned)u.max);
+  ui_stats = {};
+  ui_stats.since_ms = now;
+}
 
-    dst[i] = lerp_i16(rs_s0, rs_s1, rs_pos_fp);
+static uint32_t channel_count() {
+  if (is_mdx) return mdx_player.pdx_loaded() ? 16 : 8;
+  return 6;
+}
+
+// 曲名を UI へ出す（生成タスク / setup から）
+static void publish_title() {
+  std::string title;
+  if (is_mdx) {
+    title = mdx_player.title();
+  } else {
+    title = blob.gd3_track_name_jp();
+    if (title.empty()) title = blob.gd3_track_name_en();
   }
+  if (title.empty()) title = tracks.empty() ? std::string("(no track)") : tracks.current();
 
-  spec.push_pcm_block(dst, n);
+  char* dst = title_pub.back().text;
+  strncpy(dst, title.c_str(), sizeof(TrackTitle::text) - 1);
+  dst[sizeof(TrackTitle::text) - 1] = 0;
+  title_pub.publish();
+  title_gd3_serial = blob.gd3_serial();
+}
+
+// ロード後に UI へ見せるものを出す（生成タスク / setup から）
+static void publish_track() {
+  publish_title();
+  play_status.is_mdx.store(is_mdx, std::memory_order_relaxed);
+  play_status.seekable.store(!is_mdx && player.seekable(), std::memory_order_relaxed);
+  play_status.channels.store(channel_count(), std::memory_order_relaxed);
+  play_status.length_ms.store(track_length_ms(), std::memory_order_relaxed);
+  play_status.position_ms.store(play_position_ms(), std::memory_order_relaxed);
+  audio.telemetry().begin_track(tracks.empty() ? "" : tracks.current().c_str());
+  track_gen.fetch_add(1, std::memory_order_release);
+}
+
+static void step_track(bool next) {
+  if (next) tracks.next();
+  else tracks.prev();
+  load_current_track();
+  publish_track();
+}
+
+static void apply_mute(uint32_t mask) {
+  if (is_mdx) mdx_player.set_mute_mask((uint16_t)mask);
+  else if (!chips.empty()) chips.set_mute_mask((uint8_t)mask);
+}
+
+// キーフレームから着地点の VGM_SEEK_SETTLE_MS 手前へ飛び、残りは早送りと同じくチップを回して進める
+static bool seek_ms(uint32_t ms) {
+  if (is_mdx || !player.seekable()) return false;
+  const uint32_t lead = std::min(ms, VGM_SEEK_SETTLE_MS);
+  if (!player.seek((uint32_t)(((uint64_t)(ms - lead) * OUT_SR) / 1000))) return false;
+  vgm_tick_rem = 0;
+  fast_forward_ms(lead);
+  return true;
+}
+
+// 生成タスクの中で（loop() からは post で来る）
+static void run_audio_command(const AudioCommand& c) {
+  switch (c.op) {
+    case kOpNext: step_track(true); break;
+    case kOpPrev: step_track(false); break;
+    case kOpFastForward: fast_forward_ms(c.arg); break;
+    case kOpSeek: {
+      const bool ok = seek_ms(c.arg);
+      Serial.printf("seek %u ms -> %s\n", (unsigned)c.arg, ok ? "ok" : "unsupported");
+      break;
+    }
+    case kOpMute: apply_mute(c.arg); break;
+    default: break;
+  }
+}
+
+static void post_mute() {
+  audio.post(kOpMute, mute_mask);
+  Serial.printf("mute mask=0x%04x\n", (unsigned)mute_mask);
+}
+
+// 1行コマンド: "seek <sec>" / "mute <ch>" / "solo <ch>" / "unmute"（ch は 1 始まり、メータの並び）/
+// "stats"（音声経路の計測）/ "stats reset"
+static void handle_serial_line(const char* line) {
+  const uint32_t channels = play_status.channels.load(std::memory_order_relaxed);
+  const bool mute = strncmp(line, "mute ", 5) == 0;
+  if (mute || strncmp(line, "solo ", 5) == 0) {
+    const uint32_t ch = (uint32_t)strtoul(line + 5, nullptr, 10);
+    if (ch == 0 || ch > channels) {
+      Serial.printf("%s: ch 1-%u\n", mute ? "mute" : "solo", (unsigned)channels);
+      return;
+    }
+    const uint32_t bit = 1u << (ch - 1);
+    const uint32_t all = (1u << channels) - 1;
+    if (mute) mute_mask ^= bit;
+    else mute_mask = (mute_mask == (all & ~bit)) ? 0 : (all & ~bit);   // もう一度で解除
+    post_mute();
+    return;
+  }
+  if (strcmp(line, "unmute") == 0) {
+    mute_mask = 0;
+    post_mute();
+    return;
+  }
+  if (strncmp(line, "seek ", 5) == 0) {
+    audio.post(kOpSeek, (uint32_t)strtoul(line + 5, nullptr, 10) * 1000);
+    return;
+  }
+  if (strcmp(line, "stats") == 0) {
+    audio.telemetry().print();
+    return;
+  }
+  if (strcmp(line, "stats reset") == 0) {
+    audio.telemetry().reset();
+    Serial.println("[stats] reset");
+    return;
+  }
+  Serial.printf("unknown command: %s\n", line);
 }
 
+static void poll_serial() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c < 0) break;
+    if (c == '\r' || c == '\n') {
+      if (serial_len > 0) {
+        serial_line[serial_len] = 0;
+        handle_serial_line(serial_line);
+        serial_len = 0;
+      }
+    } else if (serial_len + 1 < sizeof(serial_line)) {
+      serial_line[serial_len++] = (char)c;
+    }
+  }
+}
 
 void setup() {
   Serial.begin(115200);
   uint32_t t0 = millis();
   while (!Serial && millis() - t0 < 600) delay(10);
+  if (RESAMPLER_BENCH_ON_BOOT) Resampler::bench();
 
   auto cfg = M5.config();
   M5.begin(cfg);
@@ -278,17 +644,20 @@ void setup() {
 
   opn_state.reset();
   opm_state.reset();
+  governor.reset(QG_LEVEL_DEFAULT);
 
   tracks.scan();
   if (tracks.empty()) {
-    Serial.println("No .vgm/.vgz/.mdx in LittleFS root");
+    Serial.println("No .vgm/.vgz/.vgc/.s98/.mdx in LittleFS root");
   } else {
     bool ok = load_current_track();
     Serial.printf("load_current_track=%d (%s)\n", ok ? 1 : 0, tracks.current().c_str());
   }
+  publish_track();
 
   ui.begin(M5.Display);
-  audio.begin(OUT_SR, AUDIO_CHANNEL);
+  // ここから先、曲と音源を触るのは生成タスクだけ
+  audio.begin(out_sr, AUDIO_CHANNEL, fill_audio_block, run_audio_command);
 }
 
 void loop() {
@@ -300,14 +669,35 @@ void loop() {
   bool hold_b = M5.BtnB.isHolding();
 
   if (!(hold_a || hold_b)) last_vol_tick = 0;
+  if (!(hold_a && hold_b)) {
+    last_ff_tick = 0;
+    if (scrubbing) {
+      audio.post(kOpSeek, scrub_ms);
+      scrubbing = false;
+    }
+  }
 
-  if (hold_b && !hold_a) {
+  if (hold_a && hold_b) {
+    // 両方長押し：シークできる曲は位置だけ送って離した所へシーク、それ以外は早送り（PCM を作らずに進める）
+    if (last_ff_tick == 0 || now - last_ff_tick >= FF_REPEAT_MS) {
+      if (play_status.seekable.load(std::memory_order_relaxed)) {
+        if (!scrubbing) scrub_ms = play_status.position_ms.load(std::memory_order_relaxed);
+        scrubbing = true;
+        scrub_ms += FF_RATE * FF_REPEAT_MS;
+        const uint32_t len = play_status.length_ms.load(std::memory_order_relaxed);
+        if (len > 0 && scrub_ms >= len) scrub_ms = len - 1;
+      } else {
+        audio.post(kOpFastForward, FF_RATE * FF_REPEAT_MS);
+      }
+      last_ff_tick = now;
+    }
+  } else if (hold_b && !hold_a) {
     if (last_vol_tick == 0 || now - last_vol_tick >= VOLUME_REPEAT_MS) {
       int next = volume - VOLUME_STEP;
       if (next < VOLUME_MIN) next = VOLUME_MIN;
       if (next != volume) {
         volume = next;
-        M5.Speaker.setVolume(volume);
+        audio.set_volume((uint8_t)volume);
         last_vol_show = now;
       }
       last_vol_tick = now;
@@ -318,56 +708,53 @@ void loop() {
       if (next > VOLUME_MAX) next = VOLUME_MAX;
       if (next != volume) {
         volume = next;
-        M5.Speaker.setVolume(volume);
+        audio.set_volume((uint8_t)volume);
         last_vol_show = now;
       }
       last_vol_tick = now;
     }
   }
 
-  if (M5.BtnA.wasClicked()) { tracks.next(); load_current_track(); }
-  if (M5.BtnB.wasClicked()) { tracks.prev(); load_current_track(); }
+  if (M5.BtnA.wasClicked()) audio.post(kOpNext);
+  if (M5.BtnB.wasClicked()) audio.post(kOpPrev);
+  poll_serial();
 
-  // audio pump
-  const bool pcm_heavy = is_mdx && mdx_player.pdx_loaded();
-  audio.pump(fill_audio_block, pcm_heavy);
+  // 生成タスクが作れなかった時だけここで生成・送り出し
+  audio.pump();
 
-  // UI 30fps
-  const uint32_t ui_interval = pcm_heavy ? UI_FPS_MS_PCM : UI_FPS_MS;
-  if (now - last_ui >= ui_interval) {
-    last_ui = now;
-    if (is_mdx) {
-      bool pcm = mdx_player.pdx_loaded();
-      opm_state.set_pcm_enabled(pcm);
-      if (pcm) {
-        opm_state.set_pcm_mask(mdx_player.pcm_mask());
-      } else {
-        opm_state.set_pcm_mask(0);
-      }
-      opm_state.update(now);
-    } else {
-      opn_state.update(now);
-    }
-    spec.update(now);
-    std::string title;
-    if (is_mdx) {
-      title = mdx_player.title();
-    } else {
-      title = blob.gd3_track_name_jp();
-      if (title.empty()) title = blob.gd3_track_name_en();
-    }
-    if (title.empty()) title = tracks.empty() ? std::string("(no track)") : tracks.current();
+  // 曲名は新しいのが出ていたら写す（書き換え中に当たったら次の周で）。曲が変わったらミュートを戻す
+  if (title_pub.read(ui_title_copy, ui_title_gen)) ui_title = ui_title_copy.text;
+  const uint32_t gen = track_gen.load(std::memory_order_acquire);
+  if (gen != ui_track_gen) {
+    ui_track_gen = gen;
+    mute_mask = 0;
+  }
 
-    const MeterState& meters = is_mdx ? opm_state.meters() : opn_state.meters();
+  // UI 30fps（メータ・スペクトラムは生成タスクが出した最新の写し）
+  if (now - last_ui >= UI_FPS_MS) {
+    last_ui = now;
+    ui_frame_pub.read(ui_frame, ui_frame_gen);
     bool show_vol = (last_vol_show != 0) && ((now - last_vol_show) <= VOLUME_SHOW_MS);
+    const uint32_t ui_c0 = ESP.getCycleCount();
     ui.draw(now,
-            spec.state(),
-            meters,
-            title,
-            player.writes(),
-            player.position(),
+            ui_frame.spec,
+            ui_frame.meters,
+            ui_title,
+            scrubbing ? scrub_ms : play_status.position_ms.load(std::memory_order_relaxed),
+            play_status.length_ms.load(std::memory_order_relaxed),
             volume,
-            show_vol);
+            show_vol,
+            mute_mask,
+            play_status.load_pct.load(std::memory_order_relaxed),
+            AUDIO_STATS_ON_SCREEN ? (int)audio.telemetry().underruns() : -1,
+            (int)audio.buffered_blocks());
+    if (HOT_PATH_REPORT) {
+      const uint32_t c = ESP.getCycleCount() - ui_c0;
+      ui_stats.cycles += c;
+      ++ui_stats.frames;
+      if (c > ui_stats.max) ui_stats.max = c;
+    }
   }
+  if (HOT_PATH_REPORT) hot_path_report(now);
   delay(1);
 }
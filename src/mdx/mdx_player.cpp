@@ -2,10 +2,13 @@
 #include "../app_config.hpp"
 #include "../opm/opm_state.hpp"
 #include "../encoding/sjis_utf8.hpp"
+#include "../ym2151_wrap.hpp"
+#include "../common/hot_path.hpp"
 #include <Arduino.h>
 #include <LittleFS.h>
 #include <algorithm>
 #include <limits>
+#include <new>
 #include <string.h>
 #include <stdlib.h>
 
@@ -16,18 +19,129 @@ static bool ieq_str(const std::string& a, const std::string& b) {
 namespace {
 constexpr uint32_t kPoolMarginBytes = 512 * 1024;
 constexpr uint32_t kPoolMinBytes = 2 * 1024 * 1024;
+// MXDRV_PlayAt のループ回数（実質無限：通常再生と同じく止まらない）
+constexpr int kPlayAtLoops = 0x7FFF;
 }  // namespace
 
-MDXPlayer::MDXPlayer() = default;
+// portable_mdx の _iocs_opmset から呼ばれるフック（scripts/patch_portable_mdx.py が入れる）。
+// パッチが当たっていなければ portable_mdx_opm_write_hook_patched は weak で未定義のまま。
+// 同じスクリプトが X68Sound の OPM 8ch ループをフックが入っている間だけ飛ばすようにする
+// （当たれば portable_mdx_opm_bypass_patched が定義される）
+extern "C" {
+uint8_t (*portable_mdx_opm_write_hook)(void* user, uint8_t reg, uint8_t data) = nullptr;
+void* portable_mdx_opm_write_hook_user = nullptr;
+extern const int portable_mdx_opm_write_hook_patched __attribute__((weak));
+extern const int portable_mdx_opm_bypass_patched __attribute__((weak));
+}
 
-void MDXPlayer::reset_internal_() {
-  if (ctx_ready_) {
-    MXDRV_Stop(&ctx_);
-    MXDRV_End(&ctx_);
-    MxdrvContext_Terminate(&ctx_);
-    ctx_ready_ = false;
-    ctx_pool_size_ = 0;
+MDXPlayer::MDXPlayer() {
+  set_opm_backend(MDX_OPM_BACKEND);
+}
+
+MDXPlayer::~MDXPlayer() {
+  set_opm_backend(MDX_OPM_BACKEND_X68SOUND);
+  reset_internal_();
+  release_context_();
+  delete opm_;
+  opm_ = nullptr;
+}
+
+bool MDXPlayer::ymfm_available() {
+  return &portable_mdx_opm_write_hook_patched != nullptr;
+}
+
+bool MDXPlayer::x68sound_opm_bypassed() {
+  return &portable_mdx_opm_bypass_patched != nullptr;
+}
+
+bool MDXPlayer::set_opm_backend(uint8_t backend) {
+  if (backend == MDX_OPM_BACKEND_YMFM && !ymfm_available()) return false;
+  opm_backend_ = backend;
+  if (backend == MDX_OPM_BACKEND_YMFM) {
+    portable_mdx_opm_write_hook_user = this;
+    portable_mdx_opm_write_hook = &MDXPlayer::opm_write_hook_;
+  } else {
+    portable_mdx_opm_write_hook = nullptr;
+    portable_mdx_opm_write_hook_user = nullptr;
   }
+  fm_keyon_mask_ = 0;
+  fm_kick_mask_ = 0;
+  return true;
+}
+
+// X68Sound へは key-on の slot bit を落として渡す（鳴らさないがタイマ等はそのまま動く。
+// OPM のループ自体を飛ばすパッチが当たっていない時もこれで無音になる）
+uint8_t HOT_FN MDXPlayer::opm_write_hook_(void* user, uint8_t reg, uint8_t data) {
+  MDXPlayer* self = static_cast<MDXPlayer*>(user);
+  if (!self || !self->opm_) return data;
+  if (reg != 0x08) {
+    self->opm_->write_reg(reg, data);
+    return data;
+  }
+
+  // ミュート中の ch は ymfm にも key-on させない
+  const uint8_t bit = (uint8_t)(1u << (data & 0x07));
+  if (self->mute_mask_ & bit) data &= 0x07;
+  self->opm_->write_reg(reg, data);
+  if (data & 0x78) {
+    self->fm_keyon_mask_ |= bit;
+    self->fm_kick_mask_ |= bit;
+  } else {
+    self->fm_keyon_mask_ &= (uint8_t)~bit;
+  }
+  return (uint8_t)(data & 0x07);
+}
+
+void MDXPlayer::set_mute_mask(uint16_t mask) {
+  const uint8_t newly_fm = (uint8_t)(mask & ~mute_mask_);
+  mute_mask_ = mask;
+  if (!ctx_ready_) return;
+  MXDRV_ChannelMask(&ctx_, (int)mask);
+  if (opm_backend_ == MDX_OPM_BACKEND_YMFM && opm_) {
+    for (uint8_t ch = 0; ch < 8; ++ch) {
+      if (newly_fm & (1u << ch)) opm_->write_reg(0x08, ch);
+    }
+  }
+}
+
+FmEnvelopeProbe MDXPlayer::fm_envelope() const {
+  return (opm_backend_ == MDX_OPM_BACKEND_YMFM && opm_) ? opm_->envelope_probe() : FmEnvelopeProbe{};
+}
+
+void MDXPlayer::set_resample_tier(uint8_t tier) {
+  opm_tier_ = tier;
+  if (opm_) opm_->set_tier((Resampler::Tier)tier);
+}
+
+bool MDXPlayer::ensure_opm_() {
+  if (opm_ && opm_sr_ == render_sr_) return true;
+  delete opm_;
+  opm_ = new (std::nothrow) YM2151Wrap(MDX_OPM_CLOCK, render_sr_, (Resampler::Tier)opm_tier_);
+  opm_sr_ = opm_ ? render_sr_ : 0;
+  return opm_ != nullptr;
+}
+
+void MDXPlayer::reset_opm_() {
+  if (opm_) opm_->reset();
+  fm_keyon_mask_ = 0;
+  fm_kick_mask_ = 0;
+}
+
+void MDXPlayer::release_context_() {
+  if (!ctx_ready_) return;
+  MXDRV_Stop(&ctx_);
+  MXDRV_End(&ctx_);
+  MxdrvContext_Terminate(&ctx_);
+  ctx_ready_ = false;
+  ctx_pool_size_ = 0;
+  ctx_sr_ = 0;
+  ctx_mdx_cap_ = 0;
+  ctx_pdx_cap_ = 0;
+}
+
+// 曲ごとの状態だけ捨てる。MXDRV のコンテキスト（数 MB のプール）は止めるだけで残す
+void MDXPlayer::reset_internal_() {
+  if (ctx_ready_) MXDRV_Stop(&ctx_);
 
   if (mdx_buffer_) {
     ps_free_(mdx_buffer_);
@@ -46,6 +160,11 @@ void MDXPlayer::reset_internal_() {
   title_.clear();
   opm_state_ = nullptr;
   render_sr_ = 0;
+  length_ms_ = 0;
+  loop_ms_ = 0;
+  rendered_ = 0;
+  ff_pending_ = false;
+  mute_mask_ = 0;
 }
 
 void* MDXPlayer::ps_alloc_(size_t n) {
@@ -104,6 +223,16 @@ std::string MDXPlayer::resolve_pdx_path_(const char* mdx_path, const char* pdx_n
 }
 
 bool MDXPlayer::ensure_context_(uint32_t mdx_buf_size, uint32_t pdx_buf_size, uint32_t render_sr) {
+  if (ctx_ready_ && ctx_sr_ == render_sr &&
+      mdx_buf_size <= ctx_mdx_cap_ && pdx_buf_size <= ctx_pdx_cap_) {
+    render_sr_ = render_sr;
+    return true;
+  }
+  release_context_();
+
+  // 次の曲も収まるよう余裕を持たせて開始する
+  mdx_buf_size = std::max(mdx_buf_size, MDX_CTX_MIN_MDX_BYTES);
+  pdx_buf_size = std::max(pdx_buf_size, MDX_CTX_MIN_PDX_BYTES);
   const uint64_t data_bytes = static_cast<uint64_t>(mdx_buf_size) + pdx_buf_size;
   uint64_t pool64 = data_bytes * 2 + kPoolMarginBytes;
   if (pool64 < kPoolMinBytes) pool64 = kPoolMinBytes;
@@ -123,11 +252,15 @@ bool MDXPlayer::ensure_context_(uint32_t mdx_buf_size, uint32_t pdx_buf_size, ui
 
   ctx_ready_ = true;
   ctx_pool_size_ = pool;
+  ctx_sr_ = render_sr;
+  ctx_mdx_cap_ = mdx_buf_size;
+  ctx_pdx_cap_ = pdx_buf_size;
   render_sr_ = render_sr;
   return true;
 }
 
-bool MDXPlayer::load(uint8_t* data, size_t size, OPMState& state, const char* mdx_path) {
+bool MDXPlayer::load(uint8_t* data, size_t size, OPMState& state, const char* mdx_path,
+                     uint32_t fm_render_sr) {
   reset_internal_();
   if (!data || size < 8) return false;
 
@@ -140,7 +273,7 @@ bool MDXPlayer::load(uint8_t* data, size_t size, OPMState& state, const char* md
 
   bool has_pdx = false;
   if (!MdxHasPdxFileName(data, (uint32_t)size, &has_pdx)) return false;
-  const uint32_t render_sr = has_pdx ? MDX_RENDER_SR_PCM : MDX_RENDER_SR_DEFAULT;
+  const uint32_t render_sr = has_pdx ? MDX_RENDER_SR_PCM : fm_render_sr;
 
   uint8_t* pdx_image = nullptr;
   uint32_t pdx_image_size = 0;
@@ -204,6 +337,7 @@ bool MDXPlayer::load(uint8_t* data, size_t size, OPMState& state, const char* md
   }
 
   if (!ensure_context_(mdx_buffer_size_, pdx_buffer_size_, render_sr)) return false;
+  if (opm_backend_ == MDX_OPM_BACKEND_YMFM && !ensure_opm_()) set_opm_backend(MDX_OPM_BACKEND_X68SOUND);
 
   if (MXDRV_SetData2(&ctx_, mdx_buffer_, mdx_buffer_size_, pdx_buffer_, pdx_buffer_size_) != 0) return false;
 
@@ -220,7 +354,16 @@ bool MDXPlayer::load(uint8_t* data, size_t size, OPMState& state, const char* md
     pdx_buffer_ = nullptr;
     pdx_buffer_size_ = 0;
   }
+  // 1周 / 2周の演奏時間からイントロ+ループ長とループ長を出す（秒）
+  const float t1 = MXDRV_MeasurePlayTime2(&ctx_, 1, 0);
+  const float t2 = MXDRV_MeasurePlayTime2(&ctx_, 2, 0);
+  length_ms_ = (t1 > 0.0f) ? (uint32_t)(t1 * 1000.0f) : 0;
+  loop_ms_ = (t2 > t1) ? (uint32_t)((t2 - t1) * 1000.0f) : 0;
+
+  reset_opm_();
   MXDRV_Play2(&ctx_);
+  MXDRV_ChannelMask(&ctx_, (int)mute_mask_);
+  rendered_ = 0;
 
   pdx_loaded_ = pdx_loaded;
   playing_ = true;
@@ -232,6 +375,7 @@ void MDXPlayer::stop() {
     MXDRV_Stop(&ctx_);
   }
   playing_ = false;
+  ff_pending_ = false;
 }
 
 void MDXPlayer::poll_opm_regs_() {
@@ -243,6 +387,15 @@ void MDXPlayer::poll_opm_regs_() {
       opm_state_->on_write((uint8_t)i, val);
     }
   }
+  if (opm_backend_ == MDX_OPM_BACKEND_YMFM) {
+    // X68Sound 側の key-on は落としてあるのでフックで見たものを使う
+    for (int ch = 0; ch < 8; ++ch) {
+      const uint8_t bit = (uint8_t)(1u << ch);
+      opm_state_->set_fm_keyon((uint8_t)ch, (fm_keyon_mask_ & bit) != 0, (fm_kick_mask_ & bit) != 0);
+    }
+    fm_kick_mask_ = 0;
+    return;
+  }
   for (int ch = 0; ch < 8; ++ch) {
     bool current = false;
     bool logical = false;
@@ -264,35 +417,42 @@ void MDXPlayer::poll_pcm_keyon_() {
   pcm_mask_ = mask;
 }
 
-void MDXPlayer::render_mono(int16_t* dst, int n) {
+void HOT_FN MDXPlayer::render_mono(int16_t* dst, int n) {
   if (!dst || n <= 0) return;
 
-  if (!playing_) {
+  if (ff_pending_ && millis() - ff_last_ms_ >= MDX_FF_COALESCE_MS) finish_fast_forward();
+  if (!playing_ || ff_pending_) {
     for (int i = 0; i < n; ++i) dst[i] = 0;
     return;
   }
 
-  const int block_samples = (int)MDX_RENDER_BLOCK_SAMPLES;
-  int remaining = n;
-  int dst_idx = 0;
-
-  while (remaining > 0) {
-    int chunk = remaining > block_samples ? block_samples : remaining;
-    MXDRV_GetPCM(&ctx_, pcm_interleaved_.data(), chunk);
-
-    for (int i = 0; i < chunk; ++i) {
-      int32_t l = pcm_interleaved_[i * 2];
-      int32_t r = pcm_interleaved_[i * 2 + 1];
-      int32_t mono = (l + r) / 2;
-      if (mono > 32767) mono = 32767;
-      if (mono < -32768) mono = -32768;
-      dst[dst_idx + i] = (int16_t)mono;
-    }
+  if (opm_backend_ == MDX_OPM_BACKEND_YMFM && opm_) {
+    render_ymfm_(dst, n);
+  } else {
+    const int block_samples = (int)MDX_RENDER_BLOCK_SAMPLES;
+    int remaining = n;
+    int dst_idx = 0;
+
+    while (remaining > 0) {
+      int chunk = remaining > block_samples ? block_samples : remaining;
+      MXDRV_GetPCM(&ctx_, pcm_interleaved_.data(), chunk);
+
+      for (int i = 0; i < chunk; ++i) {
+        int32_t l = pcm_interleaved_[i * 2];
+        int32_t r = pcm_interleaved_[i * 2 + 1];
+        int32_t mono = (l + r) / 2;
+        if (mono > 32767) mono = 32767;
+        if (mono < -32768) mono = -32768;
+        dst[dst_idx + i] = (int16_t)mono;
+      }
 
-    dst_idx += chunk;
-    remaining -= chunk;
+      dst_idx += chunk;
+      remaining -= chunk;
+    }
   }
 
+  rendered_ += (uint64_t)n;
+
   poll_opm_regs_();
   poll_pcm_keyon_();
 
@@ -301,6 +461,103 @@ void MDXPlayer::render_mono(int16_t* dst, int n) {
   }
 }
 
+uint32_t MDXPlayer::position_ms() const {
+  if (render_sr_ == 0) return 0;
+  return (uint32_t)((rendered_ * 1000ULL) / render_sr_);
+}
+
+bool MDXPlayer::fast_forward_ms(uint32_t ms) {
+  if (!ctx_ready_ || !playing_) return false;
+  const uint32_t target = (ff_pending_ ? ff_target_ms_ : position_ms()) + ms;
+  if (loop_ms_ == 0 && length_ms_ != 0 && target >= length_ms_) {
+    stop();
+    return true;
+  }
+  ff_target_ms_ = target;
+  ff_last_ms_ = millis();
+  ff_pending_ = true;
+  rendered_ = ((uint64_t)target * render_sr_) / 1000ULL;
+  return true;
+}
+
+// PlayAt は Play2 と同じく演奏をやり直すので、restart と同じく ymfm を空にしてから
+// （飛ぶ間のレジスタ書き込みはフック経由で入り直す）、後でチャンネルマスクを掛け直す
+void MDXPlayer::finish_fast_forward() {
+  if (!ff_pending_) return;
+  ff_pending_ = false;
+  if (!ctx_ready_ || !playing_) return;
+  reset_opm_();
+  MXDRV_PlayAt(&ctx_, ff_target_ms_, kPlayAtLoops, 0);
+  MXDRV_ChannelMask(&ctx_, (int)mute_mask_);
+}
+
+void MDXPlayer::restart() {
+  if (!ctx_ready_) return;
+  ff_pending_ = false;
+  reset_opm_();
+  MXDRV_Play2(&ctx_);
+  MXDRV_ChannelMask(&ctx_, (int)mute_mask_);
+  rendered_ = 0;
+  playing_ = true;
+}
+
 uint8_t MDXPlayer::pcm_mask() const {
   return pdx_loaded_ ? pcm_mask_ : 0;
 }
+
+// MXDRV_GetPCM を MDX_YMFM_SLICE_SAMPLES 毎に呼び、その間にフックへ来た書き込みを
+// 反映した ymfm の出力を X68Sound の出力へ足す。X68Sound 側は PCM8 だけ
+// （x68sound_opm_bypassed() なら OPM は回らない。でなければ無音の OPM も回っている）
+void HOT_FN MDXPlayer::render_ymfm_(int16_t* dst, int n) {
+  const int slice = (int)MDX_YMFM_SLICE_SAMPLES;
+  while (n > 0) {
+    const int k = n > slice ? slice : n;
+    MXDRV_GetPCM(&ctx_, pcm_interleaved_.data(), k);
+    for (int i = 0; i < k; ++i) {
+      opm_acc_[i] = (pcm_interleaved_[i * 2] + pcm_interleaved_[i * 2 + 1]) / 2;
+    }
+    opm_->render_add(opm_acc_.data(), (uint32_t)k, MDX_YMFM_OPM_GAIN_Q15);
+    for (int i = 0; i < k; ++i) {
+      int32_t v = opm_acc_[i];
+      if (v > 32767) v = 32767;
+      if (v < -32768) v = -32768;
+      dst[i] = (int16_t)v;
+    }
+    dst += k;
+    n -= k;
+  }
+}
+
+void MDXPlayer::bench_opm_backends() {
+  if (!ctx_ready_ || render_sr_ == 0) return;
+  const uint8_t saved = opm_backend_;
+  const uint32_t total = (uint32_t)(((uint64_t)render_sr_ * MDX_OPM_BENCH_MS) / 1000);
+  const uint32_t mhz = getCpuFrequencyMhz();
+  static int16_t scratch[MDX_RENDER_BLOCK_SAMPLES];
+
+  static const uint8_t kBackends[] = { MDX_OPM_BACKEND_X68SOUND, MDX_OPM_BACKEND_YMFM };
+  static const char* const kNames[] = { "x68sound", "ymfm" };
+  for (size_t b = 0; b < sizeof(kBackends) / sizeof(kBackends[0]); ++b) {
+    if (kBackends[b] == MDX_OPM_BACKEND_YMFM && (!ymfm_available() || !ensure_opm_())) {
+      Serial.printf("[opm bench] %s: unavailable\n", kNames[b]);
+      continue;
+    }
+    set_opm_backend(kBackends[b]);
+    restart();
+    const uint32_t t0 = micros();
+    for (uint32_t done = 0; done < total && playing_; ) {
+      const uint32_t k = std::min<uint32_t>(total - done, (uint32_t)MDX_RENDER_BLOCK_SAMPLES);
+      render_mono(scratch, (int)k);
+      done += k;
+    }
+    const uint32_t us = micros() - t0;
+    const float us_per_s = (float)us * 1000.0f / (float)MDX_OPM_BENCH_MS;
+    Serial.printf("[opm bench] %s: %u us for %u ms @ %u Hz (%.0f us, %.1f Mcycles per audio s)%s\n",
+                  kNames[b], (unsigned)us, (unsigned)MDX_OPM_BENCH_MS, (unsigned)render_sr_,
+                  us_per_s, us_per_s * (float)mhz / 1e6f,
+                  (kBackends[b] == MDX_OPM_BACKEND_YMFM && !x68sound_opm_bypassed()) ? " (+ silent X68Sound OPM)" : "");
+  }
+
+  set_opm_backend(saved);
+  restart();
+}
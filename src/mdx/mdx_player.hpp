@@ -6,8 +6,10 @@
 
 #include "../app_config.hpp"
 #include "../common/meter_state.hpp"
+#include "../common/fm_envelope.hpp"
 
 class OPMState;
+class YM2151Wrap;
 
 extern "C" {
 #include <mdx_util.h>
@@ -18,8 +20,11 @@ extern "C" {
 class MDXPlayer {
 public:
   MDXPlayer();
+  ~MDXPlayer();
 
-  bool load(uint8_t* data, size_t size, OPMState& state, const char* mdx_path);
+  // fm_render_sr: PDX を使わない曲の生成レート（PDX 有りは MDX_RENDER_SR_PCM 固定）
+  bool load(uint8_t* data, size_t size, OPMState& state, const char* mdx_path,
+            uint32_t fm_render_sr = MDX_RENDER_SR_DEFAULT);
   void stop();
 
   bool playing() const { return playing_; }
@@ -29,6 +34,36 @@ public:
   void render_mono(int16_t* dst, int n);
   const std::string& title() const { return title_; }
 
+  // 長さはロード時に MXDRV の演奏時間計測（音は作らない）で求める
+  uint32_t length_ms() const { return length_ms_; }
+  uint32_t loop_ms() const { return loop_ms_; }
+  uint32_t position_ms() const;
+  // 早送り：MXDRV をドライバだけ回して目的位置へ（PCM は生成しない）。
+  // 位置はすぐ進むが、ドライバが飛ぶのは MDX_FF_COALESCE_MS 続けて来なくなった後の render_mono
+  // （それまでは無音）。足し合わせた分を MXDRV_PlayAt 1回で進める
+  bool fast_forward_ms(uint32_t ms);
+  // 溜まっている早送りを今すぐ適用する
+  void finish_fast_forward();
+  void restart();
+
+  // OPM の生成方式（MDX_OPM_BACKEND_*）。YMFM はフックが無い portable_mdx では選べない
+  static bool ymfm_available();
+  // YMFM の間、X68Sound の OPM 生成を飛ばしているか（パッチが当たらなければ無音のまま回る）
+  static bool x68sound_opm_bypassed();
+  bool set_opm_backend(uint8_t backend);
+  uint8_t opm_backend() const { return opm_backend_; }
+  // ymfm の native rate → render rate の Resampler の段階（再生中に変えてよい）
+  void set_resample_tier(uint8_t tier);
+  // 今の曲を両方式で MDX_OPM_BENCH_MS ぶん生成して比べ、先頭へ戻す
+  void bench_opm_backends();
+  // bit0-7: FM A-H / bit8-15: PCM8 の8トラック（MXDRV_ChannelMask）。
+  // ドライバがそのトラックを発音しないので、PCM8 はミックスの手間ごと減る
+  void set_mute_mask(uint16_t mask);
+  uint16_t mute_mask() const { return mute_mask_; }
+
+  // ymfm で鳴らしている間だけ FM の EG を読める（X68Sound なら空）
+  FmEnvelopeProbe fm_envelope() const;
+
 private:
   bool playing_ = false;
   bool pdx_loaded_ = false;
@@ -36,10 +71,19 @@ private:
   std::string title_;
   OPMState* opm_state_ = nullptr;
   uint32_t render_sr_ = 0;
+  uint32_t length_ms_ = 0;
+  uint32_t loop_ms_ = 0;
+  uint64_t rendered_ = 0;   // render_sr_ 基準の再生済みサンプル数
+  bool ff_pending_ = false;  // MXDRV_PlayAt 待ちの早送り（ff_target_ms_ へ）
+  uint32_t ff_target_ms_ = 0;
+  uint32_t ff_last_ms_ = 0;  // 最後に fast_forward_ms が来た時刻（millis）
 
   MxdrvContext ctx_{};
   bool ctx_ready_ = false;
   uint32_t ctx_pool_size_ = 0;
+  uint32_t ctx_sr_ = 0;          // MXDRV_Start したレートとバッファ容量（これに収まる曲は使い回す）
+  uint32_t ctx_mdx_cap_ = 0;
+  uint32_t ctx_pdx_cap_ = 0;
 
   uint8_t* mdx_buffer_ = nullptr;
   uint32_t mdx_buffer_size_ = 0;
@@ -48,7 +92,23 @@ private:
 
   std::array<int16_t, MDX_RENDER_BLOCK_SAMPLES * 2> pcm_interleaved_{};
 
+  // ymfm OPM：フックで受けた書き込みは即 opm_ へ（次のスライス生成の前なのでスライス頭に効く）
+  uint8_t opm_backend_ = MDX_OPM_BACKEND_X68SOUND;
+  YM2151Wrap* opm_ = nullptr;
+  uint32_t opm_sr_ = 0;
+  uint8_t opm_tier_ = 1;        // Resampler::Tier（kFast）
+  uint8_t fm_keyon_mask_ = 0;   // 0x08 の slot bit が立っている ch
+  uint8_t fm_kick_mask_ = 0;    // 前回の poll 以降に key-on した ch
+  uint16_t mute_mask_ = 0;
+  std::array<int32_t, MDX_YMFM_SLICE_SAMPLES> opm_acc_{};
+
+  static uint8_t opm_write_hook_(void* user, uint8_t reg, uint8_t data);
+  void render_ymfm_(int16_t* dst, int n);
+  bool ensure_opm_();
+  void reset_opm_();
+
   void reset_internal_();
+  void release_context_();
   bool ensure_context_(uint32_t mdx_buf_size, uint32_t pdx_buf_size, uint32_t render_sr);
   std::string resolve_pdx_path_(const char* mdx_path, const char* pdx_name) const;
   void poll_opm_regs_();
@@ -6,6 +6,9 @@
 
 static inline float clamp01(float x){ return x<0?0:(x>1?1:x); }
 
+// TL (0x60-0x7F) の op1..op4 の並び：M1, C1, M2, C2
+static constexpr uint8_t tl_ofs[4] = { 0x00, 0x10, 0x08, 0x18 };
+
 void OPMState::reset() {
   memset(reg_, 0, sizeof(reg_));
   memset(keyon_mask_, 0, sizeof(keyon_mask_));
@@ -13,6 +16,7 @@ void OPMState::reset() {
   pcm_mask_ = 0;
   memset(pcm_kick_until_ms_, 0, sizeof(pcm_kick_until_ms_));
   pcm_enabled_ = false;
+  env_ = {};
   meters_ = {};
   meters_.count = 8;
   memset(hold_ms_, 0, sizeof(hold_ms_));
@@ -62,11 +66,22 @@ void OPMState::set_pcm_mask(uint8_t mask) {
 }
 
 void OPMState::update(uint32_t now_ms) {
+  uint16_t eg[8 * 4];
+  if (env_) env_.read(eg, 8);
+
   for (int i = 0; i < 8; ++i) {
-    bool kicked = now_ms < kick_until_ms_[i];
-    float lv = (keyon_mask_[i] || kicked) ? 0.65f : 0.0f;
-    if (kicked) {
-      lv = fminf(1.0f, lv + 0.20f);
+    float lv;
+    if (env_) {
+      // キャリアの実際の減衰（EG + TL）。release 中もそのまま落ちる
+      uint8_t tl[4];
+      for (int s = 0; s < 4; ++s) tl[s] = reg_[0x60 + tl_ofs[s] + i];
+      lv = fm_carrier_level(&eg[i * 4], reg_[0x20 + i], tl);
+    } else {
+      bool kicked = now_ms < kick_until_ms_[i];
+      lv = (keyon_mask_[i] || kicked) ? 0.65f : 0.0f;
+      if (kicked) {
+        lv = fminf(1.0f, lv + 0.20f);
+      }
     }
 
     float diff = lv - meters_.val[i];
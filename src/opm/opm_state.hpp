@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include "../common/meter_state.hpp"
+#include "../common/fm_envelope.hpp"
 
 class OPMState {
 public:
@@ -10,6 +11,8 @@ public:
   void update(uint32_t now_ms);
   void set_pcm_enabled(bool enabled);
   void set_pcm_mask(uint8_t mask);
+  // FM 8ch の EG（ymfm で鳴らしている時）。無ければ key-on から推定
+  void attach_envelope(FmEnvelopeProbe probe) { env_ = probe; }
 
   const MeterState& meters() const { return meters_; }
 
@@ -20,6 +23,7 @@ private:
   uint8_t pcm_mask_ = 0;
   uint32_t pcm_kick_until_ms_[8]{};
   bool pcm_enabled_ = false;
+  FmEnvelopeProbe env_{};
 
   MeterState meters_{};
   uint32_t hold_ms_[16]{};
@@ -0,0 +1,49 @@
+#include "opn_snapshot.hpp"
+#include "../ym2203_wrap.hpp"
+#include <string.h>
+
+void OPNRegSnapshot::clear() {
+  memset(reg, 0, sizeof(reg));
+  memset(keyon, 0, sizeof(keyon));
+  prescale = 0;
+}
+
+void OPNRegSnapshot::on_write(uint8_t r, uint8_t d) {
+  reg[r] = d;
+  if (r == 0x28) {
+    uint8_t ch = d & 0x03;
+    if (ch < 3) keyon[ch] = d & 0xF0;
+  } else if (r >= 0x2D && r <= 0x2F) {
+    prescale = r;
+  }
+}
+
+void OPNRegSnapshot::write_to(YM2203Wrap& chip) const {
+  if (prescale) chip.write_reg(prescale, 0);
+
+  // SSG (0x0E/0x0F は I/O ポートなので触らない)
+  for (uint8_t r = 0x00; r <= 0x0D; ++r) chip.write_reg(r, reg[r]);
+
+  // timer 値と ch3 モード（タイマの start/reset ビットは落とす）
+  chip.write_reg(0x24, reg[0x24]);
+  chip.write_reg(0x25, reg[0x25]);
+  chip.write_reg(0x26, reg[0x26]);
+  chip.write_reg(0x27, reg[0x27] & 0xC0);
+
+  // operator / channel params
+  for (int r = 0x30; r <= 0x9F; ++r) chip.write_reg((uint8_t)r, reg[r]);
+  for (int r = 0xB0; r <= 0xB2; ++r) chip.write_reg((uint8_t)r, reg[r]);
+
+  // F-number: 上位(0xA4/0xAC)がラッチなので先に書く
+  for (int ch = 0; ch < 3; ++ch) {
+    chip.write_reg((uint8_t)(0xA4 + ch), reg[0xA4 + ch]);
+    chip.write_reg((uint8_t)(0xA0 + ch), reg[0xA0 + ch]);
+    chip.write_reg((uint8_t)(0xAC + ch), reg[0xAC + ch]);
+    chip.write_reg((uint8_t)(0xA8 + ch), reg[0xA8 + ch]);
+  }
+
+  // 最後に key on
+  for (int ch = 0; ch < 3; ++ch) {
+    if (keyon[ch]) chip.write_reg(0x28, (uint8_t)(keyon[ch] | ch));
+  }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+class YM2203Wrap;
+
+// YM2203 のレジスタファイル影（シーク用キーフレーム）
+struct OPNRegSnapshot {
+  uint8_t reg[256];
+  uint8_t keyon[3];    // 0x28 の slot bits（ch毎）
+  uint8_t prescale;    // 最後に選択された 0x2D..0x2F（0 = 未設定）
+
+  void clear();
+  void on_write(uint8_t r, uint8_t d);
+
+  // リセット済みチップへ、ラッチ順を守って書き戻す
+  void write_to(YM2203Wrap& chip) const;
+};
@@ -1,11 +1,23 @@
 #include "opn_state.hpp"
+#include "opn_snapshot.hpp"
 #include "../app_config.hpp"
+#include "../common/level_tap.hpp"
 #include <math.h>
 #include <string.h>
 #include <Arduino.h>
 
 static inline float clamp01(float x){ return x<0?0:(x>1?1:x); }
 
+// Q15 の振幅 → 0..1（log2 を 1/16 オクターブ刻みの固定小数で取り、METER_TAP_OCTAVES 分を表示）
+static float tap_level(uint32_t q15) {
+  if (q15 == 0) return 0.0f;
+  const int msb = 31 - __builtin_clz(q15);
+  const uint32_t frac = (msb >= 4 ? (q15 >> (msb - 4)) : (q15 << (4 - msb))) & 0x0F;
+  const int32_t log2_q4 = msb * 16 + (int32_t)frac;
+  const int32_t lo = (15 - (int32_t)METER_TAP_OCTAVES) * 16;
+  return clamp01((float)(log2_q4 - lo) / (float)(METER_TAP_OCTAVES * 16));
+}
+
 // OPN系でよく使われるスロット並び
 static constexpr uint8_t slot_ofs[4] = { 0x00, 0x08, 0x04, 0x0C };
 
@@ -16,6 +28,9 @@ void OPNState::reset() {
   memset(fm_kick_until_ms_, 0, sizeof(fm_kick_until_ms_));
   memset(ssg_prev_active_, 0, sizeof(ssg_prev_active_));
   memset(ssg_kick_until_ms_, 0, sizeof(ssg_kick_until_ms_));
+  ssg_tap_ = nullptr;
+  memset(ssg_tap_val_, 0, sizeof(ssg_tap_val_));
+  env_ = {};
   meters_ = {};
   meters_.count = 6;
   memset(hold_ms_, 0, sizeof(hold_ms_));
@@ -37,6 +52,25 @@ void OPNState::on_write(uint8_t reg, uint8_t data) {
   }
 }
 
+void OPNState::restore(const OPNRegSnapshot& snap) {
+  memcpy(reg_, snap.reg, sizeof(reg_));
+  for (int ch = 0; ch < 3; ++ch) {
+    fm_keyon_prev_[ch] = fm_keyon_mask_[ch];
+    fm_keyon_mask_[ch] = snap.keyon[ch];
+  }
+}
+
+void OPNState::attach_taps(LevelTap* ssg) {
+  ssg_tap_ = ssg;
+  memset(ssg_tap_val_, 0, sizeof(ssg_tap_val_));
+}
+
+// 前回の UI 以降に生成が無ければ最後の値のまま
+uint32_t OPNState::poll_tap_(LevelTap* tap, uint32_t last) {
+  const uint32_t v = tap->take();
+  return v ? v : last;
+}
+
 bool OPNState::ssg_active_(int ch) const {
   // enable 0x07: bit0..2 tone disable, bit3..5 noise disable
   uint8_t en = reg_[0x07];
@@ -46,7 +80,15 @@ bool OPNState::ssg_active_(int ch) const {
   return (vol > 0) && (tone_on || noise_on);
 }
 
-float OPNState::fm_target_(int ch, uint32_t now_ms) const {
+// eg: その ch の op1..op4 の EG 減衰（nullptr ならレジスタから推定）
+float OPNState::fm_target_(int ch, uint32_t now_ms, const uint16_t* eg) const {
+  if (eg) {
+    // release 中も実際の減衰どおりに落ちる。TL も減衰として足す
+    uint8_t tl[4];
+    for (int s = 0; s < 4; ++s) tl[s] = reg_[0x40 + slot_ofs[s] + ch];
+    return fm_carrier_level(eg, reg_[0xB0 + ch], tl);
+  }
+
   if (fm_keyon_mask_[ch] == 0) return 0.0f;
 
   // “鳴ってる”同期を重視：ベース固定
@@ -85,19 +127,30 @@ float OPNState::ssg_target_(int ch, uint32_t now_ms) {
 
 void OPNState::update(uint32_t now_ms) {
   float target[6];
-  target[0] = fm_target_(0, now_ms);
-  target[1] = fm_target_(1, now_ms);
-  target[2] = fm_target_(2, now_ms);
-  target[3] = ssg_target_(0, now_ms);
-  target[4] = ssg_target_(1, now_ms);
-  target[5] = ssg_target_(2, now_ms);
+  float peak_target[6];
+
+  // 実出力（SSG タップ / FM の EG）があればそれを使い、無い時だけレジスタから推定する
+  uint16_t eg[3 * 4];
+  if (env_) env_.read(eg, 3);
+  for (int ch = 0; ch < 3; ++ch) {
+    target[ch] = peak_target[ch] = fm_target_(ch, now_ms, env_ ? &eg[ch * 4] : nullptr);
+  }
+  if (ssg_tap_) {
+    for (int ch = 0; ch < 3; ++ch) {
+      ssg_tap_val_[ch] = poll_tap_(&ssg_tap_[ch], ssg_tap_val_[ch]);
+      target[3 + ch] = tap_level(LevelTap::rms_of(ssg_tap_val_[ch]));
+      peak_target[3 + ch] = tap_level(LevelTap::peak_of(ssg_tap_val_[ch]));
+    }
+  } else {
+    for (int ch = 0; ch < 3; ++ch) target[3 + ch] = peak_target[3 + ch] = ssg_target_(ch, now_ms);
+  }
 
   for (int i = 0; i < 6; ++i) {
     float diff = target[i] - meters_.val[i];
     meters_.val[i] += (diff > 0 ? M_ATTACK : M_RELEASE) * diff;
     meters_.val[i] = clamp01(meters_.val[i]);
 
-    float pd = meters_.val[i] - meters_.peak[i];
+    float pd = fmaxf(meters_.val[i], peak_target[i]) - meters_.peak[i];
     meters_.peak[i] += (pd > 0 ? 0.55f : 0.20f) * pd;
     meters_.peak[i] = clamp01(meters_.peak[i]);
 
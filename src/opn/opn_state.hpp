@@ -1,13 +1,22 @@
 #pragma once
 #include <cstdint>
 #include "../common/meter_state.hpp"
+#include "../common/fm_envelope.hpp"
+
+struct OPNRegSnapshot;
+class LevelTap;
 
 class OPNState {
 public:
   void reset();
   void on_write(uint8_t reg, uint8_t data);
+  void restore(const OPNRegSnapshot& snap);   // シーク後にレジスタ影を丸ごと差し替え
   void update(uint32_t now_ms);
 
+  // SSG A-C の実出力タップ（3本の配列）と FM の EG。無い方はレジスタから推定
+  void attach_taps(LevelTap* ssg);
+  void attach_envelope(FmEnvelopeProbe probe) { env_ = probe; }
+
   const MeterState& meters() const { return meters_; }
 
 private:
@@ -22,12 +31,18 @@ private:
   bool ssg_prev_active_[3]{};
   uint32_t ssg_kick_until_ms_[3]{};
 
+  // 実出力タップ（最後に受け取った値）と FM の EG
+  LevelTap* ssg_tap_ = nullptr;
+  uint32_t ssg_tap_val_[3]{};
+  FmEnvelopeProbe env_{};
+
   // meters
   MeterState meters_{};
   uint32_t hold_ms_[6]{};
 
   // helpers
   bool ssg_active_(int ch) const;
-  float fm_target_(int ch, uint32_t now_ms) const;
+  float fm_target_(int ch, uint32_t now_ms, const uint16_t* eg) const;
   float ssg_target_(int ch, uint32_t now_ms);
+  static uint32_t poll_tap_(LevelTap* tap, uint32_t last);
 };
@@ -0,0 +1,115 @@
+#include "sn76489.hpp"
+#include "../common/hot_path.hpp"
+
+// 2dB/step。4ch 加算で int16 に収まるよう 1ch の最大を 8191 に
+static const int16_t kVolTable[16] HOT_DATA = {
+  8191, 6507, 5168, 4105, 3261, 2590, 2057, 1634,
+  1298, 1031,  819,  650,  516,  410,  326,    0,
+};
+
+SN76489::SN76489(uint32_t clock_hz, uint32_t out_sr, uint16_t feedback, uint8_t width) {
+  configure(clock_hz, out_sr, feedback, width);
+}
+
+void SN76489::configure(uint32_t clock_hz, uint32_t out_sr, uint16_t feedback, uint8_t width) {
+  out_sr_ = out_sr;
+  step_fp_ = (int32_t)((((uint64_t)clock_hz / 16) << 16) / out_sr);
+  feedback_ = feedback ? feedback : 0x0009;
+  width_ = (width >= 2 && width <= 32) ? width : 16;
+  mute_ = 0;
+  reset();
+}
+
+void SN76489::reset() {
+  for (int ch = 0; ch < 4; ++ch) {
+    period_[ch] = 0;
+    atten_[ch] = 15;
+    count_[ch] = 0;
+    phase_[ch] = 0;
+  }
+  latch_ = 0;
+  reset_lfsr_();
+}
+
+void SN76489::write(uint8_t data) {
+  if (data & 0x80) {
+    latch_ = (data >> 4) & 0x07;
+    uint8_t ch = latch_ >> 1;
+    if (latch_ & 1) {
+      atten_[ch] = data & 0x0F;
+    } else if (ch < 3) {
+      period_[ch] = (uint16_t)((period_[ch] & 0x3F0) | (data & 0x0F));
+    } else {
+      period_[3] = data & 0x07;
+      reset_lfsr_();
+    }
+    return;
+  }
+
+  uint8_t ch = latch_ >> 1;
+  if (latch_ & 1) {
+    atten_[ch] = data & 0x0F;
+  } else if (ch < 3) {
+    period_[ch] = (uint16_t)((period_[ch] & 0x00F) | ((data & 0x3F) << 4));
+  } else {
+    period_[3] = data & 0x07;
+    reset_lfsr_();
+  }
+}
+
+uint16_t SN76489::noise_period_() const {
+  switch (period_[3] & 0x03) {
+    case 0: return 0x10;
+    case 1: return 0x20;
+    case 2: return 0x40;
+    default: return period_[2] ? period_[2] : 1;
+  }
+}
+
+void HOT_FN SN76489::render_block_mono_i16(int16_t* dst, uint32_t n) {
+  const bool white = (period_[3] & 0x04) != 0;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    int32_t sum = 0;
+
+    for (int ch = 0; ch < 3; ++ch) {
+      int16_t v = (mute_ & (1u << ch)) ? 0 : kVolTable[atten_[ch]];
+      // period 0/1 は常に High（サンプル再生に使われる）
+      if (period_[ch] <= 1) {
+        sum += v;
+        continue;
+      }
+      count_[ch] -= step_fp_;
+      while (count_[ch] <= 0) {
+        count_[ch] += (int32_t)period_[ch] << 16;
+        phase_[ch] ^= 1;
+      }
+      sum += phase_[ch] ? v : -v;
+    }
+
+    // noise: 2 回の反転で LFSR が1回シフト
+    count_[3] -= step_fp_;
+    while (count_[3] <= 0) {
+      count_[3] += (int32_t)noise_period_() << 16;
+      phase_[3] ^= 1;
+      if (phase_[3]) {
+        uint32_t in;
+        if (white) {
+          uint32_t x = lfsr_ & feedback_;
+          x ^= x >> 16; x ^= x >> 8; x ^= x >> 4; x ^= x >> 2; x ^= x >> 1;
+          in = x & 1;
+        } else {
+          in = lfsr_ & 1;
+        }
+        lfsr_ = (lfsr_ >> 1) | (in << (width_ - 1));
+      }
+    }
+    int16_t nv = kVolTable[atten_[3]];
+    sum += (lfsr_ & 1) ? nv : -nv;
+
+    sum >>= 1;
+    if (sum < -32768) sum = -32768;
+    if (sum >  32767) sum =  32767;
+    dst[i] = (int16_t)sum;
+  }
+}
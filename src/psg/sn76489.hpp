@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+// SN76489 / SN76496 (DCSG)。ymfm に無いので最小限の自前コア。
+// 出力レートで直接生成する（clock/16 のカウンタを 16.16 固定小数で進める）
+class SN76489 {
+public:
+  // feedback / width は VGM ヘッダ 0x28 / 0x2A（0 なら SMS 既定値）
+  SN76489(uint32_t clock_hz, uint32_t out_sr, uint16_t feedback = 0, uint8_t width = 0);
+
+  // 曲の切り替え：作り直さずに設定し直して初期状態へ
+  void configure(uint32_t clock_hz, uint32_t out_sr, uint16_t feedback = 0, uint8_t width = 0);
+
+  uint32_t sample_rate_native() const { return out_sr_; }
+
+  void reset();
+  void write(uint8_t data);
+  // bit3-5: tone 1-3（YM2203Wrap::set_mute_mask の SSG と同じ位置）。カウンタは回したまま出力だけ 0
+  void set_mute_mask(uint8_t m) { mute_ = (m >> 3) & 0x07; }
+  void render_block_mono_i16(int16_t* dst, uint32_t n);
+
+private:
+  static constexpr int32_t kOne = 1 << 16;
+
+  uint32_t out_sr_ = 0;
+  int32_t step_fp_ = 0;       // 出力1サンプルあたりの clock/16 tick 数（16.16）
+  uint16_t feedback_ = 0;
+  uint8_t width_ = 16;
+
+  uint16_t period_[4]{};      // [3] は noise 制御（下位3bit）
+  uint8_t atten_[4]{};        // 0..15（15 = 無音）
+  int32_t count_[4]{};
+  uint8_t phase_[4]{};
+  uint32_t lfsr_ = 0;
+  uint8_t latch_ = 0;         // 最後にラッチしたレジスタ番号（ch*2 + type）
+  uint8_t mute_ = 0;          // bit0-2: tone 1-3
+
+  uint16_t noise_period_() const;
+  void reset_lfsr_() { lfsr_ = 1u << (width_ - 1); }
+};
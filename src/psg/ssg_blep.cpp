@@ -0,0 +1,191 @@
+#include "ssg_blep.hpp"
+#include "../common/hot_path.hpp"
+
+// YM2149 の 32 段（1.5dB/段、0 は無音）。固定音量 v は 2v+1 段目
+static const int16_t kAmpTable[32] HOT_DATA = {
+      0,   184,   219,   260,   309,   368,   437,   519,
+    617,   734,   872,  1036,  1232,  1464,  1740,  2067,
+   2457,  2920,  3471,  4125,  4903,  5827,  6925,  8231,
+   9782, 11626, 13818, 16422, 19518, 23197, 27570, 32767,
+};
+
+SSGBlep::SSGBlep(uint32_t clock_hz, uint32_t out_sr, int32_t gain_q15) {
+  configure(clock_hz, out_sr, gain_q15);
+}
+
+void SSGBlep::configure(uint32_t clock_hz, uint32_t out_sr, int32_t gain_q15) {
+  out_sr_ = out_sr;
+  tick_fp_ = (uint32_t)((((uint64_t)clock_hz / 8) << kFrac) / out_sr);
+  if (tick_fp_ == 0) tick_fp_ = 1;
+  inv_tick_ = (uint32_t)((1ull << 32) / tick_fp_);
+  gain_q15_ = gain_q15;
+  mute_ = 0;
+  reset();
+}
+
+void SSGBlep::reset() {
+  for (auto& r : regs_) r = 0;
+  regs_[7] = 0x3F;   // 全 ch の tone/noise 無効
+  for (uint32_t s = 0; s < kSrcCount; ++s) {
+    period_[s] = 1u << kFrac;
+    next_[s] = period_[s];
+  }
+  period_[kNoise] = 2u << kFrac;
+  next_[kNoise] = period_[kNoise];
+  for (auto& b : tone_bit_) b = 0;
+  lfsr_ = 1;
+  noise_bit_ = 0;
+  restart_envelope_();
+  for (auto& l : level_) l = 0;
+  sum_ = 0;
+  res_cur_ = 0;
+}
+
+void SSGBlep::set_period_(uint32_t src, uint32_t ticks) {
+  period_[src] = (ticks ? ticks : 1) << kFrac;
+  // 短くなった時は今のカウントが周期を超えた時点ですぐ反転する（実機と同じ）
+  if (next_[src] > period_[src]) next_[src] = period_[src];
+}
+
+void SSGBlep::restart_envelope_() {
+  const uint8_t shape = regs_[13] & 0x0F;
+  env_attack_ = (shape & 0x04) ? 0x1F : 0x00;
+  if ((shape & 0x08) == 0) {
+    env_hold_ = true;
+    env_alt_ = env_attack_ != 0;
+  } else {
+    env_hold_ = (shape & 0x01) != 0;
+    env_alt_ = (shape & 0x02) != 0;
+  }
+  env_count_ = 0x1F;
+  env_holding_ = false;
+  next_[kEnv] = period_[kEnv];
+}
+
+int32_t HOT_FN SSGBlep::channel_level_(uint32_t ch) const {
+  if (mute_ & (1u << ch)) return 0;
+  const uint8_t mix = regs_[7];
+  const bool tone = tone_bit_[ch] || (mix & (1u << ch));
+  const bool noise = noise_bit_ || (mix & (8u << ch));
+  if (!(tone && noise)) return 0;
+  const uint8_t v = regs_[8 + ch];
+  const uint8_t idx = (v & 0x10) ? env_volume_() : ((v & 0x0F) ? (uint8_t)((v & 0x0F) * 2 + 1) : 0);
+  return kAmpTable[idx];
+}
+
+int32_t HOT_FN SSGBlep::update_channel_(uint32_t ch) {
+  const int32_t v = channel_level_(ch);
+  const int32_t h = v - level_[ch];
+  level_[ch] = v;
+  return h;
+}
+
+int32_t HOT_FN SSGBlep::update_all_() {
+  return update_channel_(0) + update_channel_(1) + update_channel_(2);
+}
+
+// src のイベントを1つ進め、合計出力の段差を返す
+int32_t HOT_FN SSGBlep::fire_(uint32_t src) {
+  if (src < kNoise) {
+    tone_bit_[src] ^= 1;
+    return update_channel_(src);
+  }
+  if (src == kNoise) {
+    const uint8_t bit = (uint8_t)(lfsr_ & 1);
+    lfsr_ = (lfsr_ >> 1) | (((lfsr_ ^ (lfsr_ >> 3)) & 1u) << 16);
+    if (bit == noise_bit_) return 0;
+    noise_bit_ = bit;
+    return update_all_();
+  }
+  if (env_holding_) return 0;
+  if (--env_count_ < 0) {
+    if (env_hold_) {
+      if (env_alt_) env_attack_ ^= 0x1F;
+      env_holding_ = true;
+      env_count_ = 0;
+    } else {
+      if (env_alt_) env_attack_ ^= 0x1F;
+      env_count_ &= 0x1F;
+    }
+  }
+  return update_all_();
+}
+
+// レジスタ書き込みはサンプル境界ちょうどの段差：このサンプルは段差の中点
+void HOT_FN SSGBlep::step_at_boundary_(int32_t h) {
+  sum_ += h;
+  res_cur_ -= h / 2;
+}
+
+void SSGBlep::set_mute_mask(uint8_t m) {
+  mute_ = (m >> 3) & 0x07;
+  step_at_boundary_(update_all_());
+}
+
+void SSGBlep::write(uint8_t reg, uint8_t data) {
+  if (reg >= 16) return;
+  regs_[reg] = data;
+  switch (reg) {
+    case 0: case 1: case 2: case 3: case 4: case 5: {
+      const uint32_t ch = reg >> 1;
+      set_period_(ch, (uint32_t)regs_[ch * 2] | ((uint32_t)(regs_[ch * 2 + 1] & 0x0F) << 8));
+      break;
+    }
+    case 6:
+      set_period_(kNoise, (uint32_t)((data & 0x1F) ? (data & 0x1F) : 1) * 2);
+      break;
+    case 7:
+      step_at_boundary_(update_all_());
+      break;
+    case 8: case 9: case 10:
+      step_at_boundary_(update_channel_(reg - 8));
+      break;
+    case 11: case 12:
+      set_period_(kEnv, (uint32_t)regs_[11] | ((uint32_t)regs_[12] << 8));
+      break;
+    case 13:
+      restart_envelope_();
+      step_at_boundary_(update_all_());
+      break;
+    default:
+      break;   // 14/15 は I/O ポート
+  }
+}
+
+void HOT_FN SSGBlep::render_block_mono_i16(int16_t* dst, uint32_t n) {
+  const uint32_t tick = tick_fp_;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    int32_t out = sum_ + res_cur_;
+    int32_t res_next = 0;
+
+    // このサンプル区間 (0, tick] のイベントを時刻順に処理
+    for (;;) {
+      uint32_t src = 0;
+      uint32_t e = next_[0];
+      for (uint32_t s = 1; s < kSrcCount; ++s) {
+        if (next_[s] < e) { e = next_[s]; src = s; }
+      }
+      if (e > tick) break;
+      next_[src] += period_[src];
+
+      const int32_t h = fire_(src);
+      if (h == 0) continue;
+      // 区間内位置 d（Q15）。polyBLEP: このサンプルへ h(1-d)^2/2、次へ -h d^2/2
+      uint32_t d = (uint32_t)(((uint64_t)e * inv_tick_) >> 17);
+      if (d > 32768) d = 32768;
+      const uint32_t a = 32768 - d;
+      out += (h * (int32_t)((a * a) >> 16)) >> 15;
+      res_next -= (h * (int32_t)((d * d) >> 16)) >> 15;
+      sum_ += h;
+    }
+    for (uint32_t s = 0; s < kSrcCount; ++s) next_[s] -= tick;
+
+    res_cur_ = res_next;
+
+    int32_t v = (out * gain_q15_) >> 15;
+    if (v < -32768) v = -32768;
+    if (v >  32767) v =  32767;
+    dst[i] = (int16_t)v;
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+
+// AY-3-8910 / YM2149 / YM2203 SSG 部。ymfm を native rate で回す代わりに
+// 出力レートで直接生成し、矩形の段差は polyBLEP（前後2サンプル）で帯域制限する。
+// 時間は AY の clock/8 を 1 tick として Q12 固定小数で数える
+class SSGBlep {
+public:
+  // clock_hz は AY 換算（トーン f = clock / (16 * TP)）。YM2203 なら master / 4（既定の prescaler）
+  // gain_q15 は 3ch 合計に掛ける倍率
+  SSGBlep(uint32_t clock_hz, uint32_t out_sr, int32_t gain_q15);
+  // 曲の切り替え：作り直さずに設定し直して初期状態へ
+  void configure(uint32_t clock_hz, uint32_t out_sr, int32_t gain_q15);
+
+  uint32_t sample_rate_native() const { return out_sr_; }
+
+  void reset();
+  void write(uint8_t reg, uint8_t data);
+  void render_block_mono_i16(int16_t* dst, uint32_t n);
+
+  // bit3-5: A-C（YM2203Wrap::set_mute_mask の SSG と同じ位置）。カウンタは回したまま出力だけ 0。
+  // YM2203 の SSG 部として使う時は Wrap が音量 0 を書くので、こちらは AY 単体用
+  void set_mute_mask(uint8_t m);
+
+  // 3ch とも音量 0（かミュート）で、補正も残っていない（生成しなくても 0 が続く）
+  bool is_idle() const {
+    uint8_t v = 0;
+    for (uint32_t ch = 0; ch < 3; ++ch) {
+      if (!(mute_ & (1u << ch))) v |= regs_[8 + ch];
+    }
+    return (v & 0x1F) == 0 && sum_ == 0 && res_cur_ == 0;
+  }
+
+private:
+  static constexpr uint32_t kFrac = 12;
+  enum : uint8_t { kTone0, kTone1, kTone2, kNoise, kEnv, kSrcCount };
+
+  uint32_t out_sr_ = 0;
+  uint32_t tick_fp_ = 1;      // 出力1サンプルあたりの tick（Q12）
+  uint32_t inv_tick_ = 0;     // 2^32 / tick_fp_（イベント時刻 → サンプル内位置）
+  int32_t gain_q15_ = 0;
+
+  uint8_t regs_[16]{};
+  uint8_t mute_ = 0;          // bit0-2: A-C
+  uint32_t period_[kSrcCount]{};   // Q12 tick
+  uint32_t next_[kSrcCount]{};     // このサンプル先頭から次のイベントまで（Q12 tick）
+
+  uint8_t tone_bit_[3]{};
+  uint32_t lfsr_ = 1;
+  uint8_t noise_bit_ = 0;
+
+  int8_t env_count_ = 0;
+  uint8_t env_attack_ = 0;
+  bool env_hold_ = false;
+  bool env_alt_ = false;
+  bool env_holding_ = false;
+
+  int32_t level_[3]{};        // 各 ch の現在値
+  int32_t sum_ = 0;           // level_ の合計
+  int32_t res_cur_ = 0;       // BLEP 補正の持ち越し（次に出すサンプルへ）
+
+  uint8_t env_volume_() const { return (uint8_t)(env_count_ ^ env_attack_); }
+  int32_t channel_level_(uint32_t ch) const;
+  int32_t update_channel_(uint32_t ch);
+  int32_t update_all_();
+  int32_t fire_(uint32_t src);
+  void set_period_(uint32_t src, uint32_t ticks);
+  void restart_envelope_();
+  void step_at_boundary_(int32_t h);
+};
@@ -1,4 +1,5 @@
 #include "ui_renderer.hpp"
+#include <cstdio>
 #include "../dsp/spectrum.hpp"
 #include "../common/meter_state.hpp"
 #include "../app_config.hpp"
@@ -9,7 +10,22 @@ void UIRenderer::begin(M5GFX& display) {
   display_ = &display;
 
   canvas_.setColorDepth(16);
-  canvas_.createSprite(display.width(), display.height());
+  // 内部 RAM に置く（PSRAM だと毎フレームの push がキャッシュを追い出し、生成側が遅くなる）。
+  // ただし生成側が後から取る分（UI_SPRITE_DRAM_RESERVE）を残せない時と、取れなかった時は PSRAM
+  const int w = display.width(), h = display.height();
+  const size_t bytes = (size_t)w * h * 2;
+  bool internal = true;
+#if defined(ESP32)
+  internal = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) >=
+             bytes + UI_SPRITE_DRAM_RESERVE;
+#endif
+  canvas_.setPsram(!internal);
+  if (!canvas_.createSprite(w, h) && internal) {
+    internal = false;
+    canvas_.setPsram(true);
+    canvas_.createSprite(w, h);
+  }
+  Serial.printf("ui sprite %u bytes in %s\n", (unsigned)bytes, internal ? "internal RAM" : "PSRAM");
   canvas_.setFont(&fonts::lgfxJapanGothic_12);
   canvas_.setTextSize(1);
   canvas_.fillScreen(COL_BG);
@@ -77,10 +93,14 @@ void UIRenderer::draw(uint32_t now_ms,
                       const SpectrumState& spec,
                       const MeterState& meters,
                       const std::string& track_name,
-                      uint32_t wr_count,
-                      uint32_t pos,
+                      uint32_t pos_ms,
+                      uint32_t length_ms,
                       int volume,
-                      bool show_volume)
+                      bool show_volume,
+                      uint32_t muted,
+                      int load_pct,
+                      int underruns,
+                      int ring_blocks)
 {
   (void)now_ms;
   int W=canvas_.width();
@@ -143,8 +163,18 @@ int statusW = 0;
 std::string status;
 if (show_volume) {
   status = "VOL " + std::to_string(volume);
-  statusW = canvas_.textWidth(status.c_str()) + 8;
+} else {
+  // 再生位置 m:ss（長さが分かれば m:ss/m:ss）
+  char tb[24];
+  uint32_t ps = pos_ms / 1000, ls = length_ms / 1000;
+  if (length_ms)
+    snprintf(tb, sizeof(tb), "%u:%02u/%u:%02u", (unsigned)(ps / 60), (unsigned)(ps % 60),
+             (unsigned)(ls / 60), (unsigned)(ls % 60));
+  else
+    snprintf(tb, sizeof(tb), "%u:%02u", (unsigned)(ps / 60), (unsigned)(ps % 60));
+  status = tb;
 }
+statusW = canvas_.textWidth(status.c_str()) + 8;
 int x1 = W - 6 - statusW;
 int areaW = x1 - x0;
 if (areaW < 20) areaW = 20;  // 保険
@@ -206,12 +236,13 @@ if (textW > areaW) {
 // クリップ解除
 canvas_.clearClipRect();
 
-  if (show_volume) {
+  {
     int sx = W - statusW - 2;
     int sy = 2;
     int sh = headerH - 4;
-    canvas_.fillRoundRect(sx, sy, statusW, sh, 3, COL_GRID2);
-    canvas_.setTextColor(COL_TXT, COL_GRID2);
+    uint16_t bg = show_volume ? COL_GRID2 : COL_PANEL;
+    canvas_.fillRoundRect(sx, sy, statusW, sh, 3, bg);
+    canvas_.setTextColor(show_volume ? COL_TXT : COL_TXT2, bg);
     canvas_.setCursor(sx + 4, 3);
     canvas_.print(status.c_str());
   }
@@ -329,13 +360,34 @@ canvas_.clearClipRect();
         label = lab8[i];
       }
       if (label) {
-        canvas_.setTextColor(COL_TXT, COL_BG);
+        canvas_.setTextColor(((muted >> idx) & 1) ? COL_GRID2 : COL_TXT, COL_BG);
         canvas_.setCursor(bx, by + bh + 2);
         canvas_.print(label);
       }
     }
   }
 
+  // ミュート中は左の余白に品質ガバナの平滑化した生成負荷（"L"。ch 単位の差ではなく全体の目安）
+  if (muted && load_pct >= 0) {
+    char lb[8];
+    snprintf(lb, sizeof(lb), "L%d%%", load_pct > 999 ? 999 : load_pct);
+    canvas_.setTextColor(COL_TXT2, COL_BG);
+    canvas_.setCursor(2, inY);
+    canvas_.print(lb);
+  }
+  // その下に音声経路の計測（アンダーラン回数 / リングのブロック数）
+  if (underruns >= 0) {
+    char lb[8];
+    canvas_.setTextColor(underruns ? COL_TXT : COL_TXT2, COL_BG);
+    snprintf(lb, sizeof(lb), "U%d", underruns > 999 ? 999 : underruns);
+    canvas_.setCursor(2, inY + 12);
+    canvas_.print(lb);
+    canvas_.setTextColor(COL_TXT2, COL_BG);
+    snprintf(lb, sizeof(lb), "Q%d", ring_blocks);
+    canvas_.setCursor(2, inY + 22);
+    canvas_.print(lb);
+  }
+
   canvas_.pushSprite(display_, 0, 0);
 
 }
@@ -19,10 +19,14 @@ public:
             const SpectrumState& spec,
             const MeterState& meters,
             const std::string& track_name,
-            uint32_t wr_count,
-            uint32_t pos,
+            uint32_t pos_ms,
+            uint32_t length_ms,
             int volume,
-            bool show_volume);
+            bool show_volume,
+            uint32_t muted,      // bit = メータの並び
+            int load_pct,        // 品質ガバナの平滑化した生成負荷%（ミュート中に表示、-1 で無し）
+            int underruns,       // アンダーラン回数（-1 で無し、AUDIO_STATS_ON_SCREEN）
+            int ring_blocks);    // 音声リングのブロック数（同上）
 
 private:
   M5GFX* display_ = nullptr;
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "vgm_chips.hpp"
+
+// S98 (PC-88/PC-98 のレジスタログ)。v1-v3
+// 数値はすべて little endian。オフセットはファイル先頭から。
+namespace s98 {
+
+constexpr uint32_t kOffTimerNum   = 0x04;   // u32 1 sync = num/den 秒（0 なら 10/1000）
+constexpr uint32_t kOffTimerDen   = 0x08;
+constexpr uint32_t kOffTag        = 0x10;   // v3: "[S98]" タグ / v1,v2: タイトル文字列
+constexpr uint32_t kOffDump       = 0x14;
+constexpr uint32_t kOffLoop       = 0x18;   // 0 = ループ無し
+constexpr uint32_t kOffDevCount   = 0x1C;   // v3 のみ。0 なら OPNA 1台
+constexpr uint32_t kOffDevices    = 0x20;   // 16 バイト毎: type, clock, pan, reserved
+constexpr uint32_t kHeaderSize    = 0x20;
+constexpr uint32_t kMaxDevices    = 8;
+
+// device type
+constexpr uint32_t kDevPSG  = 1;    // YM2149
+constexpr uint32_t kDevOPN  = 2;
+constexpr uint32_t kDevOPNA = 4;
+constexpr uint32_t kDevAY   = 15;   // AY-3-8910
+constexpr uint32_t kDevDCSG = 16;   // SN76489
+
+constexpr uint32_t kDefaultOPNAClock = 7987200;
+
+// dump commands（0x00-0x7F は device*2 + port, reg, data）
+constexpr uint8_t kCmdSync  = 0xFF;   // 1 sync
+constexpr uint8_t kCmdSyncN = 0xFE;   // 可変長 n, n+2 sync
+constexpr uint8_t kCmdEnd   = 0xFD;
+
+inline bool is_s98(const uint8_t* d, size_t size) {
+  return d && size >= kHeaderSize && d[0] == 'S' && d[1] == '9' && d[2] == '8';
+}
+
+inline uint32_t rd32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// device 番号 → VGMChipId（未対応は VGM_CHIP_NONE）と clock。戻り値は device 数
+inline uint32_t map_devices(const uint8_t* d, size_t size, uint8_t* chip, uint32_t* clock) {
+  uint32_t count = (d[3] == '3') ? rd32(d + kOffDevCount) : 0;
+  if (count == 0) {
+    chip[0] = VGM_CHIP_YM2608;
+    clock[0] = kDefaultOPNAClock;
+    return 1;
+  }
+  if (count > kMaxDevices) count = kMaxDevices;
+
+  uint32_t opn_n = 0;
+  bool opna_used = false, psg_used = false, dcsg_used = false;
+  for (uint32_t i = 0; i < count; ++i) {
+    chip[i] = VGM_CHIP_NONE;
+    clock[i] = 0;
+    const uint32_t off = kOffDevices + i * 16;
+    if (off + 8 > size) continue;
+    const uint32_t type = rd32(d + off);
+    clock[i] = rd32(d + off + 4);
+    if (type == kDevOPN && opn_n < 2) {
+      chip[i] = (opn_n++ == 0) ? VGM_CHIP_YM2203 : VGM_CHIP_YM2203_2;
+    } else if (type == kDevOPNA && !opna_used) {
+      chip[i] = VGM_CHIP_YM2608;
+      opna_used = true;
+    } else if ((type == kDevPSG || type == kDevAY) && !psg_used) {
+      chip[i] = VGM_CHIP_AY8910;
+      psg_used = true;
+    } else if (type == kDevDCSG && !dcsg_used) {
+      chip[i] = VGM_CHIP_SN76489;
+      dcsg_used = true;
+    }
+  }
+  return count;
+}
+
+}  // namespace s98
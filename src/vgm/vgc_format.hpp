@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// .vgc : VGM を PC 側 (scripts/vgm2vgc.py) で事前変換した再生専用フォーマット。
+//   - 冗長なレジスタ書き込みを削除、wait は合算して差分時刻で持つ
+//   - 使わない data block は削除、GD3 は UTF-8 文字列
+//   - gzip 無し。そのまま PSRAM に読んでイベント列へコンパイルする
+// 数値はすべて little endian。オフセットはファイル先頭から。
+namespace vgc {
+
+constexpr uint8_t  kMagic[4] = { 'V', 'G', 'C', '1' };
+constexpr uint16_t kVersion = 1;
+
+// header
+constexpr uint32_t kOffVersion      = 0x04;   // u16 version, u16 header size
+constexpr uint32_t kOffTotal        = 0x08;   // u32 一周のサンプル数 (44100Hz)
+constexpr uint32_t kOffLoopSample   = 0x0C;   // u32 ループ開始サンプル (0xFFFFFFFF = 無し)
+constexpr uint32_t kOffLoopOffset   = 0x10;   // u32 ループ開始トークンの位置 (0 = 無し)
+constexpr uint32_t kOffStream       = 0x14;   // u32 offset, u32 size
+constexpr uint32_t kOffPairs        = 0x1C;   // u32 offset, u32 count（target, reg の2バイト組）
+constexpr uint32_t kOffBlocks       = 0x24;   // u32 offset, u32 size（[u8 type][u32 size][data] の並び）
+constexpr uint32_t kOffGd3          = 0x2C;   // u32 offset, u32 size（track_en, track_jp, game_en, author_en の NUL 終端）
+constexpr uint32_t kOffClockYM2203  = 0x34;   // 以下 VGM ヘッダと同じ値（bit30 = dual）
+constexpr uint32_t kOffClockYM2608  = 0x38;
+constexpr uint32_t kOffClockAY8910  = 0x3C;
+constexpr uint32_t kOffClockSN76489 = 0x40;
+constexpr uint32_t kOffSnFeedback   = 0x44;   // u16 feedback, u8 shift width, u8 reserved
+constexpr uint32_t kHeaderSize      = 0x48;
+
+// target byte = VGMChipId | (port << 4)
+constexpr uint8_t kTargetPortShift = 4;
+
+// tokens
+constexpr uint8_t kTokPairMax      = 0x7F;   // 0x00-0x7F: pair[tok] へ書き込み, data
+constexpr uint8_t kTokWrite        = 0x80;   // target, reg, data
+constexpr uint8_t kTokWaitShortMax = 0xBF;   // 0x81-0xBF: (tok - 0x80) サンプル
+constexpr uint8_t kTokWait735      = 0xC0;
+constexpr uint8_t kTokWait882      = 0xC1;
+constexpr uint8_t kTokWaitVar      = 0xC2;   // LEB128 u32
+constexpr uint8_t kTokEnd          = 0xFF;
+
+constexpr uint32_t kMaxPairs = 128;
+
+inline bool is_vgc(const uint8_t* d, size_t size) {
+  return d && size >= kHeaderSize &&
+         d[0] == kMagic[0] && d[1] == kMagic[1] && d[2] == kMagic[2] && d[3] == kMagic[3];
+}
+
+}  // namespace vgc
@@ -1,4 +1,6 @@
 #include "vgm_blob.hpp"
+#include "../app_config.hpp"
+#include "../encoding/sjis_utf8.hpp"
 #include <Arduino.h>
 #include <FS.h>
 #include <LittleFS.h>
@@ -10,8 +12,26 @@ extern "C" {
   int tinfl_decompress_mem_to_mem(void* out_buf, size_t out_len,
                                   const void* src_buf, size_t src_len,
                                   int flags);
+
+  // ストリーミング展開用。tinfl_decompressor は中身を触らず、
+  // ゼロ埋め（m_state=0 == tinfl_init 相当）したメモリを渡す
+  struct tinfl_decompressor_tag;
+  int tinfl_decompress(tinfl_decompressor_tag* r,
+                       const uint8_t* in_buf_next, size_t* in_buf_size,
+                       uint8_t* out_buf_start, uint8_t* out_buf_next, size_t* out_buf_size,
+                       uint32_t flags);
 }
 
+namespace {
+constexpr int kTinflDone = 0;
+constexpr int kTinflNeedsMoreInput = 1;
+constexpr uint32_t kTinflFlagHasMoreInput = 2;
+constexpr size_t kInflateStateBytes = 16 * 1024;  // sizeof(tinfl_decompressor) は ~11KB
+constexpr size_t kDictBytes = 32 * 1024;          // TINFL_LZ_DICT_SIZE（2のべき乗必須）
+constexpr size_t kGzipHeadBytes = 512;
+constexpr uint32_t kGd3MaxBytes = 64 * 1024;
+}  // namespace
+
 
 VGMBlob::~VGMBlob(){ clear(); }
 
@@ -19,9 +39,32 @@ void VGMBlob::clear() {
   if (data_) {
     ps_free_(data_);
     data_ = nullptr;
-    size_ = 0;
   }
+  close_stream_();
+  format_ = VGMFormat::VGM;
+  size_ = 0;
   name_.clear();
+  gd3_track_en_.clear();
+  gd3_track_jp_.clear();
+  gd3_game_en_.clear();
+  gd3_author_en_.clear();
+}
+
+void VGMBlob::close_stream_() {
+  if (inf_state_) { ps_free_(inf_state_); inf_state_ = nullptr; }
+  if (dict_)      { ps_free_(dict_);      dict_ = nullptr; }
+  if (in_buf_)    { ps_free_(in_buf_);    in_buf_ = nullptr; }
+  if (mark_.state) ps_free_(mark_.state);
+  if (mark_.dict)  ps_free_(mark_.dict);
+  mark_ = InflateMark();
+  if (file_) file_.close();
+  file_ = File();
+  streaming_ = false;
+  gz_ = false;
+  spos_ = 0;
+  gd3_off_ = 0;
+  gd3_done_ = false;
+  inf_done_ = false;
 }
 
 void* VGMBlob::ps_alloc_(size_t n) {
@@ -48,76 +91,226 @@ static bool ends_with(const char* s, const char* suf){
   return strcasecmp(s + (a-b), suf) == 0;
 }
 
-bool VGMBlob::load_from_file(const char* path) {
-  clear();
-  name_ = path;
-
-  if (ends_with(path, ".vgz")) return load_vgz_(path);
-  return load_vgm_(path);
+static inline uint32_t u32le_p(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
-bool VGMBlob::load_vgz_(const char* path) {
-  File f = LittleFS.open(path, "r");
-  if (!f) return false;
 
-  size_t gz_size = (size_t)f.size();
-  if (gz_size < 18) return false; // gzip最小
-
-  // gzip全体を読む（まずは簡単に全読み）
-  uint8_t* gz = (uint8_t*)ps_alloc_(gz_size);
-  if (!gz) return false;
-  if (f.read(gz, gz_size) != (int)gz_size) {
-    ps_free_(gz);
-    return false;
-  }
-
-  // gzip header parse
+// gzip header parse: deflate payload の開始位置を返す（0 = 不正）
+static size_t gzip_payload_offset(const uint8_t* gz, size_t n) {
   const uint8_t* p = gz;
-  const uint8_t* end = gz + gz_size;
+  const uint8_t* end = gz + n;
+  if (n < 10) return 0;
 
-  if (p[0] != 0x1F || p[1] != 0x8B || p[2] != 0x08) { // deflate
-    ps_free_(gz);
-    return false;
-  }
+  if (p[0] != 0x1F || p[1] != 0x8B || p[2] != 0x08) return 0; // deflate
   uint8_t flg = p[3];
   p += 10; // base header (ID1 ID2 CM FLG MTIME[4] XFL OS)
 
   // FEXTRA
   if (flg & 0x04) {
-    if (p + 2 > end) { ps_free_(gz); return false; }
+    if (p + 2 > end) return 0;
     uint16_t xlen = (uint16_t)p[0] | ((uint16_t)p[1] << 8);
     p += 2;
-    if (p + xlen > end) { ps_free_(gz); return false; }
+    if (p + xlen > end) return 0;
     p += xlen;
   }
   // FNAME (0-terminated)
   if (flg & 0x08) {
     while (p < end && *p) p++;
-    if (p >= end) { ps_free_(gz); return false; }
+    if (p >= end) return 0;
     p++; // skip null
   }
   // FCOMMENT
   if (flg & 0x10) {
     while (p < end && *p) p++;
-    if (p >= end) { ps_free_(gz); return false; }
+    if (p >= end) return 0;
     p++;
   }
   // FHCRC
   if (flg & 0x02) {
-    if (p + 2 > end) { ps_free_(gz); return false; }
+    if (p + 2 > end) return 0;
     p += 2;
   }
+  return (size_t)(p - gz);
+}
+
+bool VGMBlob::load_from_file(const char* path) {
+  clear();
+  name_ = path;
+
+  if (ends_with(path, ".vgz")) return load_vgz_(path);
+  if (ends_with(path, ".vgc")) return load_vgc_(path);
+  if (ends_with(path, ".s98")) return load_s98_(path);
+  return load_vgm_(path);
+}
+
+static inline void put32le(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static std::string read_utf8_z(const uint8_t* d, size_t sz, uint32_t& pos) {
+  std::string out;
+  while (pos < sz && d[pos] != 0) out.push_back((char)d[pos++]);
+  if (pos < sz) pos++;
+  return out;
+}
+
+uint8_t* VGMBlob::read_whole_(const char* path, size_t& sz) {
+  File f = LittleFS.open(path, "r");
+  if (!f) return nullptr;
+  sz = (size_t)f.size();
+  uint8_t* buf = (uint8_t*)ps_alloc_(sz);
+  if (!buf) return nullptr;
+  if (f.read(buf, sz) != (int)sz) {
+    ps_free_(buf);
+    return nullptr;
+  }
+  return buf;
+}
+
+static void put_vgm_header_base(uint8_t* hdr) {
+  memset(hdr, 0, 0x100);
+  memcpy(hdr, "Vgm ", 4);
+  put32le(hdr + 0x08, 0x171);
+  put32le(hdr + 0x34, 0x100 - 0x34);
+}
+
+// 事前変換済み：展開もストリーミングも無し。全体を PSRAM へ読むだけ
+bool VGMBlob::load_vgc_(const char* path) {
+  size_t sz = 0;
+  uint8_t* buf = read_whole_(path, sz);
+  if (!buf) return false;
+  if (!vgc::is_vgc(buf, sz)) {
+    ps_free_(buf);
+    return false;
+  }
+  data_ = buf;
+  size_ = sz;
+  format_ = VGMFormat::VGC;
+
+  // チップ選択は VGM ヘッダで行うので、必要な欄だけ並べた VGM ヘッダを作る
+  put_vgm_header_base(hdr_);
+  put32le(hdr_ + 0x0C, u32le_p(buf + vgc::kOffClockSN76489));
+  hdr_[0x28] = buf[vgc::kOffSnFeedback];
+  hdr_[0x29] = buf[vgc::kOffSnFeedback + 1];
+  hdr_[0x2A] = buf[vgc::kOffSnFeedback + 2];
+  put32le(hdr_ + 0x44, u32le_p(buf + vgc::kOffClockYM2203));
+  put32le(hdr_ + 0x48, u32le_p(buf + vgc::kOffClockYM2608));
+  put32le(hdr_ + 0x74, u32le_p(buf + vgc::kOffClockAY8910));
+
+  uint32_t gd3 = u32le_p(buf + vgc::kOffGd3);
+  uint32_t gd3_sz = u32le_p(buf + vgc::kOffGd3 + 4);
+  if (gd3 != 0 && (uint64_t)gd3 + gd3_sz <= sz) {
+    const uint8_t* g = buf + gd3;
+    uint32_t pos = 0;
+    gd3_track_en_  = read_utf8_z(g, gd3_sz, pos);
+    gd3_track_jp_  = read_utf8_z(g, gd3_sz, pos);
+    gd3_game_en_   = read_utf8_z(g, gd3_sz, pos);
+    gd3_author_en_ = read_utf8_z(g, gd3_sz, pos);
+  }
+  return true;
+}
+
+// S98 も小さいので全体を読む。device 一覧を VGM ヘッダのクロック欄へ写す
+bool VGMBlob::load_s98_(const char* path) {
+  size_t sz = 0;
+  uint8_t* buf = read_whole_(path, sz);
+  if (!buf) return false;
+  if (!s98::is_s98(buf, sz)) {
+    ps_free_(buf);
+    return false;
+  }
+  data_ = buf;
+  size_ = sz;
+  format_ = VGMFormat::S98;
+
+  uint8_t chip[s98::kMaxDevices];
+  uint32_t clock[s98::kMaxDevices];
+  uint32_t n = s98::map_devices(buf, sz, chip, clock);
+
+  put_vgm_header_base(hdr_);
+  for (uint32_t i = 0; i < n; ++i) {
+    switch (chip[i]) {
+      case VGM_CHIP_YM2203:   put32le(hdr_ + 0x44, clock[i]); break;
+      case VGM_CHIP_YM2203_2: hdr_[0x47] |= 0x40; break;   // dual
+      case VGM_CHIP_YM2608:   put32le(hdr_ + 0x48, clock[i]); break;
+      case VGM_CHIP_AY8910:   put32le(hdr_ + 0x74, clock[i]); break;
+      case VGM_CHIP_SN76489:  put32le(hdr_ + 0x0C, clock[i]); break;
+      default: break;
+    }
+  }
+
+  parse_s98_tag_();
+  return true;
+}
+
+// v3: "[S98]" + "key=value\n" の並び（UTF-8 は BOM 付き、それ以外は Shift-JIS）
+// v1/v2: タイトル文字列（Shift-JIS）。Shift-JIS は MDX と同じ表で UTF-8 へ直す
+void VGMBlob::parse_s98_tag_() {
+  uint32_t off = u32le_p(data_ + s98::kOffTag);
+  if (off == 0 || off >= size_) return;
+  const char* p = (const char*)data_ + off;
+  const char* end = (const char*)data_ + size_;
+
+  if (end - p < 5 || memcmp(p, "[S98]", 5) != 0) {
+    gd3_track_en_ = sjis_to_utf8(p, (size_t)(end - p));
+    return;
+  }
+
+  p += 5;
+  bool utf8 = false;
+  if (end - p >= 3 && (uint8_t)p[0] == 0xEF && (uint8_t)p[1] == 0xBB && (uint8_t)p[2] == 0xBF) {
+    utf8 = true;
+    p += 3;
+  }
+  while (p < end && *p) {
+    const char* eol = p;
+    while (eol < end && *eol && *eol != 0x0A) ++eol;
+    const char* eq = p;
+    while (eq < eol && *eq != '=') ++eq;
+    if (eq < eol) {
+      std::string key(p, eq - p);
+      size_t vlen = (size_t)(eol - eq - 1);
+      if (vlen && eq[vlen] == 0x0D) --vlen;
+      std::string val = utf8 ? std::string(eq + 1, vlen) : sjis_to_utf8(eq + 1, vlen);
+      for (auto& c : key) if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+      if (key == "title") gd3_track_en_ = val;
+      else if (key == "game") gd3_game_en_ = val;
+      else if (key == "artist") gd3_author_en_ = val;
+    }
+    p = (eol < end && *eol == 0x0A) ? eol + 1 : eol;
+  }
+}
+
+bool VGMBlob::load_vgz_(const char* path) {
+  File f = LittleFS.open(path, "r");
+  if (!f) return false;
+
+  size_t gz_size = (size_t)f.size();
+  if (gz_size < 18) return false; // gzip最小
 
   // trailer: last 8 bytes = CRC32(4) + ISIZE(4)
-  if (end < gz + 8) { ps_free_(gz); return false; }
-  const uint8_t* trailer = end - 8;
-  if (p >= trailer) { ps_free_(gz); return false; }
+  uint8_t trailer[8];
+  if (!f.seek((uint32_t)(gz_size - 8)) || f.read(trailer, 8) != 8) return false;
+  uint32_t isize = u32le_p(trailer + 4);
 
-  uint32_t isize = (uint32_t)trailer[4] | ((uint32_t)trailer[5] << 8) |
-                   ((uint32_t)trailer[6] << 16) | ((uint32_t)trailer[7] << 24);
+  // 大きい曲は全展開せず逐次展開で再生する
+  if (isize >= VGM_STREAM_MIN_BYTES) return open_stream_vgz_(f, isize);
+  if (!f.seek(0)) return false;
+
+  // gzip全体を読む（まずは簡単に全読み）
+  uint8_t* gz = (uint8_t*)ps_alloc_(gz_size);
+  if (!gz) return false;
+  if (f.read(gz, gz_size) != (int)gz_size) {
+    ps_free_(gz);
+    return false;
+  }
+
+  size_t ofs = gzip_payload_offset(gz, gz_size);
+  if (ofs == 0 || ofs >= gz_size - 8) { ps_free_(gz); return false; }
 
   // deflate payload
-  const uint8_t* def = p;
-  size_t def_len = (size_t)(trailer - p);
+  const uint8_t* def = gz + ofs;
+  size_t def_len = gz_size - 8 - ofs;
 
   // output allocate (ISIZE ぶん)
   uint8_t* out = (uint8_t*)ps_alloc_(isize);
@@ -143,6 +336,8 @@ bool VGMBlob::load_vgm_(const char* path) {
   File f = LittleFS.open(path, "r");
   if (!f) return false;
   size_t sz = (size_t)f.size();
+  if (sz >= VGM_STREAM_MIN_BYTES) return open_stream_vgm_(f);
+
   uint8_t* buf = (uint8_t*)ps_alloc_(sz);
   if (!buf) return false;
 
@@ -155,6 +350,252 @@ bool VGMBlob::load_vgm_(const char* path) {
   parse_gd3_();
   return true;
 }
+
+// ===================== streaming =====================
+
+bool VGMBlob::open_stream_vgm_(File& f) {
+  size_t sz = (size_t)f.size();
+  if (sz < sizeof(hdr_)) return false;
+  if (!f.seek(0) || f.read(hdr_, sizeof(hdr_)) != (int)sizeof(hdr_)) return false;
+
+  file_ = f;
+  streaming_ = true;
+  gz_ = false;
+  size_ = sz;
+
+  // 非圧縮ならGD3だけ先に拾える
+  uint32_t rel = u32le_p(hdr_ + 0x14);
+  if (rel != 0 && 0x14 + (uint64_t)rel + 12 <= sz) {
+    gd3_off_ = 0x14 + rel;
+    uint8_t h[12];
+    if (file_.seek(gd3_off_) && file_.read(h, 12) == 12) {
+      uint32_t len = u32le_p(h + 8);
+      if (len > kGd3MaxBytes) len = kGd3MaxBytes;
+      uint8_t* tmp = (uint8_t*)ps_alloc_(12 + len);
+      if (tmp) {
+        memcpy(tmp, h, 12);
+        int got = file_.read(tmp + 12, len);
+        if (got > 0) parse_gd3_block_(tmp, 12 + (size_t)got, 0);
+        ps_free_(tmp);
+      }
+    }
+  }
+  gd3_done_ = true;
+
+  return stream_rewind();
+}
+
+bool VGMBlob::open_stream_vgz_(File& f, uint32_t isize) {
+  size_t gz_size = (size_t)f.size();
+  uint8_t head[kGzipHeadBytes];
+  size_t head_len = gz_size < sizeof(head) ? gz_size : sizeof(head);
+  if (!f.seek(0) || f.read(head, head_len) != (int)head_len) return false;
+
+  size_t ofs = gzip_payload_offset(head, head_len);
+  if (ofs == 0 || ofs >= gz_size - 8) return false;
+
+  inf_state_ = (uint8_t*)ps_alloc_(kInflateStateBytes);
+  dict_ = (uint8_t*)ps_alloc_(kDictBytes);
+  in_buf_ = (uint8_t*)ps_alloc_(VGM_STREAM_CHUNK_BYTES);
+  if (!inf_state_ || !dict_ || !in_buf_) { close_stream_(); return false; }
+
+  file_ = f;
+  streaming_ = true;
+  gz_ = true;
+  size_ = isize;
+  def_start_ = (uint32_t)ofs;
+  def_end_ = (uint32_t)(gz_size - 8);
+
+  if (!stream_rewind() || stream_read(hdr_, sizeof(hdr_)) != sizeof(hdr_)) {
+    close_stream_();
+    return false;
+  }
+
+  // GD3 は末尾側なので、最初にコマンド終端を通過した時に拾う
+  uint32_t rel = u32le_p(hdr_ + 0x14);
+  gd3_off_ = (rel == 0) ? 0 : 0x14 + rel;
+  gd3_done_ = (gd3_off_ == 0);
+
+  return stream_rewind();
+}
+
+bool VGMBlob::stream_rewind() {
+  if (!streaming_) return false;
+  spos_ = 0;
+  if (!gz_) return file_.seek(0);
+
+  memset(inf_state_, 0, kInflateStateBytes);
+  file_pos_ = def_start_;
+  in_rd_ = in_len_ = 0;
+  dict_ofs_ = 0;
+  out_rd_ = out_wr_ = 0;
+  inf_done_ = false;
+  return file_.seek(def_start_);
+}
+
+bool VGMBlob::stream_seek(uint32_t pos) {
+  if (!streaming_) return false;
+  if (pos >= spos_) return stream_skip(pos - spos_);
+  if (!gz_) {
+    if (!file_.seek(pos)) return false;
+    spos_ = pos;
+    return true;
+  }
+  // 先頭から展開し直すと数百KB〜を1ブロックの中で処理することになるので、控えから
+  if (mark_.valid && mark_.spos <= pos && restore_mark_()) return stream_skip(pos - spos_);
+  return stream_rewind() && stream_skip(pos);
+}
+
+void VGMBlob::stream_mark() {
+  if (!streaming_ || !gz_) return;
+  if (!mark_.state) mark_.state = (uint8_t*)ps_alloc_(kInflateStateBytes);
+  if (!mark_.dict) mark_.dict = (uint8_t*)ps_alloc_(kDictBytes);
+  if (!mark_.state || !mark_.dict) {
+    mark_.valid = false;
+    return;
+  }
+  // tinfl_decompressor はポインタを持たないのでバイト列のまま控えてよい
+  memcpy(mark_.state, inf_state_, kInflateStateBytes);
+  memcpy(mark_.dict, dict_, kDictBytes);
+  mark_.spos = spos_;
+  mark_.chunk_pos = file_pos_ - (uint32_t)in_len_;
+  mark_.in_rd = in_rd_;
+  mark_.in_len = in_len_;
+  mark_.dict_ofs = dict_ofs_;
+  mark_.out_rd = out_rd_;
+  mark_.out_wr = out_wr_;
+  mark_.inf_done = inf_done_;
+  mark_.valid = true;
+}
+
+bool VGMBlob::restore_mark_() {
+  memcpy(inf_state_, mark_.state, kInflateStateBytes);
+  memcpy(dict_, mark_.dict, kDictBytes);
+  if (!file_.seek(mark_.chunk_pos)) return false;
+  if (mark_.in_len > 0 && file_.read(in_buf_, mark_.in_len) != (int)mark_.in_len) return false;
+  file_pos_ = mark_.chunk_pos + (uint32_t)mark_.in_len;
+  in_rd_ = mark_.in_rd;
+  in_len_ = mark_.in_len;
+  dict_ofs_ = mark_.dict_ofs;
+  out_rd_ = mark_.out_rd;
+  out_wr_ = mark_.out_wr;
+  inf_done_ = mark_.inf_done;
+  spos_ = mark_.spos;
+  return true;
+}
+
+// 展開窓へ次の出力を作る。作った分は [out_rd_, out_wr_) に並ぶ
+bool VGMBlob::inflate_more_() {
+  while (!inf_done_) {
+    if (in_rd_ == in_len_ && file_pos_ < def_end_) {
+      size_t want = def_end_ - file_pos_;
+      if (want > VGM_STREAM_CHUNK_BYTES) want = VGM_STREAM_CHUNK_BYTES;
+      int got = file_.read(in_buf_, want);
+      if (got <= 0) { inf_done_ = true; return false; }
+      file_pos_ += (uint32_t)got;
+      in_rd_ = 0;
+      in_len_ = (size_t)got;
+    }
+
+    if (dict_ofs_ == kDictBytes) dict_ofs_ = 0;  // 窓を一周
+    size_t in_sz = in_len_ - in_rd_;
+    size_t out_sz = kDictBytes - dict_ofs_;
+    uint32_t flags = (file_pos_ < def_end_) ? kTinflFlagHasMoreInput : 0;
+    int st = tinfl_decompress((tinfl_decompressor_tag*)inf_state_,
+                              in_buf_ + in_rd_, &in_sz,
+                              dict_, dict_ + dict_ofs_, &out_sz, flags);
+    in_rd_ += in_sz;
+    out_rd_ = dict_ofs_;
+    out_wr_ = dict_ofs_ + out_sz;
+    dict_ofs_ += out_sz;
+
+    if (st <= kTinflDone) inf_done_ = true;   // 完了 or 失敗
+    if (out_sz > 0) return true;
+    if (st == kTinflNeedsMoreInput && file_pos_ >= def_end_) inf_done_ = true;
+  }
+  return false;
+}
+
+size_t VGMBlob::stream_read(uint8_t* dst, size_t n) {
+  if (!streaming_) return 0;
+
+  if (!gz_) {
+    int got = file_.read(dst, n);
+    if (got <= 0) return 0;
+    spos_ += (uint32_t)got;
+    return (size_t)got;
+  }
+
+  size_t got = 0;
+  while (got < n) {
+    if (out_rd_ == out_wr_ && !inflate_more_()) break;
+    size_t k = out_wr_ - out_rd_;
+    if (k > n - got) k = n - got;
+    memcpy(dst + got, dict_ + out_rd_, k);
+    out_rd_ += k;
+    got += k;
+  }
+  spos_ += (uint32_t)got;
+  return got;
+}
+
+bool VGMBlob::stream_skip(uint32_t n) {
+  if (!streaming_) return false;
+
+  if (!gz_) {
+    if ((uint64_t)spos_ + n > size_) return false;
+    if (!file_.seek(spos_ + n)) return false;
+    spos_ += n;
+    return true;
+  }
+
+  while (n > 0) {
+    if (out_rd_ == out_wr_ && !inflate_more_()) return false;
+    size_t k = out_wr_ - out_rd_;
+    if (k > n) k = n;
+    out_rd_ += k;
+    spos_ += (uint32_t)k;
+    n -= (uint32_t)k;
+  }
+  return true;
+}
+
+void VGMBlob::stream_finish_pass(const uint8_t* ahead, uint32_t ahead_pos) {
+  if (!streaming_ || gd3_done_) return;
+  gd3_done_ = true;
+  // 先読みの中から始まるなら、そこから写して続きを読む。それより前は読み直さない
+  const uint32_t ahead_end = spos_;
+  if (gd3_off_ < ahead_end) {
+    if (!ahead || gd3_off_ < ahead_pos) return;
+  } else if (!stream_skip(gd3_off_ - spos_)) {
+    return;
+  }
+  uint32_t at = gd3_off_;
+  auto read = [&](uint8_t* dst, size_t n) -> size_t {
+    size_t got = 0;
+    if (at < ahead_end) {
+      got = ahead_end - at < n ? ahead_end - at : n;
+      memcpy(dst, ahead + (at - ahead_pos), got);
+      at += (uint32_t)got;
+    }
+    if (got < n) got += stream_read(dst + got, n - got);
+    return got;
+  };
+
+  uint8_t h[12];
+  if (read(h, 12) != 12) return;
+  uint32_t len = u32le_p(h + 8);
+  if (len > kGd3MaxBytes) len = kGd3MaxBytes;
+
+  uint8_t* tmp = (uint8_t*)ps_alloc_(12 + len);
+  if (!tmp) return;
+  memcpy(tmp, h, 12);
+  size_t got = read(tmp + 12, len);
+  parse_gd3_block_(tmp, 12 + got, 0);
+  ps_free_(tmp);
+  ++gd3_serial_;
+}
+
 static inline uint32_t u32le_at(const uint8_t* d, size_t sz, uint32_t off) {
   if (!d || off + 4 > sz) return 0;
   return (uint32_t)d[off] | ((uint32_t)d[off+1] << 8) | ((uint32_t)d[off+2] << 16) | ((uint32_t)d[off+3] << 24);
@@ -184,41 +625,44 @@ static std::string read_utf16le_z_to_utf8(const uint8_t* d, size_t sz, uint32_t&
 }
 
 void VGMBlob::parse_gd3_() {
-  gd3_track_en_.clear();
-  gd3_track_jp_.clear();
-  gd3_game_en_.clear();
-  gd3_author_en_.clear();
-
   if (!data_ || size_ < 0x40) return;
 
   // GD3 offset: header 0x14 is relative to 0x14 (0 if none)
   uint32_t rel = u32le_at(data_, size_, 0x14);
   if (rel == 0) return;
 
-  uint32_t gd3 = 0x14 + rel;
-  if (gd3 + 12 > size_) return;
+  parse_gd3_block_(data_, size_, 0x14 + rel);
+}
+
+void VGMBlob::parse_gd3_block_(const uint8_t* d, size_t sz, uint32_t gd3) {
+  gd3_track_en_.clear();
+  gd3_track_jp_.clear();
+  gd3_game_en_.clear();
+  gd3_author_en_.clear();
+
+  if (gd3 + 12 > sz) return;
 
   // signature "Gd3 "
-  if (!(data_[gd3+0]=='G' && data_[gd3+1]=='d' && data_[gd3+2]=='3' && data_[gd3+3]==' ')) return;
+  if (!(d[gd3+0]=='G' && d[gd3+1]=='d' && d[gd3+2]=='3' && d[gd3+3]==' ')) return;
 
-  // uint32_t ver = u32le_at(data_, size_, gd3+4); (使わなくてもOK)
-  uint32_t len = u32le_at(data_, size_, gd3+8);
+  // uint32_t ver = u32le_at(d, sz, gd3+4); (使わなくてもOK)
+  uint32_t len = u32le_at(d, sz, gd3+8);
   uint32_t pos = gd3 + 12;
   uint32_t end = pos + len;
-  if (end > size_) end = (uint32_t)size_;
+  if (end > sz) end = (uint32_t)sz;
 
   // GD3 string order:
   // Track(en), Track(jp), Game(en), Game(jp), System(en), System(jp),
   // Author(en), Author(jp), ReleaseDate, Creator, Notes
-  gd3_track_en_  = read_utf16le_z_to_utf8(data_, end, pos);
-  gd3_track_jp_  = read_utf16le_z_to_utf8(data_, end, pos);
-  gd3_game_en_   = read_utf16le_z_to_utf8(data_, end, pos);
-  (void)read_utf16le_z_to_utf8(data_, end, pos); // game jp
-  (void)read_utf16le_z_to_utf8(data_, end, pos); // system en
-  (void)read_utf16le_z_to_utf8(data_, end, pos); // system jp
-  gd3_author_en_ = read_utf16le_z_to_utf8(data_, end, pos);
-  (void)read_utf16le_z_to_utf8(data_, end, pos); // author jp
-  (void)read_utf16le_z_to_utf8(data_, end, pos); // release
-  (void)read_utf16le_z_to_utf8(data_, end, pos); // creator
-  (void)read_utf16le_z_to_utf8(data_, end, pos); // notes
+  gd3_track_en_  = read_utf16le_z_to_utf8(d, end, pos);
+  gd3_track_jp_  = read_utf16le_z_to_utf8(d, end, pos);
+  gd3_game_en_   = read_utf16le_z_to_utf8(d, end, pos);
+  (void)read_utf16le_z_to_utf8(d, end, pos); // game jp
+  (void)read_utf16le_z_to_utf8(d, end, pos); // system en
+  (void)read_utf16le_z_to_utf8(d, end, pos); // system jp
+  gd3_author_en_ = read_utf16le_z_to_utf8(d, end, pos);
+  (void)read_utf16le_z_to_utf8(d, end, pos); // author jp
+  (void)read_utf16le_z_to_utf8(d, end, pos); // release
+  (void)read_utf16le_z_to_utf8(d, end, pos); // creator
+  (void)read_utf16le_z_to_utf8(d, end, pos); // notes
 }
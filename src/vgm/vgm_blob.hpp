@@ -2,22 +2,45 @@
 #include <cstdint>
 #include <cstddef>
 #include <string>
+#include <FS.h>
+#include "vgm_format.hpp"
 
 class VGMBlob {
 public:
   ~VGMBlob();
 
-  bool load_from_file(const char* path);   // .vgm / .vgz どちらもOK
+  bool load_from_file(const char* path);   // .vgm / .vgz / .vgc / .s98（大きい VGM はストリーミング）
   void clear();
 
-  const uint8_t* data() const { return data_; }
-  size_t size() const { return size_; }
+  const uint8_t* data() const { return data_; }   // ストリーミング時は nullptr
+  size_t size() const { return size_; }           // 展開後の全体サイズ
+  // VGM ヘッダ（先頭 0x100 バイト）。.vgc / .s98 はクロック欄などを VGM 形式に並べ直したもの
+  const uint8_t* header() const { return (streaming_ || format_ != VGMFormat::VGM) ? hdr_ : data_; }
+  VGMFormat format() const { return format_; }
   const std::string& name() const { return name_; }
 
   const std::string& gd3_track_name_en() const { return gd3_track_en_; }
   const std::string& gd3_track_name_jp() const { return gd3_track_jp_; }
   const std::string& gd3_game_name_en()  const { return gd3_game_en_; }
   const std::string& gd3_author_en()     const { return gd3_author_en_; }
+  // ストリーミングの終端で GD3 を読んだ回数（通し番号）。変わったら曲名を出し直す
+  uint32_t gd3_serial() const { return gd3_serial_; }
+
+  // ---- streaming mode ----
+  // 全体をメモリに置かず、固定サイズの窓で順に読み出す（.vgz は逐次展開）
+  bool streaming() const { return streaming_; }
+  size_t stream_read(uint8_t* dst, size_t n);   // 0 = EOF/エラー
+  bool stream_skip(uint32_t n);
+  bool stream_rewind();                         // 先頭へ戻す（.vgz は展開し直し）
+  // pos へ移る。前へ戻る時は stream_mark の位置から（無ければ先頭から）読み直す
+  bool stream_seek(uint32_t pos);
+  // .vgz：今の展開状態（tinfl と 32KB の窓）を覚える。ループ点の手前で1回だけ呼ぶ想定
+  void stream_mark();
+  uint32_t stream_pos() const { return spos_; }
+  // コマンド終端(0x66)に到達した。GD3 が未取得ならこの先から読んでおく。
+  // ahead は呼ぶ側が読んだまま使っていないバイト（位置 ahead_pos から stream_pos() の手前まで）。
+  // GD3 は 0x66 の直後にあるので、先読みの中に入っていることが多い
+  void stream_finish_pass(const uint8_t* ahead = nullptr, uint32_t ahead_pos = 0);
 
 private:
   uint8_t* data_ = nullptr;
@@ -26,11 +49,59 @@ private:
 
   std::string gd3_track_en_, gd3_track_jp_, gd3_game_en_, gd3_author_en_;
 
+  VGMFormat format_ = VGMFormat::VGM;
+
+  // streaming
+  bool streaming_ = false;
+  bool gz_ = false;
+  File file_;
+  uint8_t hdr_[0x100]{};
+  uint32_t spos_ = 0;         // 展開後ストリーム上の位置
+  uint32_t gd3_off_ = 0;      // 0 = なし
+  bool gd3_done_ = false;
+  uint32_t gd3_serial_ = 0;   // clear() でも戻さない
+
+  // gzip (tinfl) streaming state
+  uint8_t* inf_state_ = nullptr;   // tinfl_decompressor（不透明）
+  uint8_t* dict_ = nullptr;        // 32KB 展開窓（そのまま出力として読む）
+  uint8_t* in_buf_ = nullptr;
+  uint32_t def_start_ = 0;         // deflate payload の開始位置（ファイル上）
+  uint32_t def_end_ = 0;           // trailer の直前
+  uint32_t file_pos_ = 0;
+  size_t in_rd_ = 0, in_len_ = 0;
+  size_t dict_ofs_ = 0;
+  size_t out_rd_ = 0, out_wr_ = 0;
+  bool inf_done_ = false;
+
+  // stream_mark の控え（.vgz のみ。入力は読み直すので控えるのは位置だけ）
+  struct InflateMark {
+    uint8_t* state = nullptr;
+    uint8_t* dict = nullptr;
+    bool valid = false;
+    uint32_t spos = 0;
+    uint32_t chunk_pos = 0;   // in_buf_ に読んであった塊のファイル上の位置
+    size_t in_rd = 0, in_len = 0;
+    size_t dict_ofs = 0;
+    size_t out_rd = 0, out_wr = 0;
+    bool inf_done = false;
+  };
+  InflateMark mark_;
+
   bool load_vgm_(const char* path);
   bool load_vgz_(const char* path);
+  bool load_vgc_(const char* path);
+  bool load_s98_(const char* path);
+  uint8_t* read_whole_(const char* path, size_t& sz);
+  void parse_s98_tag_();
+  bool open_stream_vgm_(File& f);
+  bool open_stream_vgz_(File& f, uint32_t isize);
+  bool inflate_more_();
+  bool restore_mark_();
+  void close_stream_();
 
   void* ps_alloc_(size_t n);
   void  ps_free_(void* p);
 
   void parse_gd3_();   // ★追加
+  void parse_gd3_block_(const uint8_t* d, size_t sz, uint32_t gd3);
 };
@@ -0,0 +1,465 @@
+#include "vgm_chips.hpp"
+#include "../ym2203_wrap.hpp"
+#include "../ym2608_wrap.hpp"
+#include "../ym2149_wrap.hpp"
+#include "../psg/sn76489.hpp"
+#include "../psg/ssg_blep.hpp"
+#include "../common/hot_path.hpp"
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+static inline uint32_t u32le(const uint8_t* p){
+  return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24);
+}
+
+// data offset より前にある欄だけ有効（古い版のヘッダは短い）
+static uint32_t header_clock(const uint8_t* hdr, uint32_t data_start, uint32_t off, bool* dual = nullptr) {
+  if (off + 4 > data_start) return 0;
+  uint32_t v = u32le(hdr + off);
+  if (dual) *dual = (v & 0x40000000) != 0;
+  return v & 0x3FFFFFFF;   // bit30: dual chip, bit31: 派生品フラグ
+}
+
+// ---- チップ毎の呼び出し口（Lane からは関数ポインタで呼ぶ） ----
+static inline void write_chip(YM2203Wrap* c, uint8_t, uint8_t r, uint8_t d) { c->write_reg(r, d); }
+static inline void write_chip(YM2608Wrap* c, uint8_t p, uint8_t r, uint8_t d) { c->write_reg(p, r, d); }
+static inline void write_chip(YM2149Wrap* c, uint8_t, uint8_t r, uint8_t d) { c->write_reg(r, d); }
+static inline void write_chip(SN76489* c, uint8_t, uint8_t, uint8_t d) { c->write(d); }
+static inline void write_chip(SSGBlep* c, uint8_t, uint8_t r, uint8_t d) { c->write(r, d); }
+
+// 無音判定を持つチップだけ上書き
+template <class C>
+static inline bool chip_idle(C*) { return false; }
+static inline bool chip_idle(YM2203Wrap* c) { return c->is_idle(); }
+static inline bool chip_idle(SSGBlep* c) { return c->is_idle(); }
+
+// SSG 3ch 合計に掛ける倍率：YM2203 は FM と合わせて 1/4、AY 単体は 1/3（各 Wrap の mono と同じ）
+static constexpr int32_t kSsgGainYM2203 = 32768 / 4;
+static constexpr int32_t kSsgGainAY     = 32768 / 3;
+
+template <class C>
+static bool HOT_FN idle_fn(void* chip) {
+  return chip_idle(static_cast<C*>(chip));
+}
+
+template <class C>
+static void HOT_FN render_fn(void* chip, int16_t* dst, uint32_t n) {
+  static_cast<C*>(chip)->render_block_mono_i16(dst, n);
+}
+
+template <class C>
+static void HOT_FN write_fn(void* chip, uint8_t port, uint8_t reg, uint8_t data) {
+  write_chip(static_cast<C*>(chip), port, reg, data);
+}
+
+VGMChipSet::~VGMChipSet() {
+  clear();
+  for (auto* c : opn_pool_) delete c;
+  delete opna_pool_;
+  delete psg_pool_;
+  delete dcsg_pool_;
+  for (auto* s : ssg_) delete s;
+}
+
+// チップ本体は残す（次の setup で configure し直す）。remote タスクは flush_ の中でしか動かない
+void VGMChipSet::clear() {
+  opn_ = nullptr;
+  opn2_ = nullptr;
+  opna_ = nullptr;
+  psg_ = nullptr;
+  dcsg_ = nullptr;
+  ssg_count_ = 0;
+  for (uint32_t i = 0; i < owned_count_; ++i) free(owned_[i]);
+  owned_count_ = 0;
+  mask_ = 0;
+  src_sr_ = 0;
+  native_ = false;
+  lane_count_ = 0;
+  has_remote_ = false;
+  out_ = nullptr;
+  seg_len_ = 0;
+}
+
+// 前の曲のものがあれば設定し直して使い、無ければ作る（引数はコンストラクタと configure で共通）
+template <class C, class... Args>
+C* VGMChipSet::reuse_(C*& slot, Args... args) {
+  if (slot) slot->configure(args...);
+  else slot = new C(args...);
+  return slot;
+}
+
+template <class C>
+VGMChipSet::Lane& VGMChipSet::push_lane_(C* chip, uint32_t native_sr) {
+  Lane& l = lanes_[lane_count_++];
+  l.chip = chip;
+  l.render = &render_fn<C>;
+  l.write = &write_fn<C>;
+  l.idle = &idle_fn<C>;
+  l.remote = false;
+  l.rs.configure(native_sr, out_sr_, (Resampler::Tier)rs_tier_);
+  l.span_max_out = l.rs.output_for(CHIP_SPAN_SAMPLES);
+  l.pending_count = 0;
+  return l;
+}
+
+template <class C>
+void VGMChipSet::add_lane_(VGMChipId id, C* chip, uint32_t native_sr) {
+  lane_of_[id] = (uint8_t)lane_count_;
+  ssg_lane_of_[id] = kNoLane;
+  push_lane_(chip, native_sr);
+  mask_ |= 1u << id;
+}
+
+SSGBlep* VGMChipSet::new_ssg_(uint32_t ay_clock, int32_t gain_q15) {
+  return reuse_(ssg_[ssg_count_++], ay_clock, out_sr_, gain_q15);
+}
+
+void VGMChipSet::set_lane_rate_(Lane& l, uint32_t native_sr) {
+  l.rs.set_rate(native_sr, out_sr_);
+  l.span_max_out = l.rs.output_for(CHIP_SPAN_SAMPLES);
+}
+
+bool VGMChipSet::setup(const uint8_t* hdr, uint8_t opn_fidelity, uint32_t native_max_sr) {
+  clear();
+  if (!hdr) return false;
+
+  uint32_t rel = u32le(hdr + 0x34);
+  uint32_t data_start = (rel == 0) ? 0x40 : (0x34 + rel);
+
+  bool dual = false;
+  const uint32_t opn_clk  = header_clock(hdr, data_start, 0x44, &dual);
+  const uint32_t opna_clk = header_clock(hdr, data_start, 0x48);
+  const uint32_t ay_clk   = header_clock(hdr, data_start, 0x74);
+  const uint32_t dcsg_clk = header_clock(hdr, data_start, 0x0C);
+
+  // native rate の決まる ymfm のチップを先に用意し、そこから出力レートを決める
+  const auto fid = (ymfm::opn_fidelity)opn_fidelity;
+  if (opn_clk) {
+    opn_ = reuse_(opn_pool_[0], opn_clk, fid);
+    if (dual) opn2_ = reuse_(opn_pool_[1], opn_clk, fid);
+  }
+  if (opna_clk) opna_ = reuse_(opna_pool_, opna_clk, fid);
+  if (ay_clk && !SSG_BLEP_ENABLE) psg_ = reuse_(psg_pool_, ay_clk);
+
+  out_sr_ = OUT_SR;
+  src_sr_ = opn_ ? opn_->sample_rate_native()
+          : opna_ ? opna_->sample_rate_native()
+          : psg_ ? psg_->sample_rate_native() : 0;
+  if (native_max_sr && src_sr_) {
+    // 割り切れても 2:1 以上ならリサンプラ（halfband の間引き）は通る
+    out_sr_ = src_sr_ / ((src_sr_ + native_max_sr - 1) / native_max_sr);
+    native_ = true;
+  }
+
+  // FM のレーンを先に並べる（lanes_[1] が別コアへ行くので、重いものが 1 番に来るように）
+  if (opn_) {
+    opn_->enable_taps(true);
+    add_lane_(VGM_CHIP_YM2203, opn_, opn_->sample_rate_native());
+    if (opn2_) add_lane_(VGM_CHIP_YM2203_2, opn2_, opn2_->sample_rate_native());
+  }
+  if (opna_) add_lane_(VGM_CHIP_YM2608, opna_, opna_->sample_rate_native());
+  if (opn_ && SSG_BLEP_ENABLE) {
+    add_ssg_lane_(VGM_CHIP_YM2203, opn_, opn_clk);
+    if (opn2_) add_ssg_lane_(VGM_CHIP_YM2203_2, opn2_, opn_clk);
+  }
+  if (ay_clk) {
+    if (SSG_BLEP_ENABLE) add_lane_(VGM_CHIP_AY8910, new_ssg_(ay_clk, kSsgGainAY), out_sr_);
+    else add_lane_(VGM_CHIP_AY8910, psg_, psg_->sample_rate_native());
+  }
+  if (dcsg_clk) {
+    uint16_t fb = 0;
+    uint8_t width = 0;
+    if (data_start >= 0x2B) {
+      fb = (uint16_t)(hdr[0x28] | (hdr[0x29] << 8));
+      width = hdr[0x2A];
+    }
+    dcsg_ = reuse_(dcsg_pool_, dcsg_clk, out_sr_, fb, width);
+    add_lane_(VGM_CHIP_SN76489, dcsg_, dcsg_->sample_rate_native());
+  }
+
+  // 2番目のレーン（dual なら YM2203 #2、YM2203 と YM2608 なら YM2608、FM が1台なら
+  // SSG / PSG）を別コアへ。
+  // タスクが作れなければ同じコアで回す
+  if (lane_count_ >= 2 && VGM_MIX_CORE >= 0 && start_task_()) {
+    lanes_[1].remote = true;
+    has_remote_ = true;
+  }
+  return mask_ != 0;
+}
+
+// YM2203 の SSG 部は master / 4 の AY と同じ（既定 prescaler）。
+// 0x00-0x0F の書き込みは write() で Wrap の gate_ssg（音量の記録・ミュート）を通してから
+// このレーンへ。set_mute_mask による音量の書き直しは Wrap から SSGBlep へ直接（ブロック外）
+void VGMChipSet::add_ssg_lane_(VGMChipId id, YM2203Wrap* opn, uint32_t clock) {
+  SSGBlep* s = new_ssg_(clock / 4, kSsgGainYM2203);
+  opn->attach_ssg(s);
+  ssg_lane_of_[id] = (uint8_t)lane_count_;
+  push_lane_(s, out_sr_);
+}
+
+LevelTap* VGMChipSet::opn_ssg_taps() const {
+  return (opn_ && !opn_->ssg_external()) ? &opn_->output_taps()[YM2203Wrap::kFmOutputs] : nullptr;
+}
+
+// どのチップにも同じ並びで掛ける（FM1-3 / SSG A-C。DCSG は tone 1-3 を SSG の位置で）
+void VGMChipSet::set_mute_mask(uint8_t mask) {
+  if (opn_) opn_->set_mute_mask(mask);
+  if (opn2_) opn2_->set_mute_mask(mask);
+  if (opna_) opna_->set_mute_mask(mask);
+  if (has(VGM_CHIP_AY8910)) {
+    if (SSG_BLEP_ENABLE) static_cast<SSGBlep*>(lanes_[lane_of_[VGM_CHIP_AY8910]].chip)->set_mute_mask(mask);
+    else psg_->set_mute_mask(mask);
+  }
+  if (dcsg_) dcsg_->set_mute_mask(mask);
+}
+
+FmEnvelopeProbe VGMChipSet::opn_envelope() const {
+  return opn_ ? opn_->envelope_probe() : FmEnvelopeProbe{};
+}
+
+void VGMChipSet::reset() {
+  if (opn_) opn_->reset();
+  if (opn2_) opn2_->reset();
+  if (opna_) opna_->reset();
+  if (psg_) psg_->reset();
+  if (dcsg_) dcsg_->reset();
+  for (uint32_t i = 0; i < ssg_count_; ++i) ssg_[i]->reset();
+  for (uint32_t i = 0; i < lane_count_; ++i) {
+    lanes_[i].rs.reset();
+    lanes_[i].pending_count = 0;
+  }
+}
+
+// リサンプラの位置と履歴はそのまま使う。切り替え時の段差は数サンプルだけ
+void VGMChipSet::set_opn_fidelity(uint8_t opn_fidelity) {
+  if (native_) return;
+  const auto f = (ymfm::opn_fidelity)opn_fidelity;
+  if (opn_) {
+    opn_->set_fidelity(f);
+    set_lane_rate_(lanes_[lane_of_[VGM_CHIP_YM2203]], opn_->sample_rate_native());
+  }
+  if (opn2_) {
+    opn2_->set_fidelity(f);
+    set_lane_rate_(lanes_[lane_of_[VGM_CHIP_YM2203_2]], opn2_->sample_rate_native());
+  }
+  if (opna_) {
+    opna_->set_fidelity(f);
+    set_lane_rate_(lanes_[lane_of_[VGM_CHIP_YM2608]], opna_->sample_rate_native());
+  }
+  if (opn_) src_sr_ = opn_->sample_rate_native();
+  else if (opna_) src_sr_ = opna_->sample_rate_native();
+}
+
+void VGMChipSet::set_resample_tier(uint8_t tier) {
+  if (tier >= Resampler::kTierCount) tier = Resampler::kTierCount - 1;
+  rs_tier_ = tier;
+  for (uint32_t i = 0; i < lane_count_; ++i) lanes_[i].rs.set_tier((Resampler::Tier)tier);
+}
+
+bool VGMChipSet::add_data_block(uint8_t type, const uint8_t* data, uint32_t size, bool owned) {
+  if (owned) {
+    // 使わなくても所有権は受け取る
+    if (owned_count_ >= kMaxOwned) {
+      free((void*)data);
+      return false;
+    }
+    owned_[owned_count_++] = (void*)data;
+  }
+  if (!wants_data_block(type)) return false;
+
+  // ROM data block: [ROM 全体サイズ u32][開始アドレス u32][data...]
+  if (size <= 8) return false;
+  uint32_t start = u32le(data + 4);
+  return opna_->add_adpcm_b(start, data + 8, size - 8);
+}
+
+void HOT_FN VGMChipSet::write(uint8_t chip, uint8_t port, uint8_t reg, uint8_t data) {
+  if (chip >= VGM_CHIP_COUNT || !((mask_ >> chip) & 1)) return;
+  const uint8_t ssg = ssg_lane_of_[chip];
+  const bool to_ssg = ssg != kNoLane && reg < 0x10;
+  // SSG レーンへ回す分も音量の記録とミュートは Wrap 側で（write_reg を通らないので）
+  if (to_ssg) data = (chip == VGM_CHIP_YM2203 ? opn_ : opn2_)->gate_ssg(reg, data);
+  Lane& l = lanes_[to_ssg ? ssg : lane_of_[chip]];
+  if (!out_) {
+    l.write(l.chip, port, reg, data);
+    return;
+  }
+  if (l.pending_count == VGM_MIX_MAX_WRITES) flush_();
+  PendingWrite& w = l.pending[l.pending_count++];
+  w.at = (uint16_t)seg_len_;
+  w.port = port;
+  w.reg = reg;
+  w.data = data;
+}
+
+// ===================== rendering =====================
+
+// native rate でまとめて生成 → Resampler で出力レートへ、acc に加算
+void HOT_FN VGMChipSet::mix_lane_(Lane& l, int32_t* acc, uint32_t n) {
+  // 無音中（リサンプラの履歴も 0）は生成もフィルタもせず位置だけ進める。書き込みで即復帰する
+  if (l.rs.quiet() && l.idle(l.chip)) {
+    l.rs.skip(n);
+    return;
+  }
+
+  while (n > 0) {
+    const uint32_t kk = n < l.span_max_out ? n : l.span_max_out;
+    const uint32_t need = l.rs.input_for(kk);
+    if (need > 0) l.render(l.chip, l.buf, need);
+    l.rs.process_add(l.buf, acc, kk);
+    acc += kk;
+    n -= kk;
+  }
+}
+
+void VGMChipSet::clock_only(uint32_t n) {
+  for (uint32_t c = 0; c < lane_count_; ++c) {
+    Lane& l = lanes_[c];
+    if (l.idle(l.chip)) {
+      l.rs.skip(n);
+      continue;
+    }
+    for (uint32_t left = n; left > 0; ) {
+      const uint32_t kk = left < l.span_max_out ? left : l.span_max_out;
+      const uint32_t need = l.rs.input_for(kk);
+      if (need > 0) l.render(l.chip, l.buf, need);
+      l.rs.skip(kk);
+      left -= kk;
+    }
+  }
+}
+
+// 溜めた書き込みを時刻順に適用しながら、書き込み間の区間をまとめて生成
+void HOT_FN VGMChipSet::run_lane_(Lane& l, int32_t* acc, uint32_t n) {
+  uint32_t at = 0;
+  for (uint32_t i = 0; i < l.pending_count; ++i) {
+    const PendingWrite& w = l.pending[i];
+    if (w.at > at) {
+      mix_lane_(l, acc + at, w.at - at);
+      at = w.at;
+    }
+    l.write(l.chip, w.port, w.reg, w.data);
+  }
+  l.pending_count = 0;
+  if (n > at) mix_lane_(l, acc + at, n - at);
+}
+
+void HOT_FN VGMChipSet::run_remote_() {
+  uint32_t seq = claim_.load(std::memory_order_acquire);
+  // 取り残された通知 / 生成タスクが先に引き取った回は何もしない
+  if (seq == 0 || !claim_.compare_exchange_strong(seq, 0, std::memory_order_acq_rel)) return;
+  const uint32_t n = job_len_;
+  memset(remote_mix_, 0, sizeof(int32_t) * n);
+  for (uint32_t c = 0; c < lane_count_; ++c) {
+    if (lanes_[c].remote) run_lane_(lanes_[c], remote_mix_, n);
+  }
+  done_seq_.store(seq, std::memory_order_release);
+}
+
+void VGMChipSet::task_entry_(void* arg) {
+#if defined(ESP32)
+  VGMChipSet* self = static_cast<VGMChipSet*>(arg);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->run_remote_();
+  }
+#else
+  (void)arg;
+#endif
+}
+
+bool VGMChipSet::start_task_() {
+#if defined(ESP32)
+  if (task_) return true;
+  TaskHandle_t h = nullptr;
+  if (xTaskCreatePinnedToCore(&VGMChipSet::task_entry_, "vgm_mix", VGM_MIX_TASK_STACK,
+                              this, VGM_MIX_TASK_PRIO, &h, VGM_MIX_CORE) != pdPASS) {
+    return false;
+  }
+  task_ = h;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// 別コアが VGM_MIX_WAIT_US 以内に取りかからなければ（loop() 側の詰まり等）この回は手元で回す。
+// 取りかかった後なら終わるまで待つ（レーンの状態はどちらか一方しか触らない）
+void HOT_FN VGMChipSet::wait_remote_(uint32_t seq) {
+  const uint32_t t0 = micros();
+  while (done_seq_.load(std::memory_order_acquire) != seq) {
+    if (micros() - t0 < VGM_MIX_WAIT_US) continue;
+    uint32_t expect = seq;
+    if (claim_.compare_exchange_strong(expect, 0, std::memory_order_acq_rel)) {
+      memset(remote_mix_, 0, sizeof(int32_t) * job_len_);
+      for (uint32_t c = 0; c < lane_count_; ++c) {
+        if (lanes_[c].remote) run_lane_(lanes_[c], remote_mix_, job_len_);
+      }
+      return;
+    }
+    while (done_seq_.load(std::memory_order_acquire) != seq) { /* 取りかかり済み: 1回分の生成で終わる */ }
+    return;
+  }
+}
+
+// ここまでの区間を全チップ生成して out_ へ。remote チップは別コアと並行
+void HOT_FN VGMChipSet::flush_() {
+  const uint32_t n = seg_len_;
+  uint32_t seq = 0;
+
+  if (has_remote_) {
+    job_len_ = n;
+    seq = job_seq_.load(std::memory_order_relaxed) + 1;
+    if (seq == 0) seq = 1;   // 0 は claim_ の「なし」
+    job_seq_.store(seq, std::memory_order_relaxed);
+    claim_.store(seq, std::memory_order_release);
+#if defined(ESP32)
+    xTaskNotifyGive((TaskHandle_t)task_);
+#endif
+  }
+
+  memset(mix_, 0, sizeof(int32_t) * n);
+  for (uint32_t c = 0; c < lane_count_; ++c) {
+    if (!lanes_[c].remote) run_lane_(lanes_[c], mix_, n);
+  }
+
+  if (has_remote_) {
+    wait_remote_(seq);
+    for (uint32_t i = 0; i < n; ++i) mix_[i] += remote_mix_[i];
+  }
+
+  for (uint32_t i = 0; i < n; ++i) {
+    int32_t v = mix_[i];
+    if (v < -32768) v = -32768;
+    if (v >  32767) v =  32767;
+    out_[i] = (int16_t)v;
+  }
+  out_ += n;
+  seg_len_ = 0;
+}
+
+void HOT_FN VGMChipSet::begin_block(int16_t* dst) {
+  out_ = dst;
+  seg_len_ = 0;
+}
+
+void HOT_FN VGMChipSet::advance(uint32_t n) {
+  while (n > 0) {
+    uint32_t room = (uint32_t)VGM_MIX_BLOCK_SAMPLES - seg_len_;
+    uint32_t k = n < room ? n : room;
+    seg_len_ += k;
+    n -= k;
+    if (seg_len_ == VGM_MIX_BLOCK_SAMPLES) flush_();
+  }
+}
+
+void HOT_FN VGMChipSet::end_block() {
+  if (!out_) return;
+  flush_();   // 末尾に溜まった書き込みもここで適用しておく（ブロック外の直接書き込みと順序を保つ）
+  out_ = nullptr;
+}
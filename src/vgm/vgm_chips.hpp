@@ -0,0 +1,172 @@
+#pragma once
+#include <cstdint>
+#include <atomic>
+#include "../app_config.hpp"
+#include "../dsp/resampler.hpp"
+
+class YM2203Wrap;
+class YM2608Wrap;
+class YM2149Wrap;
+class SN76489;
+class SSGBlep;
+class LevelTap;
+struct FmEnvelopeProbe;
+
+// VGMEvent::chip の値
+enum VGMChipId : uint8_t {
+  VGM_CHIP_YM2203 = 0,
+  VGM_CHIP_YM2608,
+  VGM_CHIP_AY8910,
+  VGM_CHIP_SN76489,
+  VGM_CHIP_YM2203_2,     // 0x44 bit30 (dual) の2台目。コマンドは 0xA5
+  VGM_CHIP_COUNT,
+  VGM_CHIP_NONE = 0xFF,
+};
+
+// VGM data block (0x67) の種類のうち使うもの
+constexpr uint8_t VGM_BLOCK_YM2608_ADPCM_B = 0x81;
+
+// ヘッダのクロック欄から必要なチップを並べ、まとめて鳴らす。
+// ブロック中の書き込みはチップ毎に（ブロック内オフセット付きで）溜めておき、
+// end_block / 溜まりきった時点でチップ毎に native rate でまとめて生成→出力レートへリサンプルして加算する。
+// 2台目のチップはもう片方のコアのタスクが並行して生成する
+class VGMChipSet {
+public:
+  ~VGMChipSet();
+
+  // 対応チップが1つも無ければ false。opn_fidelity は ymfm::opn_fidelity（OPN/OPNA に適用）。
+  // native_max_sr が 0 なら OUT_SR で出す。それ以外は最初の ymfm チップの native rate を
+  // native_max_sr 以下になるまで整数で割ったレートで出す（ymfm のチップが無ければ OUT_SR のまま）。
+  // その場合 OPN/OPNA の fidelity は setup の値に固定する（set_opn_fidelity は何もしない）
+  bool setup(const uint8_t* hdr, uint8_t opn_fidelity, uint32_t native_max_sr = 0);
+  void clear();
+
+  bool empty() const { return mask_ == 0; }
+  uint32_t output_rate() const { return out_sr_; }
+  // output_rate() を決めた ymfm チップ（1台目）の native rate。無ければ 0
+  uint32_t source_rate() const { return src_sr_; }
+  uint32_t mask() const { return mask_; }
+  bool has(VGMChipId id) const { return (mask_ >> id) & 1; }
+  YM2203Wrap* opn() const { return opn_; }
+  // メータ用：YM2203 1台目の SSG A-C の実出力タップ（3本の配列）と FM の EG。
+  // タップは SSG を BLEP で鳴らしていて ymfm 側の SSG が無音の時も nullptr
+  LevelTap* opn_ssg_taps() const;
+  FmEnvelopeProbe opn_envelope() const;
+
+  void reset();
+
+  // ch ミュート（YM2203Wrap::set_mute_mask の並び）を全チップへ。ブロック外で呼ぶこと
+  void set_mute_mask(uint8_t mask);
+
+  // OPN/OPNA の fidelity を変え、native rate に合わせてリサンプラを組み直す。ブロック外で呼ぶこと。
+  // native_max_sr 付きの setup 後は出力レートが今の native rate から決まっているので変えない
+  void set_opn_fidelity(uint8_t opn_fidelity);
+
+  // native rate → 出力レートのリサンプラの段階（Resampler::Tier）。次の setup にも引き継ぐ。ブロック外で呼ぶこと
+  void set_resample_tier(uint8_t tier);
+
+  // data block を対応チップのサンプルメモリとして登録（ロード時に1回）。
+  // data はコピーしないので clear() まで有効なこと。owned なら clear() で free する
+  bool add_data_block(uint8_t type, const uint8_t* data, uint32_t size, bool owned);
+  bool wants_data_block(uint8_t type) const {
+    return type == VGM_BLOCK_YM2608_ADPCM_B && has(VGM_CHIP_YM2608);
+  }
+
+  // ブロック外（シーク・早送り）は即座にチップへ、ブロック中は溜める
+  void write(uint8_t chip, uint8_t port, uint8_t reg, uint8_t data);
+
+  // ブロック外（早送り）：n サンプル（output_rate()）ぶん各チップを native rate で回して捨てる。
+  // リサンプルと mix はせず、リサンプラは位置だけ進める（履歴は古いまま）
+  void clock_only(uint32_t n);
+
+  // dst へ output_rate() で出力する。advance(n) は直前までの書き込みの後に n サンプル進める
+  void begin_block(int16_t* dst);
+  void advance(uint32_t n);
+  void end_block();
+
+private:
+  using RenderFn = void (*)(void* chip, int16_t* dst, uint32_t n);
+  using WriteFn  = void (*)(void* chip, uint8_t port, uint8_t reg, uint8_t data);
+  using IdleFn   = bool (*)(void* chip);
+
+  struct PendingWrite {
+    uint16_t at;     // ブロック内オフセット（出力サンプル）
+    uint8_t port, reg, data;
+  };
+
+  struct Lane {
+    void* chip = nullptr;
+    RenderFn render = nullptr;
+    WriteFn write = nullptr;
+    IdleFn idle = nullptr;
+    bool remote = false;         // 別コアのタスクで生成
+    Resampler rs;                // native_sr → out_sr_
+    uint32_t span_max_out = 1;   // 1回の生成で buf に収まる出力サンプル数
+    uint32_t pending_count = 0;
+    PendingWrite pending[VGM_MIX_MAX_WRITES];
+    int16_t buf[CHIP_SPAN_SAMPLES];
+  };
+
+  uint32_t mask_ = 0;
+  uint32_t out_sr_ = OUT_SR;
+  uint32_t src_sr_ = 0;
+  bool native_ = false;          // out_sr_ を src_sr_ から決めた（fidelity 固定）
+  YM2203Wrap* opn_ = nullptr;
+  YM2203Wrap* opn2_ = nullptr;
+  YM2608Wrap* opna_ = nullptr;
+  YM2149Wrap* psg_ = nullptr;
+  SN76489* dcsg_ = nullptr;
+  SSGBlep* ssg_[3]{};            // SSG_BLEP_ENABLE: YM2203 x2 の SSG 部と AY8910（先頭 ssg_count_ 個が使用中）
+  uint32_t ssg_count_ = 0;
+
+  // 曲をまたいで使い回すチップ本体。clear() では消さず、setup() で configure し直す
+  YM2203Wrap* opn_pool_[2]{};
+  YM2608Wrap* opna_pool_ = nullptr;
+  YM2149Wrap* psg_pool_ = nullptr;
+  SN76489* dcsg_pool_ = nullptr;
+
+  static constexpr uint32_t kMaxOwned = 32;
+  void* owned_[kMaxOwned]{};
+  uint32_t owned_count_ = 0;
+
+  // YM2203 の SSG 部を別レーンにする分だけ多め
+  static constexpr uint32_t kMaxLanes = VGM_CHIP_COUNT + 2;
+  static constexpr uint8_t kNoLane = 0xFF;
+  Lane lanes_[kMaxLanes];
+  uint8_t lane_of_[VGM_CHIP_COUNT]{};
+  uint8_t ssg_lane_of_[VGM_CHIP_COUNT]{};   // 0x00-0x0F の書き込み先（kNoLane = lane_of_ と同じ）
+  uint32_t lane_count_ = 0;
+  bool has_remote_ = false;
+  uint8_t rs_tier_ = Resampler::kFast;
+
+  // block
+  int16_t* out_ = nullptr;       // nullptr = ブロック外
+  uint32_t seg_len_ = 0;
+  int32_t mix_[VGM_MIX_BLOCK_SAMPLES];
+
+  // remote (別コア) 側。seq の受け渡しだけで同期する
+  // claim_ は未着手の job の seq（0 = なし）。先に CAS で 0 にした側がその回の remote レーンを回す
+  int32_t remote_mix_[VGM_MIX_BLOCK_SAMPLES];
+  uint32_t job_len_ = 0;
+  std::atomic<uint32_t> job_seq_{0};
+  std::atomic<uint32_t> claim_{0};
+  std::atomic<uint32_t> done_seq_{0};
+  void* task_ = nullptr;
+
+  template <class C, class... Args>
+  static C* reuse_(C*& slot, Args... args);
+  template <class C>
+  Lane& push_lane_(C* chip, uint32_t native_sr);
+  template <class C>
+  void add_lane_(VGMChipId id, C* chip, uint32_t native_sr);
+  SSGBlep* new_ssg_(uint32_t ay_clock, int32_t gain_q15);
+  void add_ssg_lane_(VGMChipId id, YM2203Wrap* opn, uint32_t clock);
+  void set_lane_rate_(Lane& l, uint32_t native_sr);
+  void mix_lane_(Lane& l, int32_t* acc, uint32_t n);
+  void run_lane_(Lane& l, int32_t* acc, uint32_t n);
+  void run_remote_();
+  void wait_remote_(uint32_t seq);
+  void flush_();
+  bool start_task_();
+  static void task_entry_(void* arg);
+};
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "vgc_format.hpp"
+#include "s98_format.hpp"
+
+// VGMPlayer が読めるログ形式（先頭のマジックで判定）
+enum class VGMFormat : uint8_t { VGM, VGC, S98 };
+
+inline VGMFormat vgm_detect_format(const uint8_t* d, size_t size) {
+  if (vgc::is_vgc(d, size)) return VGMFormat::VGC;
+  if (s98::is_s98(d, size)) return VGMFormat::S98;
+  return VGMFormat::VGM;
+}
@@ -1,96 +1,916 @@
 #include "vgm_player.hpp"
 #include "../opn/opn_state.hpp"
 #include "../app_config.hpp"
+#include "vgm_blob.hpp"
+#include "vgm_chips.hpp"
 #include "ym2203_wrap.hpp"
+#include "../common/hot_path.hpp"
+#include <Arduino.h>
 #include <string.h>
 
 static inline uint32_t u32le(const uint8_t* p){
   return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24);
 }
 
+// ===================== opcode table =====================
+// コマンドは1バイト目だけで長さと行き先が決まるので、256 エントリの表を引く
+
+enum : uint8_t {
+  OP_STOP = 0,     // 未知 -> 停止
+  OP_SKIP,         // 長さだけ既知（未対応チップ・DAC stream 制御など）
+  OP_WRITE_AD,     // aa dd
+  OP_WRITE_D,      // dd（SN76489）
+  OP_WRITE_AY,     // aa dd（aa bit7 = 2台目）
+  OP_WAIT16,       // 0x61 nn nn
+  OP_WAIT735,
+  OP_WAIT882,
+  OP_WAIT_SHORT,   // 0x7n: n+1
+  OP_WAIT_DAC,     // 0x8n: YM2612 DAC 書き込み + n（書き込みは捨てる）
+  OP_END,
+  OP_DATA_BLOCK,
+};
+
+struct VGMOp {
+  uint8_t kind;
+  uint8_t len;     // オペコード込みのバイト数（data block は先頭7バイト）
+  uint8_t chip;
+  uint8_t port;
+};
+
+struct VGMOpTable { VGMOp op[256]; };
+
+static constexpr VGMOpTable build_op_table() {
+  VGMOpTable t{};
+  for (int c = 0; c < 256; ++c) {
+    VGMOp o{OP_STOP, 1, VGM_CHIP_NONE, 0};
+    if      (c >= 0x30 && c <= 0x3F) o = {OP_SKIP, 2, VGM_CHIP_NONE, 0};
+    else if (c >= 0x40 && c <= 0x4E) o = {OP_SKIP, 3, VGM_CHIP_NONE, 0};
+    else if (c == 0x4F)              o = {OP_SKIP, 2, VGM_CHIP_NONE, 0};
+    else if (c == 0x50)              o = {OP_WRITE_D, 2, VGM_CHIP_SN76489, 0};
+    else if (c == 0x55)              o = {OP_WRITE_AD, 3, VGM_CHIP_YM2203, 0};
+    else if (c == 0x56)              o = {OP_WRITE_AD, 3, VGM_CHIP_YM2608, 0};
+    else if (c == 0x57)              o = {OP_WRITE_AD, 3, VGM_CHIP_YM2608, 1};
+    else if (c >= 0x51 && c <= 0x5F) o = {OP_SKIP, 3, VGM_CHIP_NONE, 0};
+    else if (c == 0x61)              o = {OP_WAIT16, 3, VGM_CHIP_NONE, 0};
+    else if (c == 0x62)              o = {OP_WAIT735, 1, VGM_CHIP_NONE, 0};
+    else if (c == 0x63)              o = {OP_WAIT882, 1, VGM_CHIP_NONE, 0};
+    else if (c == 0x66)              o = {OP_END, 1, VGM_CHIP_NONE, 0};
+    else if (c == 0x67)              o = {OP_DATA_BLOCK, 7, VGM_CHIP_NONE, 0};
+    else if (c == 0x68)              o = {OP_SKIP, 12, VGM_CHIP_NONE, 0};
+    else if (c >= 0x70 && c <= 0x7F) o = {OP_WAIT_SHORT, 1, VGM_CHIP_NONE, 0};
+    else if (c >= 0x80 && c <= 0x8F) o = {OP_WAIT_DAC, 1, VGM_CHIP_NONE, 0};
+    else if (c == 0x90 || c == 0x91 || c == 0x95) o = {OP_SKIP, 5, VGM_CHIP_NONE, 0};
+    else if (c == 0x92)              o = {OP_SKIP, 6, VGM_CHIP_NONE, 0};
+    else if (c == 0x93)              o = {OP_SKIP, 11, VGM_CHIP_NONE, 0};
+    else if (c == 0x94)              o = {OP_SKIP, 2, VGM_CHIP_NONE, 0};
+    else if (c == 0xA0)              o = {OP_WRITE_AY, 3, VGM_CHIP_AY8910, 0};
+    else if (c == 0xA5)              o = {OP_WRITE_AD, 3, VGM_CHIP_YM2203_2, 0};
+    else if (c >= 0xA1 && c <= 0xBF) o = {OP_SKIP, 3, VGM_CHIP_NONE, 0};
+    else if (c >= 0xC0 && c <= 0xDF) o = {OP_SKIP, 4, VGM_CHIP_NONE, 0};
+    else if (c >= 0xE0)              o = {OP_SKIP, 5, VGM_CHIP_NONE, 0};
+    t.op[c] = o;
+  }
+  return t;
+}
+
+static constexpr VGMOpTable kOps = build_op_table();
+
+VGMPlayer::~VGMPlayer() { clear(); }
+
+void VGMPlayer::clear() {
+  if (ev_) {
+    ps_free_(ev_);
+    ev_ = nullptr;
+  }
+  if (kf_) {
+    ps_free_(kf_);
+    kf_ = nullptr;
+  }
+  kf_count_ = 0;
+  kf_loop_count_ = 0;
+  ev_count_ = 0;
+  ev_idx_ = 0;
+  t_ = 0;
+  end_t_ = 0;
+  loop_ev_ = 0;
+  loop_t_ = 0;
+  loops_ = false;
+  hdr_end_t_ = 0;
+  hdr_loop_t_ = 0;
+  playing_ = false;
+  data_ = nullptr;
+  size_ = 0;
+  src_ = nullptr;
+  in_ = nullptr;
+  in_base_ = in_pos_ = in_len_ = 0;
+  loop_marked_ = false;
+  cc_block_end_ = 0;
+  format_ = VGMFormat::VGM;
+  pairs_ = nullptr;
+  pair_count_ = 0;
+  s98_dev_count_ = 0;
+}
+
+void* VGMPlayer::ps_alloc_(size_t n) {
+#if defined(ESP32)
+  void* p = heap_caps_malloc(n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!p) p = malloc(n);
+  return p;
+#else
+  return malloc(n);
+#endif
+}
+
+// 再生中に引き続けるもの：小さければ内部 DRAM、入らなければ PSRAM
+void* VGMPlayer::hot_alloc_(size_t n) {
+#if defined(ESP32)
+  if (n <= VGM_HOT_EVENT_BYTES) {
+    void* p = heap_caps_malloc(n, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (p) return p;
+  }
+#endif
+  return ps_alloc_(n);
+}
+
+// heap_caps_malloc の分も free でよい
+void VGMPlayer::ps_free_(void* p) {
+  free(p);
+}
+
 uint32_t VGMPlayer::rd32le_at_(uint32_t off) const {
   if (!data_ || off + 4 > size_) return 0;
   return u32le(data_ + off);
 }
 
-uint8_t VGMPlayer::rd8_() {
-  if (pos_ >= size_) return 0;
-  return data_[pos_++];
-}
-
 void VGMPlayer::reset_to_data_() {
-  pos_ = data_start_;
-  wait_ = 0;
-  playing_ = true;
+  ev_idx_ = 0;
+  t_ = 0;
+  playing_ = (ev_ != nullptr);
   wr_count_ = 0;
 }
 
-bool VGMPlayer::load(const uint8_t* data, size_t size, YM2203Wrap& chip, OPNState& state) {
-  data_ = data;
-  size_ = size;
-  chip_ = &chip;
-  state_ = &state;
-
-  if (!data_ || size_ < 0x100) return false;
-  if (!(data_[0]=='V' && data_[1]=='g' && data_[2]=='m' && data_[3]==' ')) return false;
+bool VGMPlayer::parse_header_(const uint8_t* hdr, size_t total) {
+  if (!hdr || total < 0x100) return false;
+  if (!(hdr[0]=='V' && hdr[1]=='g' && hdr[2]=='m' && hdr[3]==' ')) return false;
 
   // data offset (0x34 relative to 0x34, v1.50+). if 0 -> 0x40
-  uint32_t rel = rd32le_at_(0x34);
+  uint32_t rel = u32le(hdr + 0x34);
   data_start_ = (rel == 0) ? 0x40 : (0x34 + rel);
-  if (data_start_ >= size_) return false;
+  if (data_start_ >= total) return false;
 
   // loop offset at 0x1C is relative to 0x1C, 0 if none
-  uint32_t loop_rel = rd32le_at_(0x1C);
+  uint32_t loop_rel = u32le(hdr + 0x1C);
   loop_pos_ = (loop_rel == 0) ? 0 : (0x1C + loop_rel);
+  return true;
+}
+
+void VGMPlayer::bind_(VGMChipSet& chips, OPNState& state) {
+  chips_ = &chips;
+  state_ = &state;
+  chip_mask_ = chips.mask();
+
+  // メーターは OPN 系1台ぶん（YM2608 は port 0 = ch1-3 + SSG、AY は SSG 部だけ一致する）
+  if (chips.has(VGM_CHIP_YM2203))      meter_chip_ = VGM_CHIP_YM2203;
+  else if (chips.has(VGM_CHIP_YM2608)) meter_chip_ = VGM_CHIP_YM2608;
+  else if (chips.has(VGM_CHIP_AY8910)) meter_chip_ = VGM_CHIP_AY8910;
+  else                                 meter_chip_ = VGM_CHIP_NONE;
+
+  const bool opn = meter_chip_ == VGM_CHIP_YM2203;
+  state.attach_taps(opn ? chips.opn_ssg_taps() : nullptr);
+  state.attach_envelope(opn ? chips.opn_envelope() : FmEnvelopeProbe{});
+}
+
+bool VGMPlayer::parse_vgc_header_() {
+  const uint8_t* d = data_;
+  data_start_ = u32le(d + vgc::kOffStream);
+  uint32_t stream_size = u32le(d + vgc::kOffStream + 4);
+  if (data_start_ < vgc::kHeaderSize || (uint64_t)data_start_ + stream_size > size_) return false;
+  loop_pos_ = u32le(d + vgc::kOffLoopOffset);
+
+  uint32_t pairs = u32le(d + vgc::kOffPairs);
+  pair_count_ = u32le(d + vgc::kOffPairs + 4);
+  if (pair_count_ > vgc::kMaxPairs || (uint64_t)pairs + pair_count_ * 2 > size_) return false;
+  pairs_ = d + pairs;
+
+  // data block は変換時に使うものだけ残してある。blob の中を直接渡す
+  uint32_t pos = u32le(d + vgc::kOffBlocks);
+  const uint32_t blocks_size = u32le(d + vgc::kOffBlocks + 4);
+  if (pos > size_ || blocks_size > size_ - pos) return false;   // pos + size が 32bit で回らないように
+  const uint32_t end = pos + blocks_size;
+  while (pos + 5 <= end) {
+    uint8_t type = d[pos];
+    uint32_t sz = u32le(d + pos + 1);
+    pos += 5;
+    if (sz > end - pos) break;
+    chips_->add_data_block(type, d + pos, sz, false);
+    pos += sz;
+  }
+  return true;
+}
+
+bool VGMPlayer::parse_s98_header_() {
+  const uint8_t* d = data_;
+  data_start_ = u32le(d + s98::kOffDump);
+  loop_pos_ = u32le(d + s98::kOffLoop);
+  if (data_start_ < s98::kHeaderSize || data_start_ >= size_) return false;
+  if (loop_pos_ != 0 && (loop_pos_ < data_start_ || loop_pos_ >= size_)) loop_pos_ = 0;
+
+  uint32_t clock[s98::kMaxDevices];
+  s98_dev_count_ = s98::map_devices(d, size_, s98_chip_, clock);
+
+  // 1 sync = num/den 秒。OUT_SR を掛けた形で持ち、割るのはイベント毎に1回
+  uint32_t num = u32le(d + s98::kOffTimerNum);
+  uint32_t den = u32le(d + s98::kOffTimerDen);
+  if (num == 0) num = 10;
+  if (den == 0) den = 1000;
+  s98_mul_ = (uint64_t)OUT_SR * num;
+  s98_den_ = den;
+  return true;
+}
+
+bool VGMPlayer::load(const uint8_t* data, size_t size, VGMChipSet& chips, OPNState& state) {
+  clear();
+  data_ = data;
+  size_ = size;
+  bind_(chips, state);
+
+  format_ = vgm_detect_format(data_, size_);
+  bool ok = false;
+  switch (format_) {
+    case VGMFormat::VGC: ok = parse_vgc_header_(); break;
+    case VGMFormat::S98: ok = parse_s98_header_(); break;
+    default:             ok = parse_header_(data_, size_); break;
+  }
+  if (!ok) return false;
+
+  if (!compile_()) return false;
+  // キーフレームは YM2203 のレジスタ影だけなので単体曲のみ（失敗してもシーク不可になるだけ）
+  if (chip_mask_ == (1u << VGM_CHIP_YM2203)) build_seek_index_();
+  if (VGM_BENCH_ON_LOAD && format_ == VGMFormat::VGM) bench_();
 
   reset_to_data_();
   return true;
 }
 
-void VGMPlayer::step_until_wait_() {
-  while (playing_ && wait_ == 0 && pos_ < size_) {
-    uint8_t cmd = rd8_();
-
-    if (cmd == 0x55) {
-      uint8_t aa = rd8_();
-      uint8_t dd = rd8_();
-      state_->on_write(aa, dd);
-      chip_->write_reg(aa, dd);
-      wr_count_++;
-    }
-    else if (cmd == 0x61) {
-      uint16_t n = (uint16_t)rd8_();
-      n |= (uint16_t)rd8_() << 8;
-      wait_ = n;
-    }
-    else if (cmd == 0x62) wait_ = 735;
-    else if (cmd == 0x63) wait_ = 882;
-    else if ((cmd & 0xF0) == 0x70) wait_ = (cmd & 0x0F) + 1;
-    else if (cmd == 0x66) {
-      // end: loop if possible
-      if (loop_pos_ != 0 && loop_pos_ < size_) {
-        pos_ = loop_pos_;
+bool VGMPlayer::load_stream(VGMBlob& src, VGMChipSet& chips, OPNState& state) {
+  clear();
+  src_ = &src;
+  bind_(chips, state);
+
+  if (!src.streaming()) return false;
+  if (!parse_header_(src.header(), src.size())) return false;
+
+  // 終端まで compile するまでの長さはヘッダから（44.1kHz のサンプル数 → OUT_SR）
+  const uint8_t* hdr = src.header();
+  const uint32_t total = u32le(hdr + 0x18);
+  const uint32_t loop = loop_pos_ ? u32le(hdr + 0x20) : 0;
+  hdr_end_t_ = (uint32_t)(((uint64_t)total * OUT_SR) / 44100);
+  hdr_loop_t_ = hdr_end_t_ - (uint32_t)(((uint64_t)(loop < total ? loop : total) * OUT_SR) / 44100);
+
+  ev_ = (VGMEvent*)hot_alloc_(sizeof(VGMEvent) * ((size_t)VGM_STREAM_EVENT_WINDOW + 1));
+  if (!ev_) return false;
+
+  if (chip_mask_ == (1u << VGM_CHIP_YM2203)) build_stream_seek_index_();
+
+  // 最初の窓だけ compile して即再生開始（残りは再生しながら）
+  compile_begin_();
+  refill_window_();
+
+  reset_to_data_();
+  return true;
+}
+
+// ===================== input cursor =====================
+
+bool VGMPlayer::fill_input_() {
+  if (!src_) return false;
+  in_base_ += in_len_;
+  in_pos_ = 0;
+  // ループ点を含む塊を読む手前で展開状態を控える（ループ毎に先頭から展開し直さない）
+  if (!loop_marked_ && loop_pos_ != 0 && in_base_ <= loop_pos_ && loop_pos_ - in_base_ < sizeof(in_buf_)) {
+    src_->stream_mark();
+    loop_marked_ = true;
+  }
+  in_len_ = (uint32_t)src_->stream_read(in_buf_, sizeof(in_buf_));
+  return in_len_ > 0;
+}
+
+bool VGMPlayer::skip_(uint32_t n) {
+  while (n > 0) {
+    uint32_t avail = in_len_ - in_pos_;
+    if (avail == 0) {
+      if (!src_) return false;
+      // 残りはバッファを経由せずに読み飛ばす
+      if (!src_->stream_skip(n)) return false;
+      in_base_ += in_len_ + n;
+      in_pos_ = in_len_ = 0;
+      return true;
+    }
+    uint32_t k = avail < n ? avail : n;
+    in_pos_ += k;
+    n -= k;
+  }
+  return true;
+}
+
+bool VGMPlayer::read_(uint8_t* dst, uint32_t n) {
+  while (n > 0) {
+    if (in_pos_ >= in_len_ && !fill_input_()) return false;
+    uint32_t k = in_len_ - in_pos_;
+    if (k > n) k = n;
+    memcpy(dst, in_ + in_pos_, k);
+    in_pos_ += k;
+    dst += k;
+    n -= k;
+  }
+  return true;
+}
+
+bool VGMPlayer::seek_input_(uint32_t pos) {
+  if (!src_) {
+    in_ = data_;
+    in_base_ = 0;
+    in_len_ = (uint32_t)size_;
+    in_pos_ = pos;
+    return pos <= size_;
+  }
+  if (!src_->stream_seek(pos)) return false;
+  in_ = in_buf_;
+  in_base_ = pos;
+  in_pos_ = in_len_ = 0;
+  return true;
+}
+
+// ===================== compiler =====================
+
+void VGMPlayer::compile_begin_() {
+  cc_t_ = 0;
+  cc_ticks_ = 0;
+  cc_passes_ = 0;
+  cc_loop_seen_ = false;
+  cc_done_ = false;
+  loop_ev_ = 0;
+  loop_t_ = 0;
+  loops_ = false;
+  end_t_ = UINT32_MAX;
+  if (!seek_input_(data_start_)) compile_finish_(false);
+}
+
+void VGMPlayer::compile_finish_(bool ended) {
+  end_t_ = cc_t_;
+  loops_ = ended;
+  cc_done_ = true;
+}
+
+// コマンド列を1回だけ解釈してイベント列へ落とす（最大 cap 個）。
+// 0x67 データブロックと未知コマンドの扱いはここで確定させる。
+uint32_t VGMPlayer::compile_chunk_(VGMEvent* out, uint32_t cap) {
+  if (format_ == VGMFormat::VGC) return compile_chunk_vgc_(out, cap);
+  if (format_ == VGMFormat::S98) return compile_chunk_s98_(out, cap);
+  uint32_t n = 0;
+
+  while (n < cap && !cc_done_) {
+    if (!cc_loop_seen_ && loop_pos_ != 0 && tell_() >= loop_pos_) {
+      cc_loop_seen_ = true;
+      loop_ev_ = n;
+      loop_t_ = cc_t_;
+    }
+
+    uint8_t cmd;
+    if (!get8_(cmd)) { compile_finish_(false); break; }
+    const VGMOp& op = kOps.op[cmd];
+
+    switch (op.kind) {
+      case OP_WRITE_AD:
+      case OP_WRITE_AY:
+      case OP_WRITE_D: {
+        uint8_t aa = 0, dd;
+        if ((op.len == 3 && !get8_(aa)) || !get8_(dd)) { compile_finish_(false); break; }
+        if (op.kind == OP_WRITE_AY && (aa & 0x80)) break;   // 2台目は未対応
+        if (!((chip_mask_ >> op.chip) & 1)) break;          // ヘッダに無いチップ
+        if (out) {
+          out[n].t = cc_t_;
+          out[n].reg = aa;
+          out[n].data = dd;
+          out[n].chip = op.chip;
+          out[n].port = op.port;
+        }
+        n++;
+        break;
+      }
+      case OP_SKIP:
+        if (!skip_(op.len - 1)) compile_finish_(false);
+        break;
+      case OP_WAIT16: {
+        uint8_t lo, hi;
+        if (!get8_(lo) || !get8_(hi)) { compile_finish_(false); break; }
+        cc_t_ += (uint32_t)lo | ((uint32_t)hi << 8);
+        break;
+      }
+      case OP_WAIT735:    cc_t_ += 735; break;
+      case OP_WAIT882:    cc_t_ += 882; break;
+      case OP_WAIT_SHORT: cc_t_ += (cmd & 0x0F) + 1; break;
+      case OP_WAIT_DAC:   cc_t_ += (cmd & 0x0F); break;
+      case OP_END: {
+        // end: 0x66 で終わった時だけループする（未知コマンド・途切れは停止）
+        bool can_loop = cc_loop_seen_ && loop_t_ < cc_t_;
+        if (src_) {
+          // ストリーミング：ループ点まで読み直し、時刻はそのまま積み上げる
+          src_->stream_finish_pass(in_ + in_pos_, in_base_ + in_pos_);
+          if (can_loop && seek_input_(loop_pos_)) {
+            cc_pass_end_t_ = cc_t_;
+            ++cc_passes_;
+            break;
+          }
+          compile_finish_(false);
+        } else {
+          compile_finish_(can_loop);
+        }
+        break;
+      }
+      case OP_DATA_BLOCK: {
+        // data block: 0x67 0x66 tt [size u32] [data...]
+        uint8_t b[6];
+        bool ok = true;
+        for (int i = 0; i < 6 && ok; ++i) ok = get8_(b[i]);
+        if (!ok) { compile_finish_(false); break; }
+        uint32_t size = u32le(b + 2);
+        bool used = out && tell_() >= cc_block_end_ && chips_->wants_data_block(b[1]);
+        if (!(used ? take_data_block_(b[1], size) : skip_(size))) compile_finish_(false);
+        break;
+      }
+      default:
+        // unknown -> stop
+        compile_finish_(false);
+        break;
+    }
+  }
+
+  return n;
+}
+
+// サンプルメモリ用の data block をチップへ渡す。
+// 全体ロード時は blob の中を直接指す（コピー無し）。ストリーミング時だけ PSRAM へ読み込む
+bool VGMPlayer::take_data_block_(uint8_t type, uint32_t size) {
+  const uint32_t at = tell_();
+  cc_block_end_ = at + size;
+
+  if (!src_) {
+    if ((uint64_t)at + size > size_) return false;
+    chips_->add_data_block(type, data_ + at, size, false);
+    return skip_(size);
+  }
+
+  uint8_t* p = (uint8_t*)ps_alloc_(size);
+  if (!p) return skip_(size);
+  if (!read_(p, size)) {
+    ps_free_(p);
+    return false;
+  }
+  chips_->add_data_block(type, p, size, true);
+  return true;
+}
+
+// .vgc のトークン列。書き込みは (target, reg) 表の添字か明示、wait は合算済み
+uint32_t VGMPlayer::compile_chunk_vgc_(VGMEvent* out, uint32_t cap) {
+  uint32_t n = 0;
+
+  while (n < cap && !cc_done_) {
+    if (!cc_loop_seen_ && loop_pos_ != 0 && tell_() >= loop_pos_) {
+      cc_loop_seen_ = true;
+      loop_ev_ = n;
+      loop_t_ = cc_t_;
+    }
+
+    uint8_t tok;
+    if (!get8_(tok)) { compile_finish_(false); break; }
+
+    if (tok <= vgc::kTokPairMax || tok == vgc::kTokWrite) {
+      uint8_t target, reg, dd;
+      if (tok == vgc::kTokWrite) {
+        if (!get8_(target) || !get8_(reg)) { compile_finish_(false); break; }
       } else {
-        playing_ = false;
+        if (tok >= pair_count_) { compile_finish_(false); break; }
+        target = pairs_[tok * 2];
+        reg = pairs_[tok * 2 + 1];
+      }
+      if (!get8_(dd)) { compile_finish_(false); break; }
+
+      uint8_t chip = target & ((1u << vgc::kTargetPortShift) - 1);
+      if (chip >= VGM_CHIP_COUNT || !((chip_mask_ >> chip) & 1)) continue;
+      if (out) {
+        out[n].t = cc_t_;
+        out[n].reg = reg;
+        out[n].data = dd;
+        out[n].chip = chip;
+        out[n].port = target >> vgc::kTargetPortShift;
+      }
+      n++;
+    }
+    else if (tok <= vgc::kTokWaitShortMax) cc_t_ += tok - vgc::kTokWrite;
+    else if (tok == vgc::kTokWait735) cc_t_ += 735;
+    else if (tok == vgc::kTokWait882) cc_t_ += 882;
+    else if (tok == vgc::kTokWaitVar) {
+      uint32_t v = 0;
+      uint8_t b;
+      bool ok = true;
+      for (uint32_t shift = 0; ok && shift < 35; shift += 7) {
+        if (!(ok = get8_(b))) break;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
       }
+      if (!ok) { compile_finish_(false); break; }
+      cc_t_ += v;
     }
-    else if (cmd == 0x67) {
-      // data block: 0x67 0x66 tt [size u32] [data...]
-      (void)rd8_(); (void)rd8_();
-      uint32_t sz = rd32le_at_(pos_);
-      pos_ += 4;
-      pos_ += sz;
-      if (pos_ > size_) { playing_ = false; }
+    else if (tok == vgc::kTokEnd) {
+      compile_finish_(cc_loop_seen_ && loop_t_ < cc_t_);
     }
     else {
-      // unknown -> stop (必要なら増やす)
+      compile_finish_(false);
+    }
+  }
+
+  return n;
+}
+
+// S98 のダンプ列。wait は sync 単位なので累積 sync 数から毎回サンプル時刻を出す
+uint32_t VGMPlayer::compile_chunk_s98_(VGMEvent* out, uint32_t cap) {
+  uint32_t n = 0;
+
+  while (n < cap && !cc_done_) {
+    if (!cc_loop_seen_ && loop_pos_ != 0 && tell_() >= loop_pos_) {
+      cc_loop_seen_ = true;
+      loop_ev_ = n;
+      loop_t_ = cc_t_;
+    }
+
+    uint8_t cmd;
+    if (!get8_(cmd)) { compile_finish_(false); break; }
+
+    if (cmd < 0x80) {
+      uint8_t aa, dd;
+      if (!get8_(aa) || !get8_(dd)) { compile_finish_(false); break; }
+      const uint32_t dev = cmd >> 1;
+      if (dev >= s98_dev_count_) continue;
+      const uint8_t chip = s98_chip_[dev];
+      if (chip == VGM_CHIP_NONE || !((chip_mask_ >> chip) & 1)) continue;
+      const uint8_t port = cmd & 1;
+      if (port && chip != VGM_CHIP_YM2608) continue;   // 拡張ポートは OPNA だけ
+      if (out) {
+        out[n].t = cc_t_;
+        out[n].reg = aa;
+        out[n].data = dd;
+        out[n].chip = chip;
+        out[n].port = port;
+      }
+      n++;
+      continue;
+    }
+
+    if (cmd == s98::kCmdSync) {
+      cc_ticks_ += 1;
+    } else if (cmd == s98::kCmdSyncN) {
+      uint32_t v = 0;
+      uint8_t b;
+      bool ok = true;
+      for (uint32_t shift = 0; ok && shift < 35; shift += 7) {
+        if (!(ok = get8_(b))) break;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+      }
+      if (!ok) { compile_finish_(false); break; }
+      cc_ticks_ += (uint64_t)v + 2;
+    } else if (cmd == s98::kCmdEnd) {
+      compile_finish_(cc_loop_seen_ && loop_t_ < cc_t_);
+      break;
+    } else {
+      compile_finish_(false);
+      break;
+    }
+    const uint64_t t = cc_ticks_ * s98_mul_ / s98_den_;
+    cc_t_ = t < UINT32_MAX ? (uint32_t)t : UINT32_MAX - 1;
+  }
+
+  return n;
+}
+
+bool VGMPlayer::compile_() {
+  compile_begin_();
+  uint32_t n = compile_chunk_(nullptr, UINT32_MAX);
+
+  ev_ = (VGMEvent*)hot_alloc_(sizeof(VGMEvent) * ((size_t)n + 1));
+  if (!ev_) return false;
+
+  // 2パス目は同じ入力なので n 個ちょうど（+1 は終端まで読み切るため）
+  compile_begin_();
+  ev_count_ = compile_chunk_(ev_, n + 1);
+  ev_[ev_count_].t = UINT32_MAX;
+  ev_[ev_count_].reg = 0;
+  ev_[ev_count_].data = 0;
+  ev_[ev_count_].chip = VGM_CHIP_NONE;
+  return true;
+}
+
+bool VGMPlayer::refill_window_() {
+  if (!src_ || cc_done_) return false;
+  ev_count_ = compile_chunk_(ev_, VGM_STREAM_EVENT_WINDOW);
+  ev_[ev_count_].t = UINT32_MAX;
+  ev_[ev_count_].reg = 0;
+  ev_[ev_count_].data = 0;
+  ev_[ev_count_].chip = VGM_CHIP_NONE;
+  ev_idx_ = 0;
+  return true;
+}
+
+// ===================== seek =====================
+
+// キーフレームは2系統：
+//   [0, kf_count_)          1周目（先頭から）
+//   [kf_count_, +kf_loop_)  2周目以降のループ区間（1周目終端の状態から）
+bool VGMPlayer::build_seek_index_() {
+  const uint32_t interval = VGM_SEEK_KEYFRAME_SEC * OUT_SR;
+  kf_count_ = end_t_ / interval + 1;
+  kf_loop_count_ = loops_ ? (end_t_ - loop_t_) / interval + 1 : 0;
+  kf_ = (VGMKeyframe*)ps_alloc_(sizeof(VGMKeyframe) * (kf_count_ + kf_loop_count_));
+  if (!kf_) {
+    kf_count_ = 0;
+    kf_loop_count_ = 0;
+    return false;
+  }
+
+  OPNRegSnapshot cur;
+  cur.clear();
+  const VGMEvent* e = ev_;
+  for (uint32_t k = 0; k < kf_count_; ++k) {
+    const uint32_t kt = k * interval;
+    while (e->t < kt) {
+      cur.on_write(e->reg, e->data);
+      ++e;
+    }
+    kf_[k].ev_idx = (uint32_t)(e - ev_);
+    kf_[k].in_pos = 0;
+    kf_[k].t = kt;
+    kf_[k].regs = cur;
+  }
+  if (!loops_) return true;
+
+  // 1周目の終端状態（終端時刻ちょうどの書き込みまで含む）から2周目を辿る
+  while (e->t <= end_t_) {
+    cur.on_write(e->reg, e->data);
+    ++e;
+  }
+  e = ev_ + loop_ev_;
+  VGMKeyframe* kl = kf_ + kf_count_;
+  for (uint32_t k = 0; k < kf_loop_count_; ++k) {
+    const uint32_t kt = loop_t_ + k * interval;
+    while (e->t < kt) {
+      cur.on_write(e->reg, e->data);
+      ++e;
+    }
+    kl[k].ev_idx = (uint32_t)(e - ev_);
+    kl[k].in_pos = 0;
+    kl[k].t = kt;
+    kl[k].regs = cur;
+  }
+  return true;
+}
+
+// ストリーミング：イベントを持っていないので、ロード時に1周（ループ曲はもう1回ループ区間）を
+// 1イベントずつ compile し、キーフレーム毎に読み直す位置とその時点の時刻・レジスタを控える。
+// 長さはヘッダの値で確保する（足りなければ最後のキーフレームから長めに辿るだけ）
+bool VGMPlayer::build_stream_seek_index_() {
+  const uint32_t interval = VGM_SEEK_KEYFRAME_SEC * OUT_SR;
+  const uint32_t cap = hdr_end_t_ / interval + 1;
+  const uint32_t cap_loop = loop_pos_ ? (hdr_end_t_ - hdr_loop_t_) / interval + 1 : 0;
+  kf_ = (VGMKeyframe*)ps_alloc_(sizeof(VGMKeyframe) * (cap + cap_loop));
+  if (!kf_) return false;
+
+  OPNRegSnapshot cur;
+  cur.clear();
+  VGMKeyframe* out = kf_;
+  uint32_t out_cap = cap;
+  uint32_t n = 0;
+  uint32_t kt = 0;        // 次のキーフレームの時刻（2周目は通しの時刻）
+  uint32_t fold = 0;      // 2周目の通しの時刻 → ループ区間の時刻
+  compile_begin_();
+  for (;;) {
+    // 次のコマンドの手前。ここから読み直せば同じイベント列になる
+    uint32_t pos = tell_();
+    uint32_t t = cc_t_;
+    const uint32_t passes = cc_passes_;
+    const uint32_t got = compile_chunk_(ev_, 1);
+    if (cc_passes_ != passes) {
+      if (passes > 0) break;   // 2周目の終端
+      // 1周目の終端：ここまでの状態からループ区間をもう1回辿る
+      hdr_end_t_ = cc_pass_end_t_;
+      hdr_loop_t_ = loop_t_;
+      kf_count_ = n;
+      out = kf_ + kf_count_;
+      out_cap = cap_loop;
+      n = 0;
+      kt = cc_pass_end_t_;
+      fold = cc_pass_end_t_ - loop_t_;
+      pos = loop_pos_;
+      t = cc_pass_end_t_;
+    }
+    if (got == 0) {
+      // ループしない曲の終端（か読めなくなった所）
+      if (cc_passes_ == 0) {
+        hdr_end_t_ = cc_t_;
+        hdr_loop_t_ = cc_t_;
+        kf_count_ = n;
+      }
+      break;
+    }
+    const VGMEvent& e = ev_[0];
+    while (kt <= e.t && n < out_cap) {
+      out[n].ev_idx = 0;
+      out[n].in_pos = pos;
+      out[n].t = t - fold;
+      out[n].regs = cur;
+      ++n;
+      kt += interval;
+    }
+    cur.on_write(e.reg, e.data);
+  }
+  if (cc_passes_ > 0) kf_loop_count_ = n;
+  if (kf_count_ == 0) {
+    ps_free_(kf_);
+    kf_ = nullptr;
+    kf_loop_count_ = 0;
+    return false;
+  }
+  return true;
+}
+
+// キーフレームの位置から読み直し、sample より前の書き込みを regs にだけ適用する（窓は sample の所で残る）
+bool VGMPlayer::seek_stream_(const VGMKeyframe& kf, uint32_t sample, OPNRegSnapshot& regs) {
+  if (!seek_input_(kf.in_pos)) return false;
+  cc_t_ = kf.t;
+  cc_done_ = false;
+  end_t_ = UINT32_MAX;
+  loop_t_ = hdr_loop_t_;
+  cc_loop_seen_ = loop_pos_ != 0 && kf.in_pos >= loop_pos_;
+  refill_window_();
+  while (ev_[ev_idx_].t < sample) {
+    regs.on_write(ev_[ev_idx_].reg, ev_[ev_idx_].data);
+    if (++ev_idx_ == ev_count_ && !refill_window_()) break;
+  }
+  return true;
+}
+
+bool VGMPlayer::seek(uint32_t sample) {
+  if (!kf_ || !chips_ || !chips_->opn() || !state_) return false;
+
+  // ストリーミングは end_t_ が決まらないので、読み通した時の1周
+  const uint32_t end_t = src_ ? hdr_end_t_ : end_t_;
+  const uint32_t loop_t = src_ ? hdr_loop_t_ : loop_t_;
+  const uint32_t interval = VGM_SEEK_KEYFRAME_SEC * OUT_SR;
+  const VGMKeyframe* kf = nullptr;
+  if (sample < end_t) {
+    uint32_t k = sample / interval;
+    if (k >= kf_count_) k = kf_count_ - 1;
+    kf = kf_ + k;
+  } else {
+    if (kf_loop_count_ == 0) return false;
+    sample = loop_t + (sample - loop_t) % (end_t - loop_t);
+    uint32_t k = (sample - loop_t) / interval;
+    if (k >= kf_loop_count_) k = kf_loop_count_ - 1;
+    kf = kf_ + kf_count_ + k;
+  }
+
+  // キーフレームから目的位置までは影のレジスタだけ進める
+  OPNRegSnapshot regs = kf->regs;
+  if (src_) {
+    if (!seek_stream_(*kf, sample, regs)) return false;
+  } else {
+    uint32_t idx = kf->ev_idx;
+    while (ev_[idx].t < sample) {
+      regs.on_write(ev_[idx].reg, ev_[idx].data);
+      ++idx;
+    }
+    ev_idx_ = idx;
+  }
+
+  chips_->reset();
+  regs.write_to(*chips_->opn());
+  state_->restore(regs);
+
+  t_ = sample;
+  playing_ = true;
+  return true;
+}
+
+// 現在時刻 t_ までのイベントを適用（終端ならループ/停止）
+bool HOT_FN VGMPlayer::apply_due_() {
+  for (;;) {
+    // 番兵があるので範囲チェック不要
+    const VGMEvent* e = ev_ + ev_idx_;
+    while (e->t <= t_) {
+      if (e->chip == meter_chip_ && e->port == 0) {
+        // YM2608 の 0x28 は ch4-6 (bit2) もあるので OPNState へは ch1-3 だけ
+        if (!(e->chip == VGM_CHIP_YM2608 && e->reg == 0x28 && (e->data & 0x04)))
+          state_->on_write(e->reg, e->data);
+      }
+      chips_->write(e->chip, e->port, e->reg, e->data);
+      ++e;
+    }
+    wr_count_ += (uint32_t)(e - (ev_ + ev_idx_));
+    ev_idx_ = (uint32_t)(e - ev_);
+
+    // ストリーミング：窓を使い切ったら次を compile
+    if (ev_idx_ == ev_count_ && refill_window_()) continue;
+
+    if (t_ < end_t_) return true;
+
+    // end: loop if possible
+    if (!loops_) {
       playing_ = false;
+      return false;
     }
+    t_ = loop_t_;
+    ev_idx_ = loop_ev_;
   }
 }
 
 void VGMPlayer::step_one_sample() {
   if (!playing_) return;
-  if (wait_ == 0) step_until_wait_();
-  if (wait_ > 0) wait_--;
+  if (!apply_due_()) return;
+  t_++;
+}
+
+uint32_t HOT_FN VGMPlayer::step_span(uint32_t max_samples) {
+  if (!playing_ || max_samples == 0) return 0;
+  if (!apply_due_()) return 0;
+
+  // 次のイベントか終端のどちらか近い方まで（どちらも t_ より後）
+  uint32_t next = ev_[ev_idx_].t;
+  if (next > end_t_) next = end_t_;
+  uint32_t span = next - t_;
+  if (span > max_samples) span = max_samples;
+  t_ += span;
+  return span;
+}
+
+uint32_t VGMPlayer::fast_forward(uint32_t samples) {
+  uint32_t done = 0;
+  while (done < samples) {
+    uint32_t k = step_span(samples - done);
+    if (k == 0) break;
+    done += k;
+  }
+  return done;
+}
+
+// 旧方式（1サンプル毎にバイト列をデコード）とコンパイル済み方式の比較。
+// どちらもチップへは書かず、1周ぶんのデコード/ディスパッチだけを測る。
+void VGMPlayer::bench_() const {
+  uint32_t legacy_writes = 0;
+  uint32_t t0 = micros();
+  {
+    uint32_t pos = data_start_;
+    uint32_t wait = 0;
+    bool run = true;
+    for (uint32_t s = 0; s < end_t_ && run; ++s) {
+      while (run && wait == 0 && pos < size_) {
+        uint8_t cmd = data_[pos++];
+        if (cmd == 0x55) { pos += 2; legacy_writes++; }
+        else if (cmd == 0x61) {
+          wait = (pos + 2 <= size_) ? ((uint32_t)data_[pos] | ((uint32_t)data_[pos + 1] << 8)) : 0;
+          pos += 2;
+        }
+        else if (cmd == 0x62) wait = 735;
+        else if (cmd == 0x63) wait = 882;
+        else if ((cmd & 0xF0) == 0x70) wait = (cmd & 0x0F) + 1;
+        else if (cmd == 0x67) pos += 6 + rd32le_at_(pos + 2);
+        else run = false;
+      }
+      if (wait > 0) wait--;
+    }
+  }
+  uint32_t legacy_us = micros() - t0;
+
+  volatile uint32_t sink = 0;
+  uint32_t compiled_writes = 0;
+  t0 = micros();
+  {
+    const VGMEvent* e = ev_;
+    for (uint32_t s = 0; s < end_t_; ++s) {
+      while (e->t <= s) {
+        sink = sink + e->reg + e->data;
+        ++e;
+      }
+    }
+    compiled_writes = (uint32_t)(e - ev_);
+  }
+  uint32_t compiled_us = micros() - t0;
+  (void)sink;
+
+  auto per_sec = [](uint32_t n, uint32_t us) -> uint32_t {
+    return us ? (uint32_t)(((uint64_t)n * 1000000ULL) / us) : 0;
+  };
+  Serial.printf("[vgm bench] samples=%u legacy: %u ev in %u us (%u ev/s), compiled: %u ev in %u us (%u ev/s)\n",
+                (unsigned)end_t_,
+                (unsigned)legacy_writes, (unsigned)legacy_us, (unsigned)per_sec(legacy_writes, legacy_us),
+                (unsigned)compiled_writes, (unsigned)compiled_us, (unsigned)per_sec(compiled_writes, compiled_us));
 }
@@ -1,39 +1,171 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include "../opn/opn_snapshot.hpp"
+#include "vgm_format.hpp"
 
-class YM2203Wrap;
+class VGMChipSet;
 class OPNState;
+class VGMBlob;
+
+// ロード時にコンパイルしたレジスタ書き込み（waitは絶対時刻に畳み込み済み）
+struct VGMEvent {
+  uint32_t t;       // OUT_SR基準の絶対サンプル時刻
+  uint8_t  reg;
+  uint8_t  data;
+  uint8_t  chip;    // VGMChipId
+  uint8_t  port;    // YM2608 の port 0/1
+};
+
+// シーク用キーフレーム：その時刻より前のイベントを全て適用した後のレジスタ
+struct VGMKeyframe {
+  uint32_t ev_idx;      // この時刻以降で最初のイベント（全体ロード）
+  uint32_t in_pos;      // ここから読み直す（ストリーミング。コマンドの区切り）
+  uint32_t t;           // in_pos の時点の時刻（ストリーミング。キーフレームの時刻以下）
+  OPNRegSnapshot regs;
+};
 
 class VGMPlayer {
 public:
-  bool load(const uint8_t* data, size_t size, YM2203Wrap& chip, OPNState& state);
+  ~VGMPlayer();
+
+  // chips はヘッダから setup 済みのもの。state へは OPN 系1台ぶんの書き込みを流す
+  bool load(const uint8_t* data, size_t size, VGMChipSet& chips, OPNState& state);
+  // ストリーミング中の blob から読む。イベントは固定長の窓に少しずつコンパイルする
+  bool load_stream(VGMBlob& src, VGMChipSet& chips, OPNState& state);
+  void clear();
 
   bool playing() const { return playing_; }
-  uint32_t position() const { return pos_; }
+  uint32_t position() const { return t_; }   // OUT_SR サンプル位置
   uint32_t writes() const { return wr_count_; }
+  uint32_t event_count() const { return ev_count_; }
 
   // OUT_SR 1サンプル進める（waitを含む）
   void step_one_sample();
 
+  // 現在時刻のイベントを適用し、次のイベントまで（最大 max_samples）進める。
+  // 戻り値は進めたサンプル数。その区間はレジスタ書き込み無しでまとめて生成してよい。
+  // 停止中は 0。
+  uint32_t step_span(uint32_t max_samples);
+
+  // 早送り：PCM を作らずにレジスタ書き込みだけ samples 分進める（チップは書き込みのみで、
+  // EG などの内部状態は進まない。呼ぶ側が着地点の手前を step_span + VGMChipSet::clock_only で回す）
+  uint32_t fast_forward(uint32_t samples);
+
+  // 一周の長さ（OUT_SR サンプル）。ストリーミングで未確定の間はヘッダ（0x18）の値（無ければ 0）
+  uint32_t length() const { return end_t_ == UINT32_MAX ? hdr_end_t_ : end_t_; }
+  // ループ区間の長さ（ループ無しなら 0）。未確定の間はヘッダ（0x20）の値
+  uint32_t loop_length() const {
+    if (end_t_ == UINT32_MAX) return hdr_end_t_ - hdr_loop_t_;
+    return loops_ ? end_t_ - loop_t_ : 0;
+  }
+
+  // キーフレーム（VGM_SEEK_KEYFRAME_SEC 毎）から復元して指定時刻へ飛ぶ。YM2203 単体曲のみ
+  // （ストリーミングはロード時に1回読み通して作る）。ループ曲は一周を超えた位置もループ区間に折り返す。
+  // 戻すのはレジスタだけで ymfm の内部状態（EG・位相）は持たないので、呼ぶ側が手前から飛んで
+  // VGM_SEEK_SETTLE_MS ぶんチップを回す
+  bool seekable() const { return kf_ != nullptr; }
+  bool seek(uint32_t sample);
+
 private:
   const uint8_t* data_ = nullptr;
   size_t size_ = 0;
 
-  YM2203Wrap* chip_ = nullptr;
+  VGMChipSet* chips_ = nullptr;
   OPNState* state_ = nullptr;
+  uint32_t chip_mask_ = 0;       // 鳴らせるチップ（それ以外への書き込みはコンパイル時に捨てる）
+  uint8_t meter_chip_ = 0xFF;    // state_ へ流すチップ
 
-  uint32_t pos_ = 0;
   uint32_t data_start_ = 0;
   uint32_t loop_pos_ = 0;
-  uint32_t wait_ = 0;
+
+  VGMFormat format_ = VGMFormat::VGM;
+
+  // .vgc（事前変換済み）
+  const uint8_t* pairs_ = nullptr;   // (target, reg) の表
+  uint32_t pair_count_ = 0;
+
+  // .s98：device 番号 → チップ、sync 数 → サンプルは cc_ticks_ * mul / den
+  uint8_t s98_chip_[s98::kMaxDevices]{};
+  uint32_t s98_dev_count_ = 0;
+  uint64_t s98_mul_ = 0;
+  uint64_t s98_den_ = 1;
+
   bool playing_ = false;
 
+  // compiled stream (末尾に t=UINT32_MAX の番兵を置く)
+  // ストリーミング時は ev_ が窓になり、使い切ったら次を compile する
+  VGMEvent* ev_ = nullptr;
+  uint32_t ev_count_ = 0;
+  uint32_t ev_idx_ = 0;
+  uint32_t t_ = 0;
+  uint32_t end_t_ = 0;
+  uint32_t loop_ev_ = 0;
+  uint32_t loop_t_ = 0;
+  bool loops_ = false;
+  // ストリーミングで end_t_ / loop_t_ が確定するまでの表示用（ヘッダの total / loop samples から。
+  // シーク用に読み通した曲は、その時の1周の終端とループ点）
+  uint32_t hdr_end_t_ = 0;
+  uint32_t hdr_loop_t_ = 0;
+
   uint32_t wr_count_ = 0;
 
-  uint8_t  rd8_();
+  VGMKeyframe* kf_ = nullptr;
+  uint32_t kf_count_ = 0;
+  uint32_t kf_loop_count_ = 0;
+
+  // compiler input cursor（メモリ全体 or blob から詰め直すバッファ）
+  VGMBlob* src_ = nullptr;
+  const uint8_t* in_ = nullptr;
+  uint32_t in_base_ = 0;     // in_[0] のファイル上の位置
+  uint32_t in_pos_ = 0;
+  uint32_t in_len_ = 0;
+  uint8_t in_buf_[512]{};
+  bool loop_marked_ = false;   // ループ点の手前で src_->stream_mark 済み
+
+  // compiler state
+  uint32_t cc_t_ = 0;
+  bool cc_loop_seen_ = false;
+  bool cc_done_ = false;
+  uint32_t cc_block_end_ = 0;   // 登録済み data block の末尾（ストリーミングのループで二重登録しない）
+  uint64_t cc_ticks_ = 0;       // S98 の累積 sync 数（丸め誤差を溜めない）
+  uint32_t cc_passes_ = 0;      // ストリーミングで 0x66 に着いてループ点へ戻った回数
+  uint32_t cc_pass_end_t_ = 0;  // その直近の 0x66 の時刻
+
+  bool parse_header_(const uint8_t* hdr, size_t total);
+  bool parse_vgc_header_();
+  bool parse_s98_header_();
+  void bind_(VGMChipSet& chips, OPNState& state);
   uint32_t rd32le_at_(uint32_t off) const;
-  void step_until_wait_();
+
+  bool fill_input_();
+  bool get8_(uint8_t& b) {
+    if (in_pos_ >= in_len_ && !fill_input_()) return false;
+    b = in_[in_pos_++];
+    return true;
+  }
+  uint32_t tell_() const { return in_base_ + in_pos_; }
+  bool skip_(uint32_t n);
+  bool read_(uint8_t* dst, uint32_t n);
+  bool take_data_block_(uint8_t type, uint32_t size);
+  bool seek_input_(uint32_t pos);
+
+  void compile_begin_();
+  uint32_t compile_chunk_(VGMEvent* out, uint32_t cap);   // out==nullptr なら数えるだけ
+  uint32_t compile_chunk_vgc_(VGMEvent* out, uint32_t cap);
+  uint32_t compile_chunk_s98_(VGMEvent* out, uint32_t cap);
+  void compile_finish_(bool ended);
+  bool compile_();
+  bool refill_window_();
+  bool build_seek_index_();
+  bool build_stream_seek_index_();
+  bool seek_stream_(const VGMKeyframe& kf, uint32_t sample, OPNRegSnapshot& regs);
+  bool apply_due_();
+  void bench_() const;
 
   void reset_to_data_();
+
+  static void* ps_alloc_(size_t n);
+  static void* hot_alloc_(size_t n);
+  static void ps_free_(void* p);
 };
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include "ym2203_wrap.hpp"
+#include "ymfm_ssg.h"
+
+// AY-3-8910 / YM2149 (PSG 単体)
+class YM2149Wrap {
+public:
+  static constexpr uint32_t kOutputs = ymfm::ym2149::OUTPUTS;
+
+  explicit YM2149Wrap(uint32_t clock_hz)
+  : clock(clock_hz), chip(intf)
+  {
+    chip.reset();
+    native_sr = chip.sample_rate(clock);
+  }
+
+  uint32_t sample_rate_native() const { return native_sr; }
+
+  // 曲の切り替え：作り直さずにクロックを変えて初期状態へ
+  void configure(uint32_t clock_hz) {
+    clock = clock_hz;
+    native_sr = chip.sample_rate(clock);
+    mute = 0;
+    reset();
+  }
+
+  void reset() {
+    chip.reset();
+    for (auto& v : vol) v = 0;
+  }
+
+  // bit3-5: A-C（YM2203Wrap::set_mute_mask の SSG と同じ位置）。音量を 0 にするだけで chip は回し続ける
+  void set_mute_mask(uint8_t m) {
+    m &= 0x38;
+    const uint8_t changed = m ^ mute;
+    mute = m;
+    for (uint8_t i = 0; i < 3; ++i) {
+      if (changed & (0x08u << i)) write_reg(0x08 + i, vol[i]);
+    }
+  }
+
+  void write_reg(uint8_t reg, uint8_t data) {
+    if (reg >= 0x08 && reg <= 0x0A) {
+      vol[reg - 0x08] = data;
+      if (mute & (0x08u << (reg - 0x08))) data = 0;
+    }
+    chip.write_address(reg);
+    chip.write_data(data);
+  }
+
+  void render_block_mono_i16(int16_t* dst, uint32_t n) {
+    while (n > 0) {
+      uint32_t k = n < kBlockSamples ? n : kBlockSamples;
+      chip.generate(block_out, k);
+      for (uint32_t j = 0; j < k; ++j) {
+        int32_t sum = 0;
+        for (uint32_t i = 0; i < kOutputs; ++i) sum += block_out[j].data[i];
+        sum /= (int32_t)kOutputs;
+        if (sum < -32768) sum = -32768;
+        if (sum >  32767) sum =  32767;
+        dst[j] = (int16_t)sum;
+      }
+      dst += k;
+      n -= k;
+    }
+  }
+
+  static constexpr uint32_t kBlockSamples = 256;
+
+private:
+  uint32_t clock;
+  uint32_t native_sr{};
+  MyYmfmIntf intf;
+  ymfm::ym2149 chip;
+  uint8_t vol[3]{};              // 書かれた値（ミュート中もこちらは保持）
+  uint8_t mute = 0;
+  ymfm::ym2149::output_data block_out[kBlockSamples]{};
+};
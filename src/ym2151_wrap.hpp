@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include "ym2203_wrap.hpp"
+#include "ymfm_opm.h"
+#include "common/fm_envelope.hpp"
+#include "common/hot_path.hpp"
+#include "dsp/resampler.hpp"
+
+// FM エンジン（protected）の EG を見るための薄い派生
+class YM2151Core : public ymfm::ym2151 {
+public:
+  using ymfm::ym2151::ym2151;
+  const fm_engine& fm() const { return m_fm; }
+};
+
+// YM2151 (OPM)。MDX で X68Sound の OPM の代わりに使う。
+// native rate (clock/64 ≒ 62.5kHz) でまとめて生成し、Resampler で出力レートへ落として加算する
+// （22.05kHz 等への間引きは Resampler の前段ハーフバンドが帯域制限する）
+class YM2151Wrap {
+public:
+  static constexpr uint32_t kBlockSamples = 256;
+
+  YM2151Wrap(uint32_t clock_hz, uint32_t out_sr, Resampler::Tier tier = Resampler::kFast)
+  : chip(intf)
+  {
+    chip.reset();
+    native_sr = chip.sample_rate(clock_hz);
+    rs.configure(native_sr, out_sr, tier);
+    set_span_();
+  }
+
+  uint32_t sample_rate_native() const { return native_sr; }
+
+  // 再生中に変えてよい（履歴と位置はそのまま）
+  void set_tier(Resampler::Tier tier) {
+    rs.set_tier(tier);
+    set_span_();
+  }
+  Resampler::Tier tier() const { return rs.tier(); }
+
+  void reset() {
+    chip.reset();
+    rs.reset();
+  }
+
+  void write_reg(uint8_t reg, uint8_t data) {
+    chip.write_address(reg);
+    chip.write_data(data);
+  }
+
+  // FM 8ch の EG 減衰を読む（メータ用）
+  FmEnvelopeProbe envelope_probe() const {
+    return { this, [](const void* p, uint16_t* att, uint32_t channels) {
+      fm_read_eg_attenuation(static_cast<const YM2151Wrap*>(p)->chip.fm(), att, channels < 8 ? channels : 8);
+    } };
+  }
+
+  // 出力レートで n サンプル、mono (L+R)/2 を Resampler に通して gain_q15 を掛け、acc へ加算
+  void HOT_FN render_add(int32_t* acc, uint32_t n, int32_t gain_q15) {
+    while (n > 0) {
+      const uint32_t kk = n < span_max_out ? n : span_max_out;
+      const uint32_t need = rs.input_for(kk);
+      if (need > 0) {
+        chip.generate(block_out, need);
+        for (uint32_t i = 0; i < need; ++i) mono_in[i] = mono_(block_out[i]);
+      }
+      rs.process(mono_in, mono_out, kk);
+      for (uint32_t i = 0; i < kk; ++i) acc[i] += ((int32_t)mono_out[i] * gain_q15) >> 15;
+      acc += kk;
+      n -= kk;
+    }
+  }
+
+private:
+  // ymfm の OPM は L/R とも 16bit にクリップ済み
+  static int16_t mono_(const ymfm::ym2151::output_data& o) { return (int16_t)((o.data[0] + o.data[1]) >> 1); }
+
+  // 1回に出す数：入力が kBlockSamples に、出力が作業バッファに収まる長さ
+  void set_span_() {
+    const uint32_t k = rs.output_for(kBlockSamples);
+    span_max_out = k < kBlockSamples ? k : kBlockSamples;
+  }
+
+  uint32_t native_sr{};
+  uint32_t span_max_out = 1;
+  Resampler rs;
+  MyYmfmIntf intf;
+  YM2151Core chip;
+  ymfm::ym2151::output_data block_out[kBlockSamples]{};
+  int16_t mono_in[kBlockSamples]{};
+  int16_t mono_out[kBlockSamples]{};
+};
@@ -2,9 +2,55 @@
 #include <cstdint>
 #include "ymfm.h"
 #include "ymfm_opn.h"
+#include "psg/ssg_blep.hpp"
+#include "common/level_tap.hpp"
+#include "common/fm_envelope.hpp"
+#include "common/hot_path.hpp"
 
 struct MyYmfmIntf : public ymfm::ymfm_interface {};
 
+// FM エンジン（protected）のエンベロープ状態を見る・ch を絞って鳴らすための薄い派生
+class YM2203Core : public ymfm::ym2203 {
+public:
+  using ymfm::ym2203::ym2203;
+  const fm_engine& fm() const { return m_fm; }
+
+  // generate() の FM 出力を fm_mask の ch だけにしたもの。clock は generate() と同じく全 ch
+  // （ミュート中の ch も EG / 位相が進み、key-off 後の release もそのまま減衰しきる）。
+  // 間引きの位相も generate() と同じく SSG リサンプラの sampindex から取る。
+  // ssg が false なら SSG を回さず（出力 0）、その分は ssg_skipped_ に足して位相を続ける
+  void generate_masked(output_data* out, uint32_t n, uint32_t fm_mask, bool ssg) {
+    const uint32_t per = m_fm_samples_per_output;
+    const uint32_t base = m_ssg_resampler.sampindex() + ssg_skipped_;
+    for (uint32_t i = 0; i < n; ++i) {
+      const uint32_t step = (base + i) % (per ? per : 3);
+      if (step == 0) clock_fm_masked_(fm_mask);
+      out[i].data[0] = m_last_fm.data[0];
+      if (!per && step == 1) {   // 0 は 1.5 倍（2出力に3回）
+        clock_fm_masked_(fm_mask);
+        out[i].data[0] = (out[i].data[0] + m_last_fm.data[0]) / 2;
+      }
+    }
+    if (ssg) {
+      m_ssg_resampler.resample(out, n);
+    } else {
+      ssg_skipped_ += n;
+      for (uint32_t i = 0; i < n; ++i)
+        for (uint32_t j = FM_OUTPUTS; j < OUTPUTS; ++j) out[i].data[j] = 0;
+    }
+  }
+
+private:
+  // clock_fm() の出力だけ ch マスク版（YM2203 は 14bit でクリップ無し、DAC の 10.3 浮動小数を往復）
+  void clock_fm_masked_(uint32_t fm_mask) {
+    m_fm.clock(fm_engine::ALL_CHANNELS);
+    m_fm.output(m_last_fm.clear(), 0, 32767, fm_mask);
+    m_last_fm.roundtrip_fp();
+  }
+
+  uint32_t ssg_skipped_ = 0;
+};
+
 class YM2203Wrap {
 public:
   static constexpr uint32_t kOutputs    = ymfm::ym2203::OUTPUTS;
@@ -21,28 +67,221 @@ public:
 
   uint32_t sample_rate_native() const { return native_sr; }
 
+  // 曲の切り替え：作り直さずにクロックを変えて初期状態へ（SSG の外部合成・ミュートも外す）
+  void configure(uint32_t clock_hz, ymfm::opn_fidelity fidelity = ymfm::OPN_FIDELITY_MIN) {
+    clock = clock_hz;
+    ext_ssg = nullptr;
+    mute = 0;
+    tap_on = false;
+    idle_count = 0;
+    set_fidelity(fidelity);
+    reset();
+  }
+
+  // 再生中に変えてよい（native rate が変わるので呼び出し側でリサンプラを合わせること）
+  void set_fidelity(ymfm::opn_fidelity fidelity) {
+    chip.set_fidelity(fidelity);
+    native_sr = chip.sample_rate(clock);
+  }
+
+  void reset() {
+    chip.reset();
+    last_out = {};
+    for (auto& v : ssg_vol) v = 0;
+    csm = false;
+    idle = false;
+    for (auto& t : taps) t.clear();
+  }
+
+  // SSG 部（0x00-0x0F）を外部の合成器へ回す。ymfm 側の SSG は音量 0 のまま
+  void attach_ssg(SSGBlep* s) { ext_ssg = s; }
+  bool ssg_external() const { return ext_ssg != nullptr; }
+
+  // 各出力（FM, SSG A/B/C）の peak / RMS を render_block で溜める（メータ用）
+  void enable_taps(bool on) { tap_on = on; }
+  LevelTap* output_taps() { return taps; }
+
+  // FM 3ch の EG 減衰を読む（メータ用。読み出し側が呼ぶ時だけ触る）
+  FmEnvelopeProbe envelope_probe() const {
+    return { this, [](const void* p, uint16_t* att, uint32_t channels) {
+      fm_read_eg_attenuation(static_cast<const YM2203Wrap*>(p)->chip.fm(), att, channels < 3 ? channels : 3);
+    } };
+  }
+
   void write_reg(uint8_t reg, uint8_t data) {
-    chip.write_address(reg);
-    chip.write_data(data);
+    // 無音からの復帰は音が出うる書き込み（key-on / SSG 音量）の時点で即。
+    // ミュート中の ch は key-on / 音量をチップへ渡す手前で落とす
+    if (reg == 0x28) {
+      const uint8_t ch = data & 0x03;
+      if (ch < 3 && (mute & (1u << ch))) data &= 0x0F;
+      if (data & 0xF0) idle = false;
+    } else if (reg == 0x27) {
+      // CSM（bit7:6 = 10）でタイマ A が動いていれば、タイマの満了が ch3 を key-on する。
+      // 無音の間は generate（＝タイマ）を止めるので、この間は無音扱いにしない
+      csm = (data & 0xC1) == 0x81;
+      if (csm) idle = false;
+    } else {
+      data = gate_ssg(reg, data);
+    }
+    write_chip_(reg, data);
+  }
+
+  // SSG 音量（0x08-0x0A）を覚えてミュート中の ch は 0 にする。それ以外の reg はそのまま。
+  // attach_ssg した時に 0x00-0x0F を外部へ直接送る側も、送る前にこれを通す
+  uint8_t gate_ssg(uint8_t reg, uint8_t data) {
+    if (reg < 0x08 || reg > 0x0A) return data;
+    const uint8_t i = reg - 0x08;
+    ssg_vol[i] = data & 0x1F;   // bit4 = エンベロープモード
+    if (mute & (0x08u << i)) return 0;
+    if ((data & 0x1F) && !ext_ssg) idle = false;
+    return data;
   }
 
+  // bit0-2: FM1-3 / bit3-5: SSG A-C。ミュートした ch は鳴らさない：
+  // FM は key-off した上で ch マスクで output から外す（clock は続け、release で減衰しきる）。
+  // SSG は音量 0（ymfm の SSG は回し続ける。外部合成なら回さない）。
+  // 全 ch なら減衰しきった所で無音判定により generate ごと止まる
+  void set_mute_mask(uint8_t m) {
+    m &= 0x3F;
+    const uint8_t changed = m ^ mute;
+    mute = m;
+    for (uint8_t ch = 0; ch < 3; ++ch) {
+      if ((changed & mute) & (1u << ch)) write_chip_(0x28, ch);
+    }
+    for (uint8_t i = 0; i < 3; ++i) {
+      if (!(changed & (0x08u << i))) continue;
+      const bool muted = (mute & (0x08u << i)) != 0;
+      write_chip_(0x08 + i, muted ? 0 : ssg_vol[i]);
+      if (!muted && ssg_vol[i] && !ext_ssg) idle = false;
+    }
+  }
+  uint8_t mute_mask() const { return mute; }
+
+  // FM 全オペレータが release で減衰しきり、SSG 3ch の音量が 0、CSM のタイマ A が止まっている。
+  // この間は generate を呼ばずに 0 を出す（判定は render_block の kBlockSamples 毎）
+  bool is_idle() const { return idle; }
+  uint32_t idle_samples() const { return idle_count; }
+
   // 1サンプル生成：monoを返しつつ、last_outに各出力(FM/SSG)を保持
   int16_t render_one_mono_i16_and_outputs() {
-    chip.generate(&last_out, 1);
-    int32_t sum = 0;
-    for (uint32_t i = 0; i < kOutputs; ++i) sum += last_out.data[i];
-    sum /= (int32_t)kOutputs;
-    if (sum < -32768) sum = -32768;
-    if (sum >  32767) sum =  32767;
-    return (int16_t)sum;
+    generate_(&last_out, 1);
+    return mix_mono_(last_out);
   }
 
+  // n サンプル（native rate）をまとめて生成。ymfm::generate は kBlockSamples 毎に1回。
+  // fm / ssg[0..2] を渡すと各出力の生値も planar で書く（どれも nullptr 可）。
+  // last_out は最後のサンプル
+  void HOT_FN render_block(int16_t* mono, uint32_t n,
+                    int16_t* fm = nullptr, int16_t* const* ssg = nullptr) {
+    for (uint32_t done = 0; done < n; ) {
+      const uint32_t k = (n - done) < kBlockSamples ? (n - done) : kBlockSamples;
+      if (idle || (idle = check_idle_())) {
+        fill_silence_(mono, fm, ssg, done, k);
+        if (tap_on) for (auto& t : taps) t.add_silence(k);
+        idle_count += k;
+        done += k;
+        continue;
+      }
+      generate_(block_out, k);
+      if (tap_on) {
+        for (uint32_t j = 0; j < k; ++j) {
+          for (uint32_t i = 0; i < kOutputs; ++i) taps[i].add(block_out[j].data[i]);
+        }
+      }
+      if (mono) {
+        int16_t* d = mono + done;
+        for (uint32_t j = 0; j < k; ++j) d[j] = mix_mono_(block_out[j]);
+      }
+      if (fm) {
+        int16_t* d = fm + done;
+        for (uint32_t j = 0; j < k; ++j) d[j] = (int16_t)block_out[j].data[0];
+      }
+      if (ssg) {
+        for (uint32_t i = 0; i < kSsgOutputs; ++i) {
+          if (!ssg[i]) continue;
+          int16_t* d = ssg[i] + done;
+          for (uint32_t j = 0; j < k; ++j) d[j] = (int16_t)block_out[j].data[kFmOutputs + i];
+        }
+      }
+      last_out = block_out[k - 1];
+      done += k;
+    }
+    if (tap_on) for (auto& t : taps) t.publish_if(kBlockSamples);
+  }
+
+  void render_block_mono_i16(int16_t* dst, uint32_t n) { render_block(dst, n); }
+
   const ymfm::ym2203::output_data& last_outputs() const { return last_out; }
 
+  static constexpr uint32_t kBlockSamples = 256;
+
 private:
+  // これ以上の減衰（10bit, 0x3FF が最大）は 16bit 出力で 1LSB 未満
+  static constexpr uint32_t kIdleAttenuation = 0x3F0;
+
+  void write_chip_(uint8_t reg, uint8_t data) {
+    if (ext_ssg && reg < 0x10) {
+      ext_ssg->write(reg, data);
+      return;
+    }
+    chip.write_address(reg);
+    chip.write_data(data);
+  }
+
+  // FM のミュートも外部 SSG も無ければ ymfm そのまま
+  void generate_(ymfm::ym2203::output_data* out, uint32_t n) {
+    const uint32_t fm_mask = ~mute & 0x07u;
+    const bool ssg = !ext_ssg;
+    if (fm_mask == 0x07u && ssg) chip.generate(out, n);
+    else chip.generate_masked(out, n, fm_mask, ssg);
+  }
+
+  bool check_idle_() const {
+    if (csm) return false;
+    for (uint32_t i = 0; i < 3 && !ext_ssg; ++i) {   // 外部 SSG は FM の生成と無関係
+      if (ssg_vol[i] && !(mute & (0x08u << i))) return false;
+    }
+    const auto& fm = chip.fm();
+    for (uint32_t ch = 0; ch < 3; ++ch) {
+      const auto* c = fm.debug_channel(ch);
+      for (uint32_t op = 0; op < 4; ++op) {
+        const auto* o = c->debug_operator(op);
+        if (o->debug_eg_state() != ymfm::EG_RELEASE || o->debug_eg_attenuation() < kIdleAttenuation)
+          return false;
+      }
+    }
+    return true;
+  }
+
+  void fill_silence_(int16_t* mono, int16_t* fm, int16_t* const* ssg, uint32_t at, uint32_t k) {
+    if (mono) for (uint32_t j = 0; j < k; ++j) mono[at + j] = 0;
+    if (fm) for (uint32_t j = 0; j < k; ++j) fm[at + j] = 0;
+    if (ssg) {
+      for (uint32_t i = 0; i < kSsgOutputs; ++i) {
+        if (ssg[i]) for (uint32_t j = 0; j < k; ++j) ssg[i][at + j] = 0;
+      }
+    }
+    last_out = {};
+  }
+
+  // FM 1 + SSG 3 の平均。各出力は ymfm 側で int16 に収まっているので割り算もクランプも不要
+  static_assert(kOutputs == 4, "mono mix assumes 4 outputs");
+  static int16_t mix_mono_(const ymfm::ym2203::output_data& o) {
+    return (int16_t)((o.data[0] + o.data[1] + o.data[2] + o.data[3]) >> 2);
+  }
+
   uint32_t clock;
   uint32_t native_sr{};
   MyYmfmIntf intf;
-  ymfm::ym2203 chip;
+  YM2203Core chip;
+  SSGBlep* ext_ssg = nullptr;
+  uint8_t ssg_vol[3]{};          // 書かれた値（ミュート中もこちらは保持）
+  uint8_t mute = 0;
+  bool csm = false;              // 0x27 が CSM モードでタイマ A 動作中
+  bool idle = false;
+  uint32_t idle_count = 0;
+  bool tap_on = false;
+  LevelTap taps[kOutputs];
   ymfm::ym2203::output_data last_out{};
+  ymfm::ym2203::output_data block_out[kBlockSamples]{};
 };
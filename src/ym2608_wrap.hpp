@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdint>
+#include "ym2203_wrap.hpp"
+
+// ADPCM-B のサンプルメモリ。VGM の data block をコピーせずに指す（blob の PSRAM 上）
+struct YM2608Intf : public ymfm::ymfm_interface {
+  struct RomBlock {
+    uint32_t start;
+    uint32_t size;
+    const uint8_t* data;
+  };
+  static constexpr uint32_t kMaxBlocks = 32;
+
+  RomBlock blocks[kMaxBlocks]{};
+  uint32_t count = 0;
+  uint32_t last = 0;   // 直前に当たったブロック（連続再生ではほぼこれ）
+
+  uint8_t ymfm_external_read(ymfm::access_class type, uint32_t address) override {
+    if (type != ymfm::ACCESS_ADPCM_B || count == 0) return 0;
+    const RomBlock& b = blocks[last];
+    if (address - b.start < b.size) return b.data[address - b.start];
+    for (uint32_t i = 0; i < count; ++i) {
+      if (address - blocks[i].start < blocks[i].size) {
+        last = i;
+        return blocks[i].data[address - blocks[i].start];
+      }
+    }
+    return 0;
+  }
+};
+
+// YM2608 (OPNA)。port 0/1 のレジスタを持つ。リズム(ADPCM-A)ROM は無いので鳴らない
+class YM2608Wrap {
+public:
+  static constexpr uint32_t kOutputs = ymfm::ym2608::OUTPUTS;   // FM L, FM R, SSG
+
+  explicit YM2608Wrap(uint32_t clock_hz, ymfm::opn_fidelity fidelity = ymfm::OPN_FIDELITY_MIN)
+  : clock(clock_hz), chip(intf)
+  {
+    chip.set_fidelity(fidelity);
+    chip.reset();
+    native_sr = chip.sample_rate(clock);
+  }
+
+  uint32_t sample_rate_native() const { return native_sr; }
+
+  // 曲の切り替え：作り直さずにクロックを変えて初期状態へ（ADPCM-B の登録も外す）
+  void configure(uint32_t clock_hz, ymfm::opn_fidelity fidelity = ymfm::OPN_FIDELITY_MIN) {
+    clock = clock_hz;
+    intf.count = 0;
+    intf.last = 0;
+    mute = 0;
+    set_fidelity(fidelity);
+    reset();
+  }
+
+  void set_fidelity(ymfm::opn_fidelity fidelity) {
+    chip.set_fidelity(fidelity);
+    native_sr = chip.sample_rate(clock);
+  }
+
+  void reset() {
+    chip.reset();
+    for (auto& v : ssg_vol) v = 0;
+  }
+
+  // ADPCM-B ROM/RAM の start から size バイトを data で見せる（data は再生中ずっと有効なこと）
+  bool add_adpcm_b(uint32_t start, const uint8_t* data, uint32_t size) {
+    if (intf.count >= YM2608Intf::kMaxBlocks || size == 0) return false;
+    intf.blocks[intf.count++] = { start, size, data };
+    return true;
+  }
+
+  // YM2203Wrap::set_mute_mask と同じ並び（bit0-2: FM1-3 / bit3-5: SSG A-C。FM4-6 と ADPCM はそのまま）。
+  // FM は key-off して key-on を落とし、SSG は音量 0。chip は全部回し続ける
+  void set_mute_mask(uint8_t m) {
+    m &= 0x3F;
+    const uint8_t changed = m ^ mute;
+    mute = m;
+    for (uint8_t ch = 0; ch < 3; ++ch) {
+      if ((changed & mute) & (1u << ch)) write_reg(0, 0x28, ch);
+    }
+    for (uint8_t i = 0; i < 3; ++i) {
+      if (changed & (0x08u << i)) write_reg(0, 0x08 + i, ssg_vol[i]);
+    }
+  }
+
+  void write_reg(uint8_t port, uint8_t reg, uint8_t data) {
+    if (port == 0) {
+      if (reg == 0x28) {
+        const uint8_t ch = data & 0x07;
+        if (ch < 3 && (mute & (1u << ch))) data &= 0x0F;
+      } else if (reg >= 0x08 && reg <= 0x0A) {
+        ssg_vol[reg - 0x08] = data;
+        if (mute & (0x08u << (reg - 0x08))) data = 0;
+      }
+      chip.write_address(reg);
+      chip.write_data(data);
+    } else {
+      chip.write_address_hi(reg);
+      chip.write_data_hi(data);
+    }
+  }
+
+  // YM2203Wrap と同じバランス（FM 1 : SSG 3ch 合計 1）になるよう ((L+R)/2 + SSG) / 4
+  void render_block_mono_i16(int16_t* dst, uint32_t n) {
+    while (n > 0) {
+      uint32_t k = n < kBlockSamples ? n : kBlockSamples;
+      chip.generate(block_out, k);
+      for (uint32_t j = 0; j < k; ++j) {
+        const int32_t* o = block_out[j].data;
+        int32_t sum = (((o[0] + o[1]) >> 1) + o[2]) >> 2;
+        if (sum < -32768) sum = -32768;
+        if (sum >  32767) sum =  32767;
+        dst[j] = (int16_t)sum;
+      }
+      dst += k;
+      n -= k;
+    }
+  }
+
+  static constexpr uint32_t kBlockSamples = 256;
+
+private:
+  uint32_t clock;
+  uint32_t native_sr{};
+  YM2608Intf intf;
+  ymfm::ym2608 chip;
+  uint8_t ssg_vol[3]{};          // 書かれた値（ミュート中もこちらは保持）
+  uint8_t mute = 0;
+  ymfm::ym2608::output_data block_out[kBlockSamples]{};
+};
@@ -0,0 +1,228 @@
+// 実際の曲ファイルで早送り（と通常の生成）が実時間の何倍で回るかを曲毎に出す（実機の
+// FF_BENCH_ON_LOAD のホスト版）。ymfm の実物が要るので CMakeLists.txt が .pio/libdeps に見つけた時だけ
+// ビルドされる。MDX は portable_mdx もある時だけ（BENCH_WITH_MDX）
+//   bench_fast_forward <file> [file...]     .vgm / .vgz（stored のみ。圧縮済みは gunzip してから）/ .vgc / .s98 / .mdx
+// VGM の早送りは main.cpp の fast_forward_ms と同じ手順（書き込みだけ → FF_CLOCK_MS はチップを回す →
+// FF_SETTLE_MS は生成して捨てる）を、ボタンを押し続けた時の1回分（FF_RATE * FF_REPEAT_MS）ずつ繰り返す
+#include "app_config.hpp"
+#include "vgm/vgm_blob.hpp"
+#include "vgm/vgm_chips.hpp"
+#include "vgm/vgm_player.hpp"
+#include "opn/opn_state.hpp"
+#include "ymfm_opn.h"
+#include <LittleFS.h>
+#include <strings.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#if defined(BENCH_WITH_MDX)
+#include "mdx/mdx_player.hpp"
+#include "opm/opm_state.hpp"
+#endif
+
+namespace {
+
+std::vector<uint8_t> read_file(const std::string& path) {
+  std::vector<uint8_t> v;
+  FILE* f = std::fopen(path.c_str(), "rb");
+  if (!f) return v;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) v.insert(v.end(), buf, buf + n);
+  std::fclose(f);
+  return v;
+}
+
+bool ends_with_i(const std::string& s, const char* suf) {
+  const size_t b = std::strlen(suf);
+  return s.size() >= b && strcasecmp(s.c_str() + s.size() - b, suf) == 0;
+}
+
+double now_s() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 曲の長さ（秒）/ かかった時間（秒）
+void report(const char* what, double audio_s, double wall_s) {
+  std::printf("  %-22s %8.1f s audio in %8.3f s  x%.1f realtime\n", what, audio_s, wall_s,
+              wall_s > 0 ? audio_s / wall_s : 0.0);
+}
+
+// ---- VGM ----
+
+struct VgmTrack {
+  VGMBlob blob;
+  VGMChipSet chips;
+  OPNState state;
+  VGMPlayer player;
+
+  bool load(const char* path) {
+    if (!blob.load_from_file(path)) return false;
+    // 既定の品質段階（QG_LEVEL_DEFAULT）と同じ fidelity
+    if (!chips.setup(blob.header(), ymfm::OPN_FIDELITY_MIN)) return false;
+    return blob.streaming() ? player.load_stream(blob, chips, state)
+                            : player.load(blob.data(), blob.size(), chips, state);
+  }
+};
+
+// 出力は OUT_SR（AUDIO_NATIVE_RATE 無し）なので tick とサンプルは 1:1
+void render(VgmTrack& t, int16_t* dst, uint32_t n) {
+  t.chips.begin_block(dst);
+  for (uint32_t i = 0; i < n; ) {
+    uint32_t k = t.player.step_span(n - i);
+    if (k == 0) k = n - i;
+    t.chips.advance(k);
+    i += k;
+  }
+  t.chips.end_block();
+}
+
+void clock_ticks(VgmTrack& t, uint32_t ticks) {
+  while (ticks > 0) {
+    const uint32_t k = t.player.step_span(ticks);
+    if (k == 0) break;
+    t.chips.clock_only(k);
+    ticks -= k;
+  }
+}
+
+void fast_forward_ms(VgmTrack& t, uint32_t ms) {
+  static int16_t discard[256];
+  const uint32_t settle_ms = std::min(ms, FF_SETTLE_MS);
+  const uint32_t clock_ms = std::min(ms - settle_ms, FF_CLOCK_MS);
+  t.player.fast_forward((uint32_t)(((uint64_t)(ms - settle_ms - clock_ms) * OUT_SR) / 1000));
+  clock_ticks(t, (uint32_t)(((uint64_t)clock_ms * OUT_SR) / 1000));
+  for (uint32_t left = (uint32_t)(((uint64_t)settle_ms * OUT_SR) / 1000); left > 0 && t.player.playing(); ) {
+    const uint32_t k = std::min<uint32_t>(left, sizeof(discard) / sizeof(discard[0]));
+    render(t, discard, k);
+    left -= k;
+  }
+}
+
+bool bench_vgm(const std::string& path) {
+  const std::string fs_path = "/song" + path.substr(path.find_last_of('.'));
+  host_fs_put(fs_path.c_str(), read_file(path));
+
+  // 長さはどのパスでも同じなので1回目で決める（ストリーミングはヘッダ、無ければ 60 秒）
+  uint32_t len = 0;
+  {
+    VgmTrack t;
+    if (!t.load(fs_path.c_str())) return false;
+    len = t.player.length();
+    if (len == 0) len = 60 * OUT_SR;
+    std::printf("%s: %.1f s, chips 0x%x, %s\n", path.c_str(), len / (double)OUT_SR, (unsigned)t.chips.mask(),
+                t.blob.streaming() ? "streamed" : "in memory");
+  }
+  const double audio_s = len / (double)OUT_SR;
+
+  {  // 通常再生（生成してリサンプルして mix）
+    VgmTrack t;
+    t.load(fs_path.c_str());
+    static int16_t buf[AUDIO_BLOCK_SAMPLES];
+    const double t0 = now_s();
+    for (uint32_t done = 0; done < len && t.player.playing(); done += AUDIO_BLOCK_SAMPLES) {
+      render(t, buf, AUDIO_BLOCK_SAMPLES);
+    }
+    report("play", audio_s, now_s() - t0);
+  }
+  {  // ボタンの早送りを押し続けて1周
+    VgmTrack t;
+    t.load(fs_path.c_str());
+    const uint32_t step_ms = FF_RATE * FF_REPEAT_MS;
+    const uint32_t len_ms = (uint32_t)(((uint64_t)len * 1000) / OUT_SR);
+    const double t0 = now_s();
+    for (uint32_t done = 0; done < len_ms && t.player.playing(); done += step_ms) fast_forward_ms(t, step_ms);
+    const double wall = now_s() - t0;
+    report("fast forward (button)", audio_s, wall);
+    std::printf("  %-22s x%u needed (each %u ms step within %u ms)\n", "", (unsigned)FF_RATE, (unsigned)step_ms,
+                (unsigned)FF_REPEAT_MS);
+  }
+  {  // 書き込みだけ（FF_CLOCK_MS より前の区間、長いシーク）
+    VgmTrack t;
+    t.load(fs_path.c_str());
+    const double t0 = now_s();
+    t.player.fast_forward(len);
+    report("writes only", audio_s, now_s() - t0);
+  }
+  return true;
+}
+
+// ---- MDX ----
+
+#if defined(BENCH_WITH_MDX)
+bool bench_mdx(const std::string& path) {
+  std::vector<uint8_t> mdx = read_file(path);
+  if (mdx.empty()) return false;
+  char pdx_name[128] = {};
+  bool has_pdx = false;
+  if (MdxHasPdxFileName(mdx.data(), (uint32_t)mdx.size(), &has_pdx) && has_pdx &&
+      MdxGetPdxFileName(mdx.data(), (uint32_t)mdx.size(), pdx_name, sizeof(pdx_name))) {
+    const size_t slash = path.find_last_of('/');
+    const std::string dir = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    host_fs_put((std::string("/") + pdx_name).c_str(), read_file(dir + pdx_name));
+  }
+  host_fs_put("/song.mdx", mdx);
+
+  MDXPlayer player;
+  OPMState state;
+  if (!player.load(mdx.data(), mdx.size(), state, "/song.mdx")) return false;
+  const uint32_t sr = player.render_sample_rate();
+  uint32_t len_ms = player.length_ms();
+  if (len_ms == 0) len_ms = 60000;
+  std::printf("%s: %.1f s, %u Hz, OPM %s\n", path.c_str(), len_ms / 1000.0, (unsigned)sr,
+              player.opm_backend() == MDX_OPM_BACKEND_YMFM ? "ymfm" : "x68sound");
+  const double audio_s = len_ms / 1000.0;
+
+  {
+    player.restart();
+    std::vector<int16_t> buf(MDX_RENDER_BLOCK_SAMPLES);
+    const uint64_t total = (uint64_t)sr * len_ms / 1000;
+    const double t0 = now_s();
+    for (uint64_t done = 0; done < total && player.playing(); done += buf.size()) {
+      player.render_mono(buf.data(), (int)buf.size());
+    }
+    report("play", audio_s, now_s() - t0);
+  }
+  {  // ボタンを押し続けた分は1回の PlayAt にまとまる
+    player.restart();
+    const double t0 = now_s();
+    for (uint32_t done = 0; done + FF_RATE * FF_REPEAT_MS < len_ms; done += FF_RATE * FF_REPEAT_MS) {
+      player.fast_forward_ms(FF_RATE * FF_REPEAT_MS);
+    }
+    player.finish_fast_forward();
+    report("fast forward (button)", audio_s, now_s() - t0);
+  }
+  return true;
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::printf("usage: %s <file.vgm|.vgz|.vgc|.s98|.mdx> [...]\n", argv[0]);
+    return 2;
+  }
+  int failed = 0;
+  for (int i = 1; i < argc; ++i) {
+    const std::string path = argv[i];
+    bool ok = false;
+    if (ends_with_i(path, ".mdx")) {
+#if defined(BENCH_WITH_MDX)
+      ok = bench_mdx(path);
+#else
+      std::printf("%s: built without portable_mdx\n", path.c_str());
+      continue;
+#endif
+    } else {
+      ok = bench_vgm(path);
+    }
+    if (!ok) {
+      std::printf("%s: load failed\n", path.c_str());
+      ++failed;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+// MDX の OPM 2方式（X68Sound / ymfm）を同じ曲で回し、音声1秒あたりのサイクルを比べる（実機の
+// MDX_OPM_BENCH_ON_LOAD のホスト版）。portable_mdx と ymfm の実物が要るので CMakeLists.txt が
+// .pio/libdeps に見つけた時だけビルドされる（scripts/patch_portable_mdx.py を当てた後のもの）
+//   bench_opm_backends <file.mdx> [seconds]     PDX は同じディレクトリから MDX に書かれた名前で読む
+#include "mdx/mdx_player.hpp"
+#include "opm/opm_state.hpp"
+#include <LittleFS.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+std::vector<uint8_t> read_file(const std::string& path) {
+  std::vector<uint8_t> v;
+  FILE* f = std::fopen(path.c_str(), "rb");
+  if (!f) return v;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) v.insert(v.end(), buf, buf + n);
+  std::fclose(f);
+  return v;
+}
+
+// TSC があればサイクル、無ければ ns（どちらも「音声1秒あたり」に直して比べる）
+uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+#if defined(__x86_64__) || defined(__i386__)
+const char* const kUnit = "cycles";
+#else
+const char* const kUnit = "ns";
+#endif
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::printf("usage: %s <file.mdx> [seconds]\n", argv[0]);
+    return 2;
+  }
+  const std::string mdx_path = argv[1];
+  const uint32_t seconds = argc >= 3 ? (uint32_t)std::strtoul(argv[2], nullptr, 10) : 30;
+
+  std::vector<uint8_t> mdx = read_file(mdx_path);
+  if (mdx.empty()) {
+    std::printf("read %s failed\n", mdx_path.c_str());
+    return 1;
+  }
+  char pdx_name[128] = {};
+  bool has_pdx = false;
+  if (MdxHasPdxFileName(mdx.data(), (uint32_t)mdx.size(), &has_pdx) && has_pdx &&
+      MdxGetPdxFileName(mdx.data(), (uint32_t)mdx.size(), pdx_name, sizeof(pdx_name))) {
+    const size_t slash = mdx_path.find_last_of('/');
+    const std::string dir = slash == std::string::npos ? std::string() : mdx_path.substr(0, slash + 1);
+    host_fs_put((std::string("/") + pdx_name).c_str(), read_file(dir + pdx_name));
+  }
+  host_fs_put("/song.mdx", mdx);
+
+  MDXPlayer player;
+  OPMState state;
+  if (!player.load(mdx.data(), mdx.size(), state, "/song.mdx")) {
+    std::printf("load %s failed\n", mdx_path.c_str());
+    return 1;
+  }
+  const uint32_t sr = player.render_sample_rate();
+  const uint64_t total = (uint64_t)sr * seconds;
+  std::printf("%s: %u Hz, %u s, X68Sound OPM bypass %s\n", mdx_path.c_str(), (unsigned)sr, (unsigned)seconds,
+              MDXPlayer::x68sound_opm_bypassed() ? "patched" : "not patched (ymfm runs on top of a silent X68Sound OPM)");
+
+  static const uint8_t kBackends[] = { MDX_OPM_BACKEND_X68SOUND, MDX_OPM_BACKEND_YMFM };
+  static const char* const kNames[] = { "x68sound", "ymfm" };
+  double per_s[2] = { 0, 0 };
+  std::vector<int16_t> buf(MDX_RENDER_BLOCK_SAMPLES);
+  for (size_t b = 0; b < 2; ++b) {
+    if (!player.set_opm_backend(kBackends[b])) {
+      std::printf("  %-8s unavailable (portable_mdx without the write hook)\n", kNames[b]);
+      continue;
+    }
+    player.restart();
+    uint64_t done = 0;
+    const uint64_t t0 = ticks();
+    while (done < total && player.playing()) {
+      const uint32_t k = (uint32_t)std::min<uint64_t>(total - done, buf.size());
+      player.render_mono(buf.data(), (int)k);
+      done += k;
+    }
+    const uint64_t t = ticks() - t0;
+    per_s[b] = done ? (double)t * sr / (double)done : 0.0;
+    std::printf("  %-8s %.1f M%s per audio s\n", kNames[b], per_s[b] / 1e6, kUnit);
+  }
+  if (per_s[0] > 0 && per_s[1] > 0) std::printf("  ymfm / x68sound = %.2f\n", per_s[1] / per_s[0]);
+  return 0;
+}
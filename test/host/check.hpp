@@ -0,0 +1,35 @@
+#pragma once
+// ホストテストの最小限の判定。失敗は数えて続け、main の最後に check_result() を返す
+#include <cstdio>
+
+inline int& check_failures() {
+  static int n = 0;
+  return n;
+}
+
+#define CHECK(cond)                                                         \
+  do {                                                                      \
+    if (!(cond)) {                                                          \
+      std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);  \
+      ++check_failures();                                                   \
+    }                                                                       \
+  } while (0)
+
+#define CHECK_MSG(cond, ...)                                                \
+  do {                                                                      \
+    if (!(cond)) {                                                          \
+      std::printf("%s:%d: CHECK failed: %s: ", __FILE__, __LINE__, #cond);  \
+      std::printf(__VA_ARGS__);                                             \
+      std::printf("\n");                                                    \
+      ++check_failures();                                                   \
+    }                                                                       \
+  } while (0)
+
+inline int check_result(const char* name) {
+  if (check_failures() == 0) {
+    std::printf("%s: OK\n", name);
+    return 0;
+  }
+  std::printf("%s: %d failure(s)\n", name, check_failures());
+  return 1;
+}
@@ -0,0 +1,70 @@
+// VGMChipSet のうちプレイヤーが呼ぶ分だけを、書き込みの記録に置き換える
+// （vgm_chips.cpp の代わりにリンクする。ymfm もレーンも使わない）
+#include "fake_chips.hpp"
+#include "vgm/vgm_chips.hpp"
+#include "common/fm_envelope.hpp"
+#include <cstdlib>
+
+FakeChipLog& fake_chip_log() {
+  static FakeChipLog log;
+  return log;
+}
+
+static uint32_t u32le(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// vgm_chips.cpp と同じく data offset より前の欄だけ有効
+static uint32_t header_clock(const uint8_t* hdr, uint32_t data_start, uint32_t off, bool* dual = nullptr) {
+  if (off + 4 > data_start) return 0;
+  uint32_t v = u32le(hdr + off);
+  if (dual) *dual = (v & 0x40000000) != 0;
+  return v & 0x3FFFFFFF;
+}
+
+VGMChipSet::~VGMChipSet() { clear(); }
+
+bool VGMChipSet::setup(const uint8_t* hdr, uint8_t, uint32_t) {
+  clear();
+  if (!hdr) return false;
+  uint32_t rel = u32le(hdr + 0x34);
+  uint32_t data_start = (rel == 0) ? 0x40 : (0x34 + rel);
+
+  bool dual = false;
+  if (header_clock(hdr, data_start, 0x44, &dual)) {
+    mask_ |= 1u << VGM_CHIP_YM2203;
+    if (dual) mask_ |= 1u << VGM_CHIP_YM2203_2;
+  }
+  if (header_clock(hdr, data_start, 0x48)) mask_ |= 1u << VGM_CHIP_YM2608;
+  if (header_clock(hdr, data_start, 0x74)) mask_ |= 1u << VGM_CHIP_AY8910;
+  if (header_clock(hdr, data_start, 0x0C)) mask_ |= 1u << VGM_CHIP_SN76489;
+  return mask_ != 0;
+}
+
+void VGMChipSet::clear() {
+  for (uint32_t i = 0; i < owned_count_; ++i) free(owned_[i]);
+  owned_count_ = 0;
+  mask_ = 0;
+}
+
+LevelTap* VGMChipSet::opn_ssg_taps() const { return nullptr; }
+FmEnvelopeProbe VGMChipSet::opn_envelope() const { return FmEnvelopeProbe{}; }
+
+void VGMChipSet::reset() { fake_chip_log().resets++; }
+
+bool VGMChipSet::add_data_block(uint8_t type, const uint8_t* data, uint32_t size, bool owned) {
+  fake_chip_log().blocks.push_back({ type, size, size ? data[0] : (uint8_t)0 });
+  if (owned) {
+    if (owned_count_ >= kMaxOwned) {
+      free((void*)data);
+      return false;
+    }
+    owned_[owned_count_++] = (void*)data;
+  }
+  return true;
+}
+
+void VGMChipSet::write(uint8_t chip, uint8_t port, uint8_t reg, uint8_t data) {
+  FakeChipLog& log = fake_chip_log();
+  log.writes.push_back({ log.now, chip, port, reg, data });
+}
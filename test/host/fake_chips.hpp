@@ -0,0 +1,29 @@
+#pragma once
+// VGMChipSet のホスト用差し替え（fake_chips.cpp）。音は作らず、プレイヤーからの書き込みを記録するだけ
+#include <cstdint>
+#include <vector>
+
+struct ChipWrite {
+  uint32_t t;   // 書き込み時の再生時刻（テストが fake_chip_log().now に入れた値）
+  uint8_t chip, port, reg, data;
+  bool operator==(const ChipWrite& o) const {
+    return t == o.t && chip == o.chip && port == o.port && reg == o.reg && data == o.data;
+  }
+  bool operator!=(const ChipWrite& o) const { return !(*this == o); }
+};
+
+struct ChipBlock {
+  uint8_t type;
+  uint32_t size;
+  uint8_t first;
+};
+
+struct FakeChipLog {
+  uint32_t now = 0;
+  uint32_t resets = 0;
+  std::vector<ChipWrite> writes;
+  std::vector<ChipBlock> blocks;
+  void clear() { *this = FakeChipLog{}; }
+};
+
+FakeChipLog& fake_chip_log();
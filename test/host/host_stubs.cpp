@@ -0,0 +1,35 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <chrono>
+#include <map>
+#include <string>
+
+HostSerial Serial;
+HostEsp ESP;
+HostFS LittleFS;
+
+static const auto g_start = std::chrono::steady_clock::now();
+
+uint32_t micros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - g_start).count();
+}
+uint32_t millis() { return micros() / 1000; }
+void delay(uint32_t) {}
+uint32_t getCpuFrequencyMhz() { return 0; }
+
+static std::map<std::string, std::shared_ptr<const std::vector<uint8_t>>>& host_files() {
+  static std::map<std::string, std::shared_ptr<const std::vector<uint8_t>>> files;
+  return files;
+}
+
+void host_fs_put(const char* path, std::vector<uint8_t> bytes) {
+  host_files()[path] = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+}
+
+File HostFS::open(const char* path, const char*) {
+  auto it = host_files().find(path);
+  return it == host_files().end() ? File() : File(it->second);
+}
+
+bool HostFS::exists(const char* path) { return host_files().count(path) != 0; }
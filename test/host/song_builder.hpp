@@ -0,0 +1,203 @@
+#pragma once
+// テスト用の曲データ作り。同じ書き込みと wait の並びを VGM / S98 へ書き出し、.vgz は stored ブロックの gzip で包む
+#include "vgm/vgm_chips.hpp"
+#include "vgm/s98_format.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SongBuilder {
+public:
+  explicit SongBuilder(uint32_t opn_clock = 3993600) : opn_clock_(opn_clock) {}
+
+  void use(VGMChipId chip) { used_ |= 1u << chip; }
+
+  void write(VGMChipId chip, uint8_t port, uint8_t reg, uint8_t data) {
+    use(chip);
+    ops_.push_back({ kWrite, chip, port, reg, data, 0, {} });
+  }
+  void wait(uint32_t n) {
+    if (n) ops_.push_back({ kWait, 0, 0, 0, 0, n, {} });
+  }
+  void loop_here() { ops_.push_back({ kLoop, 0, 0, 0, 0, 0, {} }); }
+  // VGM にだけ入るもの（data block・未対応チップのコマンドなど）。samples はそのコマンドが含む wait
+  void vgm_raw(std::vector<uint8_t> bytes, uint32_t samples = 0) {
+    ops_.push_back({ kRaw, 0, 0, 0, 0, samples, std::move(bytes) });
+  }
+  void data_block(uint8_t type, const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> b = { 0x67, 0x66, type };
+    put32(b, (uint32_t)data.size());
+    b.insert(b.end(), data.begin(), data.end());
+    vgm_raw(std::move(b));
+  }
+
+  // VGM の末尾に GD3 を付ける（曲名 英語だけ、ASCII）
+  void gd3_title(const std::string& en) { gd3_title_ = en; }
+
+  std::vector<uint8_t> vgm() const {
+    std::vector<uint8_t> v(0x100, 0);
+    v[0] = 'V'; v[1] = 'g'; v[2] = 'm'; v[3] = ' ';
+    set32(v, 0x08, 0x171);
+    set32(v, 0x34, 0x100 - 0x34);
+    if (used_ & (1u << VGM_CHIP_SN76489)) set32(v, 0x0C, 3579545);
+    if (used_ & (1u << VGM_CHIP_YM2203))
+      set32(v, 0x44, opn_clock_ | ((used_ & (1u << VGM_CHIP_YM2203_2)) ? 0x40000000u : 0));
+    if (used_ & (1u << VGM_CHIP_YM2608)) set32(v, 0x48, 7987200);
+    if (used_ & (1u << VGM_CHIP_AY8910)) set32(v, 0x74, 1996800);
+
+    uint32_t total = 0, loop_t = 0, loop_at = 0;
+    for (const Op& o : ops_) {
+      switch (o.kind) {
+        case kWrite:
+          switch (o.chip) {
+            case VGM_CHIP_YM2203:   v.insert(v.end(), { 0x55, o.reg, o.data }); break;
+            case VGM_CHIP_YM2203_2: v.insert(v.end(), { 0xA5, o.reg, o.data }); break;
+            case VGM_CHIP_YM2608:   v.insert(v.end(), { (uint8_t)(0x56 + o.port), o.reg, o.data }); break;
+            case VGM_CHIP_AY8910:   v.insert(v.end(), { 0xA0, o.reg, o.data }); break;
+            case VGM_CHIP_SN76489:  v.insert(v.end(), { 0x50, o.data }); break;
+          }
+          break;
+        case kWait:
+          total += o.n;
+          for (uint32_t n = o.n; n > 0; ) {
+            if (n == 735) { v.push_back(0x62); n = 0; }
+            else if (n == 882) { v.push_back(0x63); n = 0; }
+            else if (n <= 16) { v.push_back((uint8_t)(0x70 + n - 1)); n = 0; }
+            else {
+              const uint32_t k = n > 0xFFFF ? 0xFFFF : n;
+              v.insert(v.end(), { 0x61, (uint8_t)k, (uint8_t)(k >> 8) });
+              n -= k;
+            }
+          }
+          break;
+        case kLoop:
+          loop_at = (uint32_t)v.size();
+          loop_t = total;
+          break;
+        case kRaw:
+          total += o.n;
+          v.insert(v.end(), o.raw.begin(), o.raw.end());
+          break;
+      }
+    }
+    v.push_back(0x66);
+    if (!gd3_title_.empty()) {
+      set32(v, 0x14, (uint32_t)v.size() - 0x14);
+      std::vector<uint8_t> strs;
+      for (char c : gd3_title_) strs.insert(strs.end(), { (uint8_t)c, 0 });
+      strs.resize(strs.size() + 2 * 11, 0);   // 終端と残り 10 欄は空
+      v.insert(v.end(), { 'G', 'd', '3', ' ' });
+      put32(v, 0x100);
+      put32(v, (uint32_t)strs.size());
+      v.insert(v.end(), strs.begin(), strs.end());
+    }
+    set32(v, 0x04, (uint32_t)v.size() - 0x04);
+    set32(v, 0x18, total);
+    if (loop_at) {
+      set32(v, 0x1C, loop_at - 0x1C);
+      set32(v, 0x20, total - loop_t);
+    }
+    return v;
+  }
+
+  // 1 sync = num/den 秒。書き込みの時刻（サンプル）へ届く最小の sync 数で並べる
+  // （プレイヤーは sync 数の累計 × OUT_SR × num / den を切り捨てる）
+  std::vector<uint8_t> s98(uint32_t num, uint32_t den) const {
+    const uint64_t mul = (uint64_t)OUT_SR * num;
+    uint8_t dev_of[VGM_CHIP_COUNT];
+    std::vector<uint32_t> types, clocks;
+    for (uint32_t c = 0; c < VGM_CHIP_COUNT; ++c) {
+      dev_of[c] = 0xFF;
+      if (!(used_ & (1u << c))) continue;
+      dev_of[c] = (uint8_t)types.size();
+      switch (c) {
+        case VGM_CHIP_YM2203:
+        case VGM_CHIP_YM2203_2: types.push_back(s98::kDevOPN); clocks.push_back(opn_clock_); break;
+        case VGM_CHIP_YM2608:   types.push_back(s98::kDevOPNA); clocks.push_back(7987200); break;
+        case VGM_CHIP_AY8910:   types.push_back(s98::kDevAY); clocks.push_back(1996800); break;
+        case VGM_CHIP_SN76489:  types.push_back(s98::kDevDCSG); clocks.push_back(3579545); break;
+      }
+    }
+
+    const uint32_t dump = s98::kOffDevices + 16 * (uint32_t)types.size();
+    std::vector<uint8_t> v(dump, 0);
+    v[0] = 'S'; v[1] = '9'; v[2] = '8'; v[3] = '3';
+    set32(v, s98::kOffTimerNum, num);
+    set32(v, s98::kOffTimerDen, den);
+    set32(v, s98::kOffDump, dump);
+    set32(v, s98::kOffDevCount, (uint32_t)types.size());
+    for (size_t i = 0; i < types.size(); ++i) {
+      set32(v, s98::kOffDevices + 16 * (uint32_t)i, types[i]);
+      set32(v, s98::kOffDevices + 16 * (uint32_t)i + 4, clocks[i]);
+    }
+
+    uint64_t samples = 0, ticks = 0;
+    auto flush = [&]() {
+      const uint64_t want = (samples * den + mul - 1) / mul;
+      const uint64_t pending = want > ticks ? want - ticks : 0;
+      ticks += pending;
+      if (pending == 1) v.push_back(s98::kCmdSync);
+      else if (pending > 1) {
+        v.push_back(s98::kCmdSyncN);
+        for (uint64_t n = pending - 2; ; n >>= 7) {
+          v.push_back((uint8_t)((n & 0x7F) | (n > 0x7F ? 0x80 : 0)));
+          if (n <= 0x7F) break;
+        }
+      }
+    };
+    for (const Op& o : ops_) {
+      if (o.kind == kWait || o.kind == kRaw) { samples += o.n; continue; }
+      if (o.kind == kLoop) { flush(); set32(v, s98::kOffLoop, (uint32_t)v.size()); continue; }
+      if (o.kind != kWrite) continue;
+      flush();
+      v.insert(v.end(), { (uint8_t)(dev_of[o.chip] * 2 + o.port), o.reg, o.data });
+    }
+    flush();
+    v.push_back(s98::kCmdEnd);
+    return v;
+  }
+
+  static std::vector<uint8_t> gzip_stored(const std::vector<uint8_t>& raw) {
+    std::vector<uint8_t> g = { 0x1F, 0x8B, 0x08, 0, 0, 0, 0, 0, 0, 0xFF };
+    size_t pos = 0;
+    do {
+      const size_t k = raw.size() - pos > 0xFFFF ? 0xFFFF : raw.size() - pos;
+      const bool last = pos + k == raw.size();
+      g.insert(g.end(), { (uint8_t)(last ? 1 : 0), (uint8_t)k, (uint8_t)(k >> 8),
+                          (uint8_t)~k, (uint8_t)(~k >> 8) });
+      g.insert(g.end(), raw.begin() + pos, raw.begin() + pos + k);
+      pos += k;
+    } while (pos < raw.size());
+    put32(g, crc32(raw));
+    put32(g, (uint32_t)raw.size());
+    return g;
+  }
+
+private:
+  enum Kind : uint8_t { kWrite, kWait, kLoop, kRaw };
+  struct Op {
+    Kind kind;
+    uint8_t chip, port, reg, data;
+    uint32_t n;
+    std::vector<uint8_t> raw;
+  };
+  std::vector<Op> ops_;
+  uint32_t used_ = 0;
+  uint32_t opn_clock_;
+  std::string gd3_title_;
+
+  static void put32(std::vector<uint8_t>& v, uint32_t x) {
+    for (int i = 0; i < 4; ++i) v.push_back((uint8_t)(x >> (8 * i)));
+  }
+  static void set32(std::vector<uint8_t>& v, uint32_t at, uint32_t x) {
+    for (int i = 0; i < 4; ++i) v[at + i] = (uint8_t)(x >> (8 * i));
+  }
+  static uint32_t crc32(const std::vector<uint8_t>& d) {
+    uint32_t c = 0xFFFFFFFFu;
+    for (uint8_t b : d) {
+      c ^= b;
+      for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+    }
+    return ~c;
+  }
+};
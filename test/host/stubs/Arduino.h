@@ -0,0 +1,30 @@
+#pragma once
+// ホストテスト用の Arduino.h（テスト対象が使う分だけ）
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+uint32_t getCpuFrequencyMhz();   // 0（ホストでは分からない）
+
+struct HostSerial {
+  int printf(const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    const int r = vprintf(fmt, ap);
+    va_end(ap);
+    return r;
+  }
+};
+extern HostSerial Serial;
+
+struct HostEsp {
+  uint32_t getCycleCount() { return micros(); }
+};
+extern HostEsp ESP;
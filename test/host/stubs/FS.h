@@ -0,0 +1,37 @@
+#pragma once
+// ホストテスト用の FS.h：LittleFS の代わりにメモリ上のファイル（host_fs_put で置く）を読む
+#include <Arduino.h>
+#include <memory>
+#include <vector>
+
+class File {
+public:
+  File() = default;
+  explicit File(std::shared_ptr<const std::vector<uint8_t>> data) : data_(std::move(data)) {}
+
+  explicit operator bool() const { return data_ != nullptr; }
+  size_t size() const { return data_ ? data_->size() : 0; }
+  size_t position() const { return pos_; }
+  int available() const { return (int)(size() - pos_); }
+  bool seek(uint32_t pos) {
+    if (!data_ || pos > data_->size()) return false;
+    pos_ = pos;
+    return true;
+  }
+  int read(uint8_t* dst, size_t n) {
+    if (!data_) return -1;
+    if (n > data_->size() - pos_) n = data_->size() - pos_;
+    memcpy(dst, data_->data() + pos_, n);
+    pos_ += n;
+    return (int)n;
+  }
+  void close() { data_.reset(); pos_ = 0; }
+  // ディレクトリは持たない（open できるのはファイルだけ）
+  bool isDirectory() const { return false; }
+  File openNextFile() { return File(); }
+  const char* name() const { return ""; }
+
+private:
+  std::shared_ptr<const std::vector<uint8_t>> data_;
+  size_t pos_ = 0;
+};
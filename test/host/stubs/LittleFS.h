@@ -0,0 +1,12 @@
+#pragma once
+#include <FS.h>
+
+struct HostFS {
+  File open(const char* path, const char* mode = "r");
+  bool exists(const char* path);
+  bool begin(bool format_on_fail = false) { (void)format_on_fail; return true; }
+};
+extern HostFS LittleFS;
+
+// テストが path にファイルを置く（同じ path は置き換え）
+void host_fs_put(const char* path, std::vector<uint8_t> bytes);
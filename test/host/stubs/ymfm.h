@@ -0,0 +1,27 @@
+#pragma once
+// ホストテスト用の ymfm（宣言と何もしない本体だけ）。チップの音はテストしない
+#include <cstdint>
+
+namespace ymfm {
+
+enum access_class : uint32_t { ACCESS_IO = 0, ACCESS_ADPCM_A, ACCESS_ADPCM_B, ACCESS_PCM, ACCESS_CLASSES };
+enum envelope_state : uint32_t { EG_DEPRESS = 0, EG_ATTACK = 1, EG_DECAY = 2, EG_SUSTAIN = 3, EG_RELEASE = 4, EG_STATES = 6 };
+
+class ymfm_interface {
+public:
+  virtual ~ymfm_interface() {}
+  virtual uint8_t ymfm_external_read(access_class, uint32_t) { return 0; }
+  virtual void ymfm_external_write(access_class, uint32_t, uint8_t) {}
+};
+
+template <int N>
+struct ymfm_output {
+  int32_t data[N];
+  ymfm_output& clear() {
+    for (auto& d : data) d = 0;
+    return *this;
+  }
+  void roundtrip_fp() {}
+};
+
+}  // namespace ymfm
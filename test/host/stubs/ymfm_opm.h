@@ -0,0 +1,36 @@
+#pragma once
+#include "ymfm_opn.h"
+
+namespace ymfm {
+
+struct opm_registers {};
+
+// ホストテスト用：generate は n 番目のサンプルに L = R = wave(n) を出す（既定は int16 で折り返す傾き）。
+// 出力の値から、どの native サンプルが使われたかが分かる
+class ym2151 {
+public:
+  using fm_engine = fm_engine_base<opm_registers>;
+  static constexpr uint32_t OUTPUTS = 2;
+  static constexpr int32_t kRampStep = 16;
+  using output_data = ymfm_output<OUTPUTS>;
+
+  static int32_t ramp(uint64_t n) { return (int16_t)(uint16_t)(n * kRampStep); }
+  static inline int32_t (*wave)(uint64_t n) = &ramp;
+
+  explicit ym2151(ymfm_interface&) {}
+  uint32_t sample_rate(uint32_t clock) const { return clock / 64; }
+  void reset() { generated_ = 0; }
+  void write_address(uint8_t) {}
+  void write_data(uint8_t) {}
+  void generate(output_data* out, uint32_t n = 1) {
+    for (uint32_t i = 0; i < n; ++i) out[i].data[0] = out[i].data[1] = wave(generated_++);
+  }
+
+protected:
+  fm_engine m_fm;
+
+private:
+  uint64_t generated_ = 0;
+};
+
+}  // namespace ymfm
@@ -0,0 +1,65 @@
+#pragma once
+#include "ymfm.h"
+
+namespace ymfm {
+
+enum opn_fidelity : uint8_t { OPN_FIDELITY_MAX, OPN_FIDELITY_MIN, OPN_FIDELITY_MED, OPN_FIDELITY_DEFAULT = OPN_FIDELITY_MAX };
+
+struct fm_operator {
+  uint32_t debug_eg_attenuation() const { return 0x3FF; }
+  envelope_state debug_eg_state() const { return EG_RELEASE; }
+};
+struct fm_channel {
+  fm_operator* debug_operator(uint32_t) const {
+    static fm_operator o;
+    return &o;
+  }
+};
+template <class Registers>
+struct fm_engine_base {
+  static constexpr uint32_t OUTPUTS = 1, ALL_CHANNELS = 0x07;
+  using output_data = ymfm_output<OUTPUTS>;
+  uint32_t clock(uint32_t) { return 0; }
+  void output(output_data&, uint32_t, int32_t, uint32_t) const {}
+  fm_channel* debug_channel(uint32_t) const {
+    static fm_channel c;
+    return &c;
+  }
+};
+struct opn_registers {};
+template <class Output>
+struct ssg_resampler {
+  uint32_t sampindex() const { return m_sampindex; }
+  void resample(Output* out, uint32_t n) {
+    for (uint32_t i = 0; i < n; ++i) out[i].data[1] = out[i].data[2] = out[i].data[3] = 0;
+    m_sampindex += n;
+  }
+  uint32_t m_sampindex = 0;
+};
+
+class ym2203 {
+public:
+  using fm_engine = fm_engine_base<opn_registers>;
+  static constexpr uint32_t FM_OUTPUTS = 1, SSG_OUTPUTS = 3, OUTPUTS = 4;
+  using output_data = ymfm_output<OUTPUTS>;
+
+  explicit ym2203(ymfm_interface&) {}
+  void set_fidelity(opn_fidelity) {}
+  uint32_t sample_rate(uint32_t clock) const { return clock / 72; }
+  void reset() {}
+  void write_address(uint8_t) {}
+  void write_data(uint8_t) {}
+  void write(uint32_t, uint8_t) {}
+  uint8_t read_status() { return 0; }
+  void generate(output_data* out, uint32_t n = 1) {
+    for (uint32_t i = 0; i < n; ++i) out[i].clear();
+  }
+
+protected:
+  uint8_t m_fm_samples_per_output = 1;
+  fm_engine::output_data m_last_fm{};
+  fm_engine m_fm;
+  ssg_resampler<output_data> m_ssg_resampler;
+};
+
+}  // namespace ymfm
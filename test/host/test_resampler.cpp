@@ -0,0 +1,224 @@
+// Resampler：通過域・阻止域・ハーフバンドの一致・段階の単調性・ブロック分割に依らないこと
+#include "check.hpp"
+#include "dsp/resampler.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+struct Pair { uint32_t in, out; };
+// 22.05k MDX の 2倍 / OPN 55.5k（LOW）/ その半分 / OPN MED 110.9k（前段 1段）/ MED の 1/4（前段だけ）/
+// 前段 2段 + FIR / 上げ方向の FIR
+constexpr Pair kPairs[] = {
+  { 22050, 44100 }, { 55466, 44100 }, { 55466, 27733 }, { 110933, 44100 },
+  { 110932, 27733 }, { 221866, 44100 }, { 44100, 48000 },
+};
+const char* const kTierNames[] = { "linear", "fast", "good", "best" };
+
+constexpr uint32_t kOut = 16384;
+constexpr uint32_t kSkip = 1024;   // 履歴の立ち上がり
+
+// 出力 n 個をブロック毎（長さは chunk、0 なら乱数）に作る
+std::vector<int16_t> run(Resampler& rs, const std::vector<int16_t>& in, uint32_t n, uint32_t chunk) {
+  std::vector<int16_t> out(n);
+  std::vector<int16_t> buf;
+  size_t pos = 0;
+  for (uint32_t i = 0; i < n; ) {
+    uint32_t k = chunk ? chunk : 1 + (uint32_t)(rand() % 700);
+    if (k > n - i) k = n - i;
+    const uint32_t need = rs.input_for(k);
+    buf.assign(in.begin() + pos, in.begin() + pos + need);
+    rs.process(buf.data(), out.data() + i, k);
+    pos += need;
+    i += k;
+  }
+  return out;
+}
+
+std::vector<int16_t> sine(double freq, uint32_t sr, uint32_t n, double amp = 16384.0) {
+  std::vector<int16_t> v(n);
+  for (uint32_t i = 0; i < n; ++i) v[i] = (int16_t)std::lrint(amp * std::sin(2.0 * M_PI * std::fmod(freq * i / sr, 1.0)));
+  return v;
+}
+
+// 出力 1 サンプルあたり何入力進むか（16.16 と前段の刻みで丸めた実際の比）
+double actual_ratio(const Resampler& rs) {
+  constexpr uint32_t kN = 1u << 22;
+  return (double)rs.input_for(kN) / kN;
+}
+
+struct Fit { double gain_db, thdn_db; };
+
+// 入力と同じ周波数の正弦を最小二乗で当て、振幅比と残り（THD+N）を dB で
+Fit fit_sine(const std::vector<int16_t>& y, double w, double amp) {
+  double cc = 0, ss = 0, cs = 0, yc = 0, ys = 0, yy = 0;
+  for (uint32_t i = kSkip; i < y.size(); ++i) {
+    const double c = std::cos(w * i), s = std::sin(w * i), v = y[i];
+    cc += c * c; ss += s * s; cs += c * s;
+    yc += v * c; ys += v * s; yy += v * v;
+  }
+  const double det = cc * ss - cs * cs;
+  const double a = (yc * ss - ys * cs) / det;
+  const double b = (ys * cc - yc * cs) / det;
+  const double fit = a * yc + b * ys;
+  const double resid = yy - fit;
+  Fit f;
+  f.gain_db = 20.0 * std::log10(std::sqrt(a * a + b * b) / amp);
+  f.thdn_db = 10.0 * std::log10((resid > 1e-9 ? resid : 1e-9) / (fit > 1e-9 ? fit : 1e-9));
+  return f;
+}
+
+Fit pass_tone(uint32_t in_sr, uint32_t out_sr, Resampler::Tier tier, double freq) {
+  Resampler rs;
+  rs.configure(in_sr, out_sr, tier);
+  const double ratio = actual_ratio(rs);
+  const auto in = sine(freq, in_sr, rs.input_for(kOut) + 8);
+  const auto out = run(rs, in, kOut, 1024);
+  return fit_sine(out, 2.0 * M_PI * freq * ratio / in_sr, 16384.0);
+}
+
+// 折り返すと out の 0.35 倍以下（44.1kHz なら 15.4kHz 以下）へ落ちてくる正弦を入れ、出てきた分の
+// 大きさを dB で。Nyquist のすぐ上は短い窓では落とし切れないので見ない。該当が無ければ -200
+double alias_db(uint32_t in_sr, uint32_t out_sr, Resampler::Tier tier) {
+  const double lo = out_sr * 0.65, hi = in_sr * 0.49;
+  if (hi <= lo) return -200.0;
+  double worst = -200.0;
+  for (double frac : { 0.0, 0.5, 1.0 }) {
+    const double freq = lo + (hi - lo) * frac;
+    Resampler rs;
+    rs.configure(in_sr, out_sr, tier);
+    const auto in = sine(freq, in_sr, rs.input_for(kOut) + 8);
+    const auto out = run(rs, in, kOut, 1024);
+    double e = 0;
+    for (uint32_t i = kSkip; i < kOut; ++i) e += (double)out[i] * out[i];
+    const double rms = std::sqrt(e / (kOut - kSkip));
+    const double db = 20.0 * std::log10((rms > 1e-3 ? rms : 1e-3) / (16384.0 / std::sqrt(2.0)));
+    if (db > worst) worst = db;
+  }
+  return worst;
+}
+
+void test_passband_and_monotonic() {
+  for (const Pair& p : kPairs) {
+    double prev_thdn = 1e9, prev_alias = 1e9;
+    for (uint32_t t = 0; t < Resampler::kTierCount; ++t) {
+      const auto tier = (Resampler::Tier)t;
+      const Fit lo = pass_tone(p.in, p.out, tier, 1000.0);
+      const Fit hi = pass_tone(p.in, p.out, tier, 8000.0);
+      const double alias = alias_db(p.in, p.out, tier);
+      std::printf("  %6u -> %5u %-6s  1k gain %+5.2f dB THD+N %6.1f  8k gain %+5.2f dB THD+N %6.1f  alias %6.1f dB\n",
+                  (unsigned)p.in, (unsigned)p.out, kTierNames[t],
+                  lo.gain_db, lo.thdn_db, hi.gain_db, hi.thdn_db, alias);
+
+      // 通過域：1kHz はどの段階でもほぼそのまま
+      CHECK_MSG(std::fabs(lo.gain_db) < 0.5, "%u->%u %s 1k gain %.2f dB", (unsigned)p.in, (unsigned)p.out, kTierNames[t], lo.gain_db);
+      CHECK_MSG(lo.thdn_db < -40.0, "%u->%u %s 1k THD+N %.1f dB", (unsigned)p.in, (unsigned)p.out, kTierNames[t], lo.thdn_db);
+      if (t >= Resampler::kGood) {
+        CHECK_MSG(std::fabs(hi.gain_db) < 1.0, "%u->%u %s 8k gain %.2f dB", (unsigned)p.in, (unsigned)p.out, kTierNames[t], hi.gain_db);
+        CHECK_MSG(hi.thdn_db < -45.0, "%u->%u %s 8k THD+N %.1f dB", (unsigned)p.in, (unsigned)p.out, kTierNames[t], hi.thdn_db);
+      }
+      // 阻止域：前段が無かった頃は in が out の 4/3 倍を超えると Linear に落ちて -11dB 程度だった
+      static constexpr double kAliasMax[] = { 0.0, -20.0, -30.0, -45.0 };
+      CHECK_MSG(alias < kAliasMax[t], "%u->%u %s alias %.1f dB", (unsigned)p.in, (unsigned)p.out, kTierNames[t], alias);
+
+      // 段階を上げて悪くならない（量子化の揺れの分 1dB は許す）
+      CHECK_MSG(hi.thdn_db <= prev_thdn + 1.0, "%u->%u %s 8k THD+N %.1f dB worse than lower tier %.1f dB",
+                (unsigned)p.in, (unsigned)p.out, kTierNames[t], hi.thdn_db, prev_thdn);
+      CHECK_MSG(alias <= prev_alias + 1.0, "%u->%u %s alias %.1f dB worse than lower tier %.1f dB",
+                (unsigned)p.in, (unsigned)p.out, kTierNames[t], alias, prev_alias);
+      prev_thdn = hi.thdn_db;
+      prev_alias = alias;
+    }
+  }
+}
+
+// 出力はブロックの切り方に依らない（input_for / output_for と前段の消費が合っている）
+void test_block_split() {
+  std::vector<int16_t> in(600000);
+  for (auto& v : in) v = (int16_t)(rand() % 20000 - 10000);
+  for (const Pair& p : kPairs) {
+    for (uint32_t t = 0; t < Resampler::kTierCount; ++t) {
+      Resampler a, b;
+      a.configure(p.in, p.out, (Resampler::Tier)t);
+      b.configure(p.in, p.out, (Resampler::Tier)t);
+      const uint32_t n = 50000;
+      const auto whole = run(a, in, n, n);
+      const auto split = run(b, in, n, 0);
+      CHECK_MSG(whole == split, "%u->%u %s", (unsigned)p.in, (unsigned)p.out, kTierNames[t]);
+      // output_for(cap) の出力数は cap 個の入力で足りる
+      for (uint32_t cap : { 1u, 7u, 256u, 1000u }) {
+        Resampler c;
+        c.configure(p.in, p.out, (Resampler::Tier)t);
+        const uint32_t k = c.output_for(cap);
+        CHECK_MSG(k == 1 || c.input_for(k) <= cap, "%u->%u %s cap %u", (unsigned)p.in, (unsigned)p.out, kTierNames[t], (unsigned)cap);
+      }
+    }
+  }
+}
+
+// 前段（1/2 を 2段）は本段のハーフバンド間引き（ちょうど半分）を 2回掛けたものと同じ
+void test_halfband_cascade() {
+  std::vector<int16_t> in(200000);
+  for (auto& v : in) v = (int16_t)(rand() % 30000 - 15000);
+  for (auto tier : { Resampler::kLinear, Resampler::kFast, Resampler::kGood }) {
+    Resampler quad, half1, half2;
+    quad.configure(176400, 44100, tier);
+    half1.configure(176400, 88200, tier);
+    half2.configure(88200, 44100, tier);
+    CHECK(quad.pre_stages() == 2 && quad.taps() == 0);
+    CHECK(half1.halfband() && half2.halfband() && half1.pre_stages() == 0);
+    if (tier != Resampler::kLinear) CHECK(half1.taps() == (tier == Resampler::kFast ? 15u : 31u));
+
+    const uint32_t n = 40000;
+    const auto q = run(quad, in, n, 0);
+    const auto mid = run(half1, in, n * 2, 0);
+    const auto h = run(half2, mid, n, 0);
+    CHECK_MSG(q == h, "tier %s", kTierNames[tier]);
+  }
+}
+
+// 2倍：位相 0 の出力は入力そのもの（K 入力遅れ。窓は 2K）
+void test_up2_phase0() {
+  std::vector<int16_t> in(5000);
+  for (auto& v : in) v = (int16_t)(rand() % 30000 - 15000);
+  for (uint32_t t = 0; t < Resampler::kTierCount; ++t) {
+    Resampler rs;
+    rs.configure(22050, 44100, (Resampler::Tier)t);
+    CHECK(rs.halfband());
+    const auto out = run(rs, in, 8000, 0);
+    const uint32_t k = rs.taps() / 2;
+    bool same = true;
+    for (uint32_t i = k; i < 4000; ++i) same = same && out[2 * i + 1] == in[i - k];
+    CHECK_MSG(same, "tier %s", kTierNames[t]);
+  }
+}
+
+// 前段があっても無音が続けば quiet になり、音が来れば抜ける
+void test_quiet_with_pre_stages() {
+  Resampler rs;
+  rs.configure(110933, 44100, Resampler::kGood);
+  CHECK(rs.pre_stages() == 1);
+  CHECK(rs.quiet());
+  std::vector<int16_t> in = sine(1000.0, 110933, 4000);
+  in.resize(4000 + 2000, 0);
+  std::vector<int16_t> out(1000);
+  rs.process(in.data(), out.data(), 1000);
+  CHECK(!rs.quiet());
+  const uint32_t used = rs.input_for(1000);
+  std::vector<int16_t> zeros(used + 4, 0);
+  rs.process(zeros.data(), out.data(), 1000);
+  CHECK(rs.quiet());
+}
+
+}  // namespace
+
+int main() {
+  srand(1);
+  test_passband_and_monotonic();
+  test_block_split();
+  test_halfband_cascade();
+  test_up2_phase0();
+  test_quiet_with_pre_stages();
+  return check_result("test_resampler");
+}
@@ -0,0 +1,191 @@
+// SSGBlep：トーン・エンベロープの周期、書き込みの段差、polyBLEP で折り返しが減っていること
+#include "check.hpp"
+#include "psg/ssg_blep.hpp"
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kClock = 1996800;   // AY 換算（YM2203 3.9936MHz / 2）
+constexpr uint32_t kSr = 44100;
+constexpr int32_t kGain = 16384;       // 0.5
+constexpr int32_t kFull = 32767 / 2;   // 音量 15 の1ch が gain を通った値
+
+std::vector<int16_t> render(SSGBlep& s, uint32_t n) {
+  std::vector<int16_t> v(n);
+  s.render_block_mono_i16(v.data(), n);
+  return v;
+}
+
+// 平均を引いて上向きに 0 を横切った回数から周波数を出す
+double crossing_freq(const std::vector<int16_t>& v, uint32_t skip) {
+  double mean = 0;
+  for (uint32_t i = skip; i < v.size(); ++i) mean += v[i];
+  mean /= (double)(v.size() - skip);
+  int first = -1, last = -1, count = 0;
+  for (uint32_t i = skip + 1; i < v.size(); ++i) {
+    if (v[i - 1] < mean && v[i] >= mean) {
+      if (first < 0) first = (int)i;
+      last = (int)i;
+      ++count;
+    }
+  }
+  return count > 1 ? (double)(count - 1) * kSr / (last - first) : 0.0;
+}
+
+// 周期 period サンプルの矩形（デューティ 50%）として、帯域内の奇数次高調波で当てた残りの割合（dB）
+double alias_db(const std::vector<int16_t>& v, double period, uint32_t skip) {
+  const double f0 = 1.0 / period;
+  std::vector<double> y(v.begin() + skip, v.end());
+  double mean = 0;
+  for (double x : y) mean += x;
+  mean /= (double)y.size();
+  for (double& x : y) x -= mean;
+  double total = 0;
+  for (double x : y) total += x * x;
+  double resid = total;
+  // 各高調波は直交に近い（長い窓）ので1本ずつ引く
+  for (uint32_t k = 1; k * f0 < 0.5; k += 2) {
+    const double w = 2.0 * M_PI * k * f0;
+    double c = 0, s = 0;
+    for (size_t i = 0; i < y.size(); ++i) {
+      c += y[i] * std::cos(w * i);
+      s += y[i] * std::sin(w * i);
+    }
+    resid -= 2.0 * (c * c + s * s) / (double)y.size();
+  }
+  return 10.0 * std::log10((resid > 1e-9 ? resid : 1e-9) / total);
+}
+
+void setup_tone(SSGBlep& s, uint32_t tp) {
+  s.write(0, (uint8_t)tp);
+  s.write(1, (uint8_t)(tp >> 8));
+  s.write(7, 0x3E);   // A の tone だけ
+  s.write(8, 0x0F);
+}
+
+// トーンの周波数は clock / (16 * TP)
+void test_tone_period() {
+  for (uint32_t tp : { 0x11u, 0x40u, 0x100u, 0x3FFu, 0xFFFu }) {
+    SSGBlep s(kClock, kSr, kGain);
+    setup_tone(s, tp);
+    const auto v = render(s, kSr * 2);
+    const double expect = (double)kClock / (16.0 * tp);
+    const double got = crossing_freq(v, 100);
+    CHECK_MSG(std::fabs(got / expect - 1.0) < 0.002, "TP %u: %.2f Hz, expected %.2f Hz", (unsigned)tp, got, expect);
+  }
+}
+
+// 周期を縮めた時は今のカウントが新しい周期を超えていれば次のサンプルで反転する
+void test_period_shrink() {
+  SSGBlep s(kClock, kSr, kGain);
+  setup_tone(s, 0xFFF);   // 約 30Hz
+  auto v = render(s, 100);
+  setup_tone(s, 0x10);    // 約 7.8kHz
+  v = render(s, 4410);
+  const double got = crossing_freq(v, 10);
+  CHECK_MSG(std::fabs(got / (kClock / 256.0) - 1.0) < 0.01, "after shrink %.1f Hz", got);
+}
+
+// 音量の書き込みは境界ちょうどの段差：そのサンプルは中点、次から新しい値
+void test_volume_step() {
+  SSGBlep s(kClock, kSr, kGain);
+  s.write(7, 0x3F);   // tone/noise とも無効 = 出力は音量そのもの
+  CHECK(s.is_idle());
+  auto v = render(s, 16);
+  for (int16_t x : v) CHECK(x == 0);
+
+  s.write(8, 0x0F);
+  CHECK(!s.is_idle());
+  v = render(s, 16);
+  CHECK_MSG(std::abs(v[0] - kFull / 2) <= 1, "first %d, expected %d", v[0], kFull / 2);
+  for (uint32_t i = 1; i < v.size(); ++i) CHECK_MSG(std::abs(v[i] - kFull) <= 1, "[%u] %d", (unsigned)i, v[i]);
+
+  // 1段 = 1.5dB（固定音量 1段 = 3dB）
+  s.write(8, 0x0D);
+  v = render(s, 4);
+  const double db = 20.0 * std::log10((double)v[3] / kFull);
+  CHECK_MSG(std::fabs(db + 6.0) < 0.3, "volume 13: %.2f dB", db);
+
+  s.write(8, 0x00);
+  v = render(s, 4);
+  CHECK(v[1] == 0 && v[2] == 0 && v[3] == 0);
+  CHECK(s.is_idle());
+}
+
+// ミュートした ch は音量が残っていても 0（無音判定にも数えない）、外せば元の音量に戻る
+void test_mute_mask() {
+  SSGBlep s(kClock, kSr, kGain);
+  s.write(7, 0x3F);
+  s.write(8, 0x0F);
+  render(s, 4);
+  s.set_mute_mask(0x08);   // A
+  auto v = render(s, 8);
+  for (uint32_t i = 1; i < v.size(); ++i) CHECK_MSG(v[i] == 0, "muted [%u] %d", (unsigned)i, v[i]);
+  CHECK(s.is_idle());
+
+  s.set_mute_mask(0);
+  CHECK(!s.is_idle());
+  v = render(s, 8);
+  for (uint32_t i = 1; i < v.size(); ++i) CHECK_MSG(std::abs(v[i] - kFull) <= 1, "unmuted [%u] %d", (unsigned)i, v[i]);
+}
+
+// エンベロープ（鋸歯の繰り返し 0x0C）の周期は 256 * EP / clock
+void test_envelope_period() {
+  for (uint32_t ep : { 0x20u, 0x100u }) {
+    SSGBlep s(kClock, kSr, kGain);
+    s.write(7, 0x3F);
+    s.write(8, 0x10);
+    s.write(11, (uint8_t)ep);
+    s.write(12, (uint8_t)(ep >> 8));
+    s.write(13, 0x0C);
+    const auto v = render(s, kSr);
+    // 最大から最小へ落ちる所（大きな負の段差）を数える
+    int first = -1, last = -1, count = 0;
+    for (uint32_t i = 1; i < v.size(); ++i) {
+      if (v[i] - v[i - 1] < -kFull / 2) {
+        if (first < 0) first = (int)i;
+        last = (int)i;
+        ++count;
+      }
+    }
+    const double expect = kSr * 256.0 * ep / kClock;
+    const double got = count > 1 ? (double)(last - first) / (count - 1) : 0;
+    CHECK_MSG(std::fabs(got / expect - 1.0) < 0.01, "EP %u: period %.2f samples, expected %.2f", (unsigned)ep, got, expect);
+  }
+}
+
+// 帯域制限：高いトーンの折り返し（帯域内の高調波以外）が、1サンプル毎に点で取った矩形より十分小さい
+void test_alias_vs_naive() {
+  for (uint32_t tp : { 0x0Bu, 0x1Du, 0x47u }) {
+    SSGBlep s(kClock, kSr, kGain);
+    setup_tone(s, tp);
+    const uint32_t n = 32768;
+    const auto v = render(s, n);
+    // SSGBlep は 1サンプルの tick 数を Q12 に丸めて数えるので、周期もその値から
+    const uint32_t tick_fp = (uint32_t)((((uint64_t)kClock / 8) << 12) / kSr);
+    const double period = 2.0 * tp * 4096.0 / tick_fp;
+
+    std::vector<int16_t> naive(n);
+    for (uint32_t i = 0; i < n; ++i) naive[i] = std::fmod(i / period, 1.0) < 0.5 ? kFull : 0;
+
+    const double blep = alias_db(v, period, 256);
+    const double point = alias_db(naive, period, 256);
+    std::printf("  TP %3u (%.0f Hz): alias polyBLEP %.1f dB, point-sampled %.1f dB\n", (unsigned)tp,
+                kClock / (16.0 * tp), blep, point);
+    CHECK_MSG(blep < point - 10.0, "TP %u: polyBLEP %.1f dB vs point-sampled %.1f dB", (unsigned)tp, blep, point);
+    CHECK_MSG(blep < -25.0, "TP %u: polyBLEP alias %.1f dB", (unsigned)tp, blep);
+  }
+}
+
+}  // namespace
+
+int main() {
+  test_tone_period();
+  test_period_shrink();
+  test_volume_step();
+  test_mute_mask();
+  test_envelope_period();
+  test_alias_vs_naive();
+  return check_result("test_ssg_blep");
+}
@@ -0,0 +1,257 @@
+// .s98 / .vgc：VGMBlob で読んで VGMPlayer で鳴らした書き込みが、同じ曲の VGM と一致すること
+//   test_vgm_formats                    S98（sync の長さ違い・v1 の既定 OPNA・タグの Shift-JIS / UTF-8）
+//   test_vgm_formats --emit <vgm>       vgm2vgc.py に渡す VGM を書き出す
+//   test_vgm_formats --vgc <vgm> <vgc>  変換結果と元の VGM を比べる（.vgc は冗長な書き込みを削ってある）
+#include "check.hpp"
+#include "fake_chips.hpp"
+#include "song_builder.hpp"
+#include "vgm/vgm_player.hpp"
+#include "vgm/vgm_blob.hpp"
+#include "vgm/vgc_format.hpp"
+#include "opn/opn_state.hpp"
+#include <LittleFS.h>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+struct Played {
+  uint32_t mask = 0;
+  uint32_t length = 0, loop_length = 0;
+  std::vector<ChipWrite> writes;
+};
+
+// main.cpp と同じ順：blob → ヘッダからチップ → プレイヤー。一周 + ループ2回ぶん鳴らす
+Played play_file(const char* path) {
+  Played r;
+  VGMBlob blob;
+  if (!blob.load_from_file(path)) {
+    CHECK_MSG(false, "%s: load", path);
+    return r;
+  }
+  VGMChipSet chips;
+  OPNState state;
+  VGMPlayer p;
+  CHECK_MSG(chips.setup(blob.header(), 0), "%s: setup", path);
+  CHECK_MSG(p.load(blob.data(), blob.size(), chips, state), "%s: player", path);
+  r.mask = chips.mask();
+  r.length = p.length();
+  r.loop_length = p.loop_length();
+
+  FakeChipLog& log = fake_chip_log();
+  log.clear();
+  const uint32_t n = r.length + 2 * r.loop_length + 1000;
+  for (uint32_t s = 0; s < n; ) {
+    log.now = s;
+    const uint32_t k = p.step_span(n - s);
+    if (k == 0) break;
+    s += k;
+  }
+  r.writes = log.writes;
+  return r;
+}
+
+uint8_t rnd8() { return (uint8_t)(rand() & 0xFF); }
+
+// wait は sync 単位で作り、VGM 側へはサンプルへ切り捨てた差で積む（S98 と同じ丸め）
+SongBuilder random_song(uint32_t ops, uint32_t num, uint32_t den, uint32_t chips) {
+  const uint64_t mul = (uint64_t)OUT_SR * num;
+  SongBuilder b;
+  uint64_t ticks = 0;
+  for (uint32_t i = 0; i < ops; ++i) {
+    if (i == ops / 3) b.loop_here();
+    const int r = rand() % 10;
+    const VGMChipId chip = (VGMChipId)(rand() % VGM_CHIP_COUNT);
+    if (r < 6 && ((chips >> chip) & 1)) {
+      const uint8_t port = chip == VGM_CHIP_YM2608 ? rand() & 1 : 0;
+      const uint8_t reg = chip == VGM_CHIP_SN76489 ? 0 : chip == VGM_CHIP_AY8910 ? rnd8() & 0x0F : rnd8();
+      b.write(chip, port, reg, rnd8());
+    } else if (r >= 6) {
+      const uint64_t dt = rand() % 4 == 0 ? rand() % 400 : rand() % 8;
+      b.wait((uint32_t)((ticks + dt) * mul / den - ticks * mul / den));
+      ticks += dt;
+    }
+  }
+  b.wait((uint32_t)((ticks + 5) * mul / den - ticks * mul / den));
+  return b;
+}
+
+bool same_writes(const char* what, const Played& a, const Played& b) {
+  size_t i = 0;
+  while (i < a.writes.size() && i < b.writes.size() && a.writes[i] == b.writes[i]) ++i;
+  if (i == a.writes.size() && i == b.writes.size()) return true;
+  CHECK_MSG(false, "%s: %zu vs %zu writes, first difference at %zu", what, a.writes.size(), b.writes.size(), i);
+  return false;
+}
+
+void test_s98(const char* what, uint32_t num, uint32_t den, uint32_t chips, char version, bool default_timer) {
+  const SongBuilder song = random_song(30000, num, den, chips);
+  std::vector<uint8_t> s98 = song.s98(num, den);
+  s98[3] = version;
+  if (default_timer) memset(s98.data() + s98::kOffTimerNum, 0, 8);   // 0 = 10ms
+  host_fs_put("/song.vgm", song.vgm());
+  host_fs_put("/song.s98", s98);
+
+  const Played v = play_file("/song.vgm");
+  const Played s = play_file("/song.s98");
+  CHECK_MSG(v.mask == chips && s.mask == chips, "%s: chips %x / %x, expected %x", what, (unsigned)v.mask,
+            (unsigned)s.mask, (unsigned)chips);
+  CHECK_MSG(s.length == v.length && s.loop_length == v.loop_length, "%s: length %u/%u vs %u/%u", what,
+            (unsigned)s.length, (unsigned)s.loop_length, (unsigned)v.length, (unsigned)v.loop_length);
+  CHECK_MSG(v.loop_length > 0, "%s: no loop", what);
+  same_writes(what, s, v);
+  std::printf("  %s: %zu writes, %u samples\n", what, s.writes.size(), (unsigned)s.length);
+}
+
+// 曲の後ろへタグを足して、タグ位置を指す
+std::vector<uint8_t> s98_with_tag(char version, const std::string& tag) {
+  std::vector<uint8_t> v = random_song(100, 1, 1000, 1u << VGM_CHIP_YM2203).s98(1, 1000);
+  v[3] = version;
+  const uint32_t off = (uint32_t)v.size();
+  for (int i = 0; i < 4; ++i) v[s98::kOffTag + i] = (uint8_t)(off >> (8 * i));
+  v.insert(v.end(), tag.begin(), tag.end());
+  v.push_back(0);
+  return v;
+}
+
+void check_s98_tag(const char* what, const std::vector<uint8_t>& s98, const char* title, const char* game,
+                   const char* artist) {
+  host_fs_put("/tag.s98", s98);
+  VGMBlob blob;
+  if (!blob.load_from_file("/tag.s98")) {
+    CHECK_MSG(false, "%s: load", what);
+    return;
+  }
+  CHECK_MSG(blob.gd3_track_name_en() == title, "%s: title '%s'", what, blob.gd3_track_name_en().c_str());
+  CHECK_MSG(blob.gd3_game_name_en() == game, "%s: game '%s'", what, blob.gd3_game_name_en().c_str());
+  CHECK_MSG(blob.gd3_author_en() == artist, "%s: artist '%s'", what, blob.gd3_author_en().c_str());
+}
+
+// 「タイトル」（Shift-JIS / UTF-8）
+const char kTitleSjis[] = "\x83\x5E\x83\x43\x83\x67\x83\x8B";
+const char kTitleUtf8[] = "\xE3\x82\xBF\xE3\x82\xA4\xE3\x83\x88\xE3\x83\xAB";
+
+void test_s98_tags() {
+  check_s98_tag("s98 v1 title", s98_with_tag('1', kTitleSjis), kTitleUtf8, "", "");
+  check_s98_tag("s98 v3 sjis",
+                s98_with_tag('3', std::string("[S98]title=") + kTitleSjis + "\r\ngame=PC-98\nartist=" + kTitleSjis + "\n"),
+                kTitleUtf8, "PC-98", kTitleUtf8);
+  check_s98_tag("s98 v3 utf8", s98_with_tag('3', std::string("[S98]\xEF\xBB\xBFtitle=") + kTitleUtf8 + "\n"),
+                kTitleUtf8, "", "");
+}
+
+constexpr uint32_t kAllChips = (1u << VGM_CHIP_COUNT) - 1;
+
+std::vector<uint8_t> read_file(const char* path) {
+  std::vector<uint8_t> v;
+  FILE* f = std::fopen(path, "rb");
+  if (!f) return v;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) v.insert(v.end(), buf, buf + n);
+  std::fclose(f);
+  return v;
+}
+
+// vgm2vgc.py の dedupable() と同じ：書いても値を覚えるだけのレジスタ
+bool dedupable(const ChipWrite& w) {
+  if (w.chip == VGM_CHIP_SN76489) return false;
+  if (w.chip == VGM_CHIP_AY8910) return w.reg <= 0x0C;
+  if (w.port == 0 && w.reg <= 0x0C) return true;
+  return (w.reg >= 0x30 && w.reg <= 0x9F) || (w.reg >= 0xB0 && w.reg <= 0xB6);
+}
+
+// .vgc は同じ値の書き直しを削るので、時刻毎のレジスタの影と、削られない書き込みの並びで比べる
+void compare_vgc(const char* vgm_path, const char* vgc_path) {
+  const std::vector<uint8_t> vgm = read_file(vgm_path), vgc = read_file(vgc_path);
+  CHECK_MSG(!vgm.empty() && !vgc.empty(), "read %s / %s", vgm_path, vgc_path);
+  host_fs_put("/song.vgm", vgm);
+  host_fs_put("/song.vgc", vgc);
+  const Played v = play_file("/song.vgm");
+  const Played c = play_file("/song.vgc");
+  CHECK_MSG(c.mask == v.mask, "chips %x vs %x", (unsigned)c.mask, (unsigned)v.mask);
+  CHECK_MSG(c.length == v.length && c.loop_length == v.loop_length, "length %u/%u vs %u/%u", (unsigned)c.length,
+            (unsigned)c.loop_length, (unsigned)v.length, (unsigned)v.loop_length);
+
+  using Key = std::tuple<uint8_t, uint8_t, uint8_t>;
+  std::map<Key, uint8_t> sv, sc;
+  std::vector<ChipWrite> kv, kc;
+  size_t i = 0, j = 0, bad = 0;
+  while (i < v.writes.size() || j < c.writes.size()) {
+    const uint32_t t = std::min(i < v.writes.size() ? v.writes[i].t : UINT32_MAX,
+                                j < c.writes.size() ? c.writes[j].t : UINT32_MAX);
+    for (; i < v.writes.size() && v.writes[i].t == t; ++i) {
+      const ChipWrite& w = v.writes[i];
+      sv[Key(w.chip, w.port, w.reg)] = w.data;
+      if (!dedupable(w)) kv.push_back(w);
+    }
+    for (; j < c.writes.size() && c.writes[j].t == t; ++j) {
+      const ChipWrite& w = c.writes[j];
+      sc[Key(w.chip, w.port, w.reg)] = w.data;
+      if (!dedupable(w)) kc.push_back(w);
+    }
+    if (sv != sc && bad++ == 0) CHECK_MSG(false, "register state differs at t=%u", (unsigned)t);
+  }
+  CHECK_MSG(kv == kc, "side-effect writes %zu vs %zu", kv.size(), kc.size());
+  CHECK_MSG(c.writes.size() <= v.writes.size(), "vgc has more writes (%zu) than vgm (%zu)", c.writes.size(),
+            v.writes.size());
+  std::printf("  vgc: %zu writes (vgm %zu), %u samples\n", c.writes.size(), v.writes.size(), (unsigned)c.length);
+
+  // data block の offset + size が 32bit で回って範囲内に見える .vgc は読まない
+  std::vector<uint8_t> bad_vgc = vgc;
+  const uint32_t off = 0x10, size = 0u - 8u;
+  for (int k = 0; k < 4; ++k) {
+    bad_vgc[vgc::kOffBlocks + k] = (uint8_t)(off >> (8 * k));
+    bad_vgc[vgc::kOffBlocks + 4 + k] = (uint8_t)(size >> (8 * k));
+  }
+  host_fs_put("/bad.vgc", bad_vgc);
+  VGMBlob blob;
+  VGMChipSet chips;
+  OPNState state;
+  VGMPlayer p;
+  CHECK(blob.load_from_file("/bad.vgc") && chips.setup(blob.header(), 0));
+  CHECK_MSG(!p.load(blob.data(), blob.size(), chips, state), "vgc with wrapping block range loaded");
+}
+
+// 同じ値の書き直しを混ぜた VGM（全チップ、ループ付き）
+void emit_vgm(const char* path) {
+  SongBuilder b;
+  for (uint32_t i = 0; i < 20000; ++i) {
+    if (i == 7000) b.loop_here();
+    const int r = rand() % 10;
+    const VGMChipId chip = (VGMChipId)(rand() % VGM_CHIP_COUNT);
+    // 値の幅を狭くして書き直しを作る
+    if (r < 6) b.write(chip, chip == VGM_CHIP_YM2608 ? rand() & 1 : 0, chip == VGM_CHIP_SN76489 ? 0 : rnd8(), rand() % 3);
+    else if (r < 9) b.wait(rand() % 20);
+    else b.wait(rand() % 3000);
+  }
+  b.wait(10);
+  const std::vector<uint8_t> v = b.vgm();
+  FILE* f = std::fopen(path, "wb");
+  CHECK_MSG(f && std::fwrite(v.data(), 1, v.size(), f) == v.size(), "write %s", path);
+  if (f) std::fclose(f);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  srand(1);
+  if (argc == 3 && !strcmp(argv[1], "--emit")) {
+    emit_vgm(argv[2]);
+    return check_result("test_vgm_formats --emit");
+  }
+  if (argc == 4 && !strcmp(argv[1], "--vgc")) {
+    compare_vgc(argv[2], argv[3]);
+    return check_result("test_vgm_formats --vgc");
+  }
+  test_s98("s98 1/44100", 1, 44100, kAllChips, '3', false);
+  test_s98("s98 10ms (timer 0)", 10, 1000, kAllChips, '3', true);
+  test_s98("s98 1ms", 1, 1000, kAllChips, '3', false);
+  test_s98("s98 1/60", 1, 60, kAllChips, '3', false);
+  test_s98("s98 v1 OPNA", 10, 1000, 1u << VGM_CHIP_YM2608, '1', true);
+  test_s98_tags();
+  return check_result("test_vgm_formats");
+}
@@ -0,0 +1,336 @@
+// VGMPlayer：コンパイル済みイベント列が、VGM を1サンプル毎に1バイトずつ解釈した場合と同じ書き込みを同じ時刻に出すこと
+#include "check.hpp"
+#include "fake_chips.hpp"
+#include "song_builder.hpp"
+#include "vgm/vgm_player.hpp"
+#include "vgm/vgm_blob.hpp"
+#include "opn/opn_state.hpp"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+extern uint64_t tinfl_stored_output_bytes;
+
+namespace {
+
+uint32_t u32le(const std::vector<uint8_t>& v, uint32_t at) {
+  return (uint32_t)v[at] | ((uint32_t)v[at + 1] << 8) | ((uint32_t)v[at + 2] << 16) | ((uint32_t)v[at + 3] << 24);
+}
+
+// 旧方式の再生（仕様どおりの素直なデコード）。書き込みは chips のマスクにあるものだけ
+struct RefPlayer {
+  const std::vector<uint8_t>& v;
+  uint32_t mask;
+  uint32_t pos, loop_pos;
+  uint32_t wait = 0;
+  uint32_t t = 0;
+  bool run = true;
+  std::vector<ChipWrite> writes;
+
+  RefPlayer(const std::vector<uint8_t>& vgm, uint32_t chip_mask) : v(vgm), mask(chip_mask) {
+    pos = 0x34 + u32le(v, 0x34);
+    loop_pos = u32le(v, 0x1C) ? 0x1C + u32le(v, 0x1C) : 0;
+  }
+
+  void emit(uint8_t chip, uint8_t port, uint8_t reg, uint8_t data) {
+    if ((mask >> chip) & 1) writes.push_back({ t, chip, port, reg, data });
+  }
+
+  // 0x30-0x3F 等、長さだけ決まっているコマンド
+  static uint32_t skip_len(uint8_t c) {
+    if (c >= 0x30 && c <= 0x3F) return 2;
+    if (c == 0x4F) return 2;
+    if ((c >= 0x40 && c <= 0x4E) || (c >= 0x51 && c <= 0x5F) || (c >= 0xA1 && c <= 0xBF)) return 3;
+    if (c >= 0xC0 && c <= 0xDF) return 4;
+    if (c >= 0xE0) return 5;
+    if (c == 0x68) return 12;
+    return 0;
+  }
+
+  void step_sample() {
+    while (run && wait == 0) {
+      const uint8_t c = v[pos++];
+      switch (c) {
+        case 0x55: emit(VGM_CHIP_YM2203, 0, v[pos], v[pos + 1]); pos += 2; break;
+        case 0xA5: emit(VGM_CHIP_YM2203_2, 0, v[pos], v[pos + 1]); pos += 2; break;
+        case 0x56: emit(VGM_CHIP_YM2608, 0, v[pos], v[pos + 1]); pos += 2; break;
+        case 0x57: emit(VGM_CHIP_YM2608, 1, v[pos], v[pos + 1]); pos += 2; break;
+        case 0xA0:
+          if (!(v[pos] & 0x80)) emit(VGM_CHIP_AY8910, 0, v[pos], v[pos + 1]);
+          pos += 2;
+          break;
+        case 0x50: emit(VGM_CHIP_SN76489, 0, 0, v[pos]); pos += 1; break;
+        case 0x61: wait = v[pos] | (v[pos + 1] << 8); pos += 2; break;
+        case 0x62: wait = 735; break;
+        case 0x63: wait = 882; break;
+        case 0x66:
+          if (loop_pos) pos = loop_pos;
+          else run = false;
+          break;
+        case 0x67: pos += 6 + u32le(v, pos + 2); break;
+        default:
+          if ((c & 0xF0) == 0x70) wait = (c & 0x0F) + 1;
+          else if ((c & 0xF0) == 0x80) wait = c & 0x0F;
+          else if (skip_len(c)) pos += skip_len(c) - 1;
+          else run = false;
+          break;
+      }
+    }
+    if (wait) wait--;
+    t++;
+  }
+};
+
+struct Played {
+  std::vector<ChipWrite> writes;
+  uint32_t samples = 0;
+  bool playing = false;
+};
+
+// step_span で n サンプル分（またはそれ以前に止まるまで）鳴らす
+Played play(VGMPlayer& p, uint32_t n) {
+  FakeChipLog& log = fake_chip_log();
+  log.writes.clear();
+  Played r;
+  while (r.samples < n) {
+    log.now = r.samples;
+    const uint32_t k = p.step_span(n - r.samples);
+    if (k == 0) break;
+    r.samples += k;
+  }
+  r.writes = log.writes;
+  r.playing = p.playing();
+  return r;
+}
+
+uint8_t rnd8() { return (uint8_t)(rand() & 0xFF); }
+
+// 全コマンド種を混ぜた曲。ヘッダに無いチップ（YM2612 など）・AY の2台目・使わない data block も入れる
+SongBuilder random_song(uint32_t ops, bool with_loop, bool with_opna) {
+  SongBuilder b;
+  b.use(VGM_CHIP_YM2203);
+  b.use(VGM_CHIP_YM2203_2);
+  b.use(VGM_CHIP_AY8910);
+  b.use(VGM_CHIP_SN76489);
+  if (with_opna) {
+    b.use(VGM_CHIP_YM2608);
+    b.data_block(VGM_BLOCK_YM2608_ADPCM_B, { 0x00, 0x10, 0, 0, 0, 0, 0, 0, 0x5A, 1, 2, 3 });
+  }
+  b.data_block(0x00, { 0xAA, 1, 2, 3 });   // YM2612 PCM（使わない）
+  for (uint32_t i = 0; i < ops; ++i) {
+    if (with_loop && i == ops / 3) b.loop_here();
+    const int r = rand() % 100;
+    if (r < 30) b.write(VGM_CHIP_YM2203, 0, rnd8(), rnd8());
+    else if (r < 36) b.write(VGM_CHIP_YM2203_2, 0, rnd8(), rnd8());
+    else if (r < 44 && with_opna) b.write(VGM_CHIP_YM2608, rand() & 1, rnd8(), rnd8());
+    else if (r < 50) b.write(VGM_CHIP_AY8910, 0, rnd8() & 0x0F, rnd8());
+    else if (r < 53) b.vgm_raw({ 0xA0, (uint8_t)(0x80 | (rnd8() & 0x0F)), rnd8() });   // AY 2台目
+    else if (r < 58) b.write(VGM_CHIP_SN76489, 0, 0, rnd8());
+    else if (r < 60) b.vgm_raw({ 0x52, rnd8(), rnd8() });                              // YM2612
+    else if (r < 61) b.vgm_raw({ 0x4F, rnd8() });
+    else if (r < 62) b.vgm_raw({ 0xB0, rnd8(), rnd8() });
+    else if (r < 63) b.vgm_raw({ 0xC0, rnd8(), rnd8(), rnd8() });
+    else if (r < 64) b.vgm_raw({ 0xE0, rnd8(), rnd8(), rnd8(), rnd8() });
+    else if (r < 66) {
+      const uint8_t n = rand() & 0x0F;
+      b.vgm_raw({ (uint8_t)(0x80 | n) }, n);                                              // DAC + wait
+    }
+    else if (r < 80) b.wait(1 + rand() % 16);
+    else if (r < 90) b.wait(rand() % 3000);
+    else if (r < 94) b.wait(rand() & 1 ? 735 : 882);
+    else if (r < 95) b.wait(60000 + rand() % 20000);
+  }
+  b.wait(100);
+  return b;
+}
+
+void test_matches_reference(bool with_loop, bool with_opna) {
+  const SongBuilder song = random_song(20000, with_loop, with_opna);
+  const std::vector<uint8_t> vgm = song.vgm();
+
+  VGMChipSet chips;
+  CHECK(chips.setup(vgm.data(), 0));
+  OPNState state;
+  VGMPlayer p;
+  fake_chip_log().clear();
+  CHECK(p.load(vgm.data(), vgm.size(), chips, state));
+
+  const uint32_t total = u32le(vgm, 0x18);
+  const uint32_t loop_len = u32le(vgm, 0x20);
+  CHECK_MSG(p.length() == total, "length %u vs %u", (unsigned)p.length(), (unsigned)total);
+  CHECK_MSG(p.loop_length() == loop_len, "loop %u vs %u", (unsigned)p.loop_length(), (unsigned)loop_len);
+
+  // data block は使うものだけ、1回だけチップへ渡る
+  const auto& blocks = fake_chip_log().blocks;
+  CHECK(blocks.size() == (with_opna ? 1u : 0u));
+  if (with_opna && blocks.size() == 1) CHECK(blocks[0].type == VGM_BLOCK_YM2608_ADPCM_B && blocks[0].size == 12 && blocks[0].first == 0x00);
+
+  // 2周ちょっと鳴らす（ループしない曲は終端を越えて止まる）
+  const uint32_t n = total + 2 * loop_len + 12345;
+  const uint32_t t0 = micros();
+  const Played got = play(p, n);
+  const uint32_t compiled_us = micros() - t0;
+
+  RefPlayer ref(vgm, chips.mask());
+  const uint32_t t1 = micros();
+  while (ref.t < n && ref.run) ref.step_sample();
+  const uint32_t ref_us = micros() - t1;
+
+  CHECK_MSG(got.writes.size() == ref.writes.size(), "writes %zu vs %zu", got.writes.size(), ref.writes.size());
+  size_t diff = 0;
+  while (diff < got.writes.size() && diff < ref.writes.size() && got.writes[diff] == ref.writes[diff]) ++diff;
+  CHECK_MSG(diff == got.writes.size() && diff == ref.writes.size(), "first difference at write %zu", diff);
+  CHECK(p.writes() == got.writes.size());
+  if (with_loop) {
+    CHECK(got.samples == n && got.playing);
+  } else {
+    CHECK_MSG(got.samples == total && !got.playing, "stopped at %u of %u", (unsigned)got.samples, (unsigned)total);
+  }
+
+  std::printf("  loop=%d opna=%d: %zu writes over %u samples, byte decode %u us, compiled %u us\n",
+              with_loop, with_opna, ref.writes.size(), (unsigned)n, (unsigned)ref_us, (unsigned)compiled_us);
+}
+
+// ストリーミング（.vgm は塊で読み、.vgz は逐次展開）でも全体ロードと同じ書き込みになる。
+// .vgz のループは控えた展開状態から戻るので、先頭から展開し直さない
+void test_streaming_matches_whole() {
+  SongBuilder song = random_song(300000, true, true);
+  song.gd3_title("Streamed Title");
+  const std::vector<uint8_t> vgm = song.vgm();
+  CHECK(vgm.size() >= VGM_STREAM_MIN_BYTES);
+  host_fs_put("/big.vgm", vgm);
+  host_fs_put("/big.vgz", SongBuilder::gzip_stored(vgm));
+
+  VGMChipSet chips;
+  OPNState state;
+  VGMPlayer whole;
+  CHECK(chips.setup(vgm.data(), 0));
+  fake_chip_log().clear();
+  CHECK(whole.load(vgm.data(), vgm.size(), chips, state));
+  const uint32_t passes = 3;
+  const uint32_t n = whole.length() + passes * whole.loop_length();
+  const Played ref = play(whole, n);
+  const auto ref_blocks = fake_chip_log().blocks;
+
+  const uint32_t loop_pos = 0x1C + u32le(vgm, 0x1C);
+  for (const char* path : { "/big.vgm", "/big.vgz" }) {
+    VGMBlob blob;
+    CHECK_MSG(blob.load_from_file(path), "%s", path);
+    CHECK_MSG(blob.streaming(), "%s", path);
+    VGMChipSet sc;
+    VGMPlayer p;
+    CHECK(sc.setup(blob.header(), 0));
+    fake_chip_log().clear();
+    tinfl_stored_output_bytes = 0;
+    CHECK_MSG(p.load_stream(blob, sc, state), "%s", path);
+    // 終端まで compile する前からヘッダの長さが見える
+    CHECK_MSG(p.length() == whole.length() && p.loop_length() == whole.loop_length(),
+              "%s: length %u / loop %u before the end is compiled", path, (unsigned)p.length(),
+              (unsigned)p.loop_length());
+    // .vgz の GD3 は終端まで展開してから読む（曲名はそこで出し直す）
+    const bool gz = std::string(path) == "/big.vgz";
+    CHECK_MSG(blob.gd3_track_name_en().empty() == gz, "%s: title before playing '%s'", path,
+              blob.gd3_track_name_en().c_str());
+    const Played got = play(p, n);
+    CHECK_MSG(blob.gd3_track_name_en() == "Streamed Title", "%s: title '%s'", path, blob.gd3_track_name_en().c_str());
+    CHECK_MSG(blob.gd3_serial() == (gz ? 1u : 0u), "%s: gd3 read %u times", path, (unsigned)blob.gd3_serial());
+
+    CHECK_MSG(got.samples == n && got.playing, "%s: played %u of %u", path, (unsigned)got.samples, (unsigned)n);
+    CHECK_MSG(got.writes == ref.writes, "%s: %zu writes vs %zu", path, got.writes.size(), ref.writes.size());
+    // data block はループで読み直しても1回だけ
+    const auto& blocks = fake_chip_log().blocks;
+    CHECK_MSG(blocks.size() == ref_blocks.size(), "%s: %zu blocks", path, blocks.size());
+    if (gz) {
+      // 1周目の全体 + 2周目以降はループ区間と窓 1つぶんまで（先頭から展開し直すと 1周ぶんずつ増える）
+      const uint64_t limit = vgm.size() + (uint64_t)passes * (vgm.size() - loop_pos + 64 * 1024);
+      CHECK_MSG(tinfl_stored_output_bytes <= limit, "inflated %llu bytes, limit %llu",
+                (unsigned long long)tinfl_stored_output_bytes, (unsigned long long)limit);
+      std::printf("  vgz: %zu bytes, loop at %u, inflated %llu bytes over %u passes\n", vgm.size(),
+                  (unsigned)loop_pos, (unsigned long long)tinfl_stored_output_bytes, (unsigned)passes + 1);
+    }
+  }
+}
+
+// 書き込みを全部当てた後のレジスタの影（chip, port, reg 毎）
+std::vector<int> shadow(const std::vector<ChipWrite>& writes) {
+  std::vector<int> regs(VGM_CHIP_COUNT * 2 * 256, -1);
+  for (const ChipWrite& w : writes) regs[(w.chip * 2 + w.port) * 256 + w.reg] = w.data;
+  return regs;
+}
+
+// 早送りは1サンプルずつ進めた場合と同じ位置・同じ書き込みに着く（終端とループを跨いでも）
+void test_fast_forward(bool with_loop) {
+  const SongBuilder song = random_song(4000, with_loop, true);
+  const std::vector<uint8_t> vgm = song.vgm();
+  VGMChipSet chips;
+  OPNState state;
+  CHECK(chips.setup(vgm.data(), 0));
+
+  VGMPlayer probe;
+  CHECK(probe.load(vgm.data(), vgm.size(), chips, state));
+  const uint32_t len = probe.length();
+  const uint32_t loop_len = probe.loop_length();
+
+  const uint32_t starts[] = { 0, 1, len / 3, len - 1 };
+  const uint32_t spans[] = { 1, 735, 44100 * 7 + 13, len, 2 * len + 17 };
+  for (uint32_t p0 : starts) {
+    for (uint32_t n : spans) {
+      VGMPlayer ff, ref;
+      CHECK(ff.load(vgm.data(), vgm.size(), chips, state));
+      CHECK(ref.load(vgm.data(), vgm.size(), chips, state));
+
+      fake_chip_log().clear();
+      CHECK(play(ff, p0).samples == p0);
+      const uint32_t done = ff.fast_forward(n);
+      const auto ff_regs = shadow(fake_chip_log().writes);
+
+      fake_chip_log().clear();
+      for (uint32_t i = 0; i < p0 + n && ref.playing(); ++i) ref.step_one_sample();
+      const auto ref_regs = shadow(fake_chip_log().writes);
+
+      const uint32_t expect = with_loop ? n : (p0 + n < len ? n : len - p0);
+      CHECK_MSG(done == expect, "loop=%d from %u ff %u: advanced %u, expected %u", with_loop, (unsigned)p0, (unsigned)n,
+                (unsigned)done, (unsigned)expect);
+      CHECK_MSG(ff.position() == ref.position(), "loop=%d from %u ff %u: position %u vs %u", with_loop, (unsigned)p0,
+                (unsigned)n, (unsigned)ff.position(), (unsigned)ref.position());
+      CHECK_MSG(ff.writes() == ref.writes(), "loop=%d from %u ff %u: writes %u vs %u", with_loop, (unsigned)p0,
+                (unsigned)n, (unsigned)ff.writes(), (unsigned)ref.writes());
+      CHECK_MSG(ff_regs == ref_regs, "loop=%d from %u ff %u: registers differ", with_loop, (unsigned)p0, (unsigned)n);
+      CHECK(ff.playing() == ref.playing());
+      if (with_loop) {
+        // ループ曲の位置は一周を超えるとループ区間へ折り返す（ちょうど終端に着いた時は折り返す前）
+        const uint64_t x = (uint64_t)p0 + n;
+        const uint32_t loop_t = len - loop_len;
+        const uint32_t wrapped = x <= len ? (uint32_t)x : loop_t + (uint32_t)((x - len) % loop_len);
+        CHECK_MSG(ff.position() == wrapped || (ff.position() == len && wrapped == loop_t),
+                  "from %u ff %u: position %u, expected %u", (unsigned)p0, (unsigned)n, (unsigned)ff.position(),
+                  (unsigned)wrapped);
+      }
+    }
+  }
+
+  // 一周ぶんの早送りにかかる時間（書き込みだけ。チップは fake なので、実際の曲と ymfm を回した数字は
+  // bench_fast_forward で見る）
+  VGMPlayer ff;
+  CHECK(ff.load(vgm.data(), vgm.size(), chips, state));
+  const uint32_t t0 = micros();
+  ff.fast_forward(len);
+  const uint32_t us = micros() - t0;
+  std::printf("  fast forward loop=%d: %u samples (%.1f s) in %u us\n", with_loop, (unsigned)len, len / (double)OUT_SR,
+              (unsigned)us);
+}
+
+}  // namespace
+
+int main() {
+  srand(1);
+  test_matches_reference(true, false);
+  test_matches_reference(true, true);
+  test_matches_reference(false, true);
+  test_streaming_matches_whole();
+  test_fast_forward(true);
+  test_fast_forward(false);
+  return check_result("test_vgm_player");
+}
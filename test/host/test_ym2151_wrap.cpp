@@ -0,0 +1,139 @@
+// YM2151Wrap：native (clock/64) の出力を Resampler に通して出力レートへ落とすこと、
+// 帯域外が折り返さないこと、ブロック分割に依らないこと
+// ymfm の ym2151 は stubs/ymfm_opm.h の波形（n 番目のサンプル = wave(n)）に置き換えてある
+#include "check.hpp"
+#include "ym2151_wrap.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kClock = 4000000;   // X68000 の OPM
+constexpr int32_t kUnity = 32768;
+constexpr uint32_t kOut = 4096;
+constexpr uint32_t kSkip = 512;        // 履歴の立ち上がり
+constexpr uint32_t kRates[] = { 22050, 44100, 62500, 96000 };
+const char* const kTierNames[] = { "linear", "fast", "good", "best" };
+
+// 出力 n 個を chunk（0 なら乱数）毎に作る。acc は base で埋めておき、加算であることも見る
+std::vector<int32_t> run(YM2151Wrap& w, uint32_t n, uint32_t chunk, int32_t gain, int32_t base = 0) {
+  std::vector<int32_t> acc(n, base);
+  for (uint32_t i = 0; i < n; ) {
+    uint32_t k = chunk ? chunk : 1 + (uint32_t)(rand() % 700);
+    if (k > n - i) k = n - i;
+    w.render_add(acc.data() + i, k, gain);
+    i += k;
+  }
+  return acc;
+}
+
+// 同じ native の並びを単体の Resampler に通したものと一致する（補間を自前でしていない）
+void test_matches_resampler() {
+  for (uint32_t sr : kRates) {
+    for (uint32_t t = 0; t < Resampler::kTierCount; ++t) {
+      const auto tier = (Resampler::Tier)t;
+      YM2151Wrap w(kClock, sr, tier);
+      CHECK(w.sample_rate_native() == kClock / 64);
+      const auto acc = run(w, kOut, 0, kUnity);
+
+      Resampler rs;
+      rs.configure(kClock / 64, sr, tier);
+      std::vector<int16_t> in(rs.input_for(kOut));
+      for (uint32_t i = 0; i < in.size(); ++i) in[i] = (int16_t)ymfm::ym2151::wave(i);
+      std::vector<int16_t> ref(kOut);
+      rs.process(in.data(), ref.data(), kOut);
+
+      uint32_t i = 0;
+      while (i < kOut && acc[i] == ref[i]) ++i;
+      CHECK_MSG(i == kOut, "sr %u %s: first difference at %u (%d vs %d)", (unsigned)sr, kTierNames[t], (unsigned)i,
+                i < kOut ? acc[i] : 0, i < kOut ? ref[i] : 0);
+    }
+  }
+}
+
+double g_freq = 0;
+int32_t sine_wave(uint64_t n) {
+  return (int32_t)std::lrint(16384.0 * std::sin(2.0 * M_PI * std::fmod(g_freq * (double)n / (kClock / 64), 1.0)));
+}
+
+double rms_db(const std::vector<int32_t>& v) {
+  double e = 0;
+  for (uint32_t i = kSkip; i < v.size(); ++i) e += (double)v[i] * v[i];
+  const double rms = std::sqrt(e / (v.size() - kSkip));
+  return 20.0 * std::log10((rms > 1e-3 ? rms : 1e-3) / (16384.0 / std::sqrt(2.0)));
+}
+
+// 22.05kHz へ落とす時：1kHz はそのまま、出力の Nyquist を超える 16-30kHz は段階相応に落ちる
+// （線形補間だった頃はほぼ素通しで折り返していた）
+void test_band_limited() {
+  static constexpr double kAliasMax[] = { 0.0, -20.0, -30.0, -45.0 };
+  for (uint32_t t = Resampler::kFast; t < Resampler::kTierCount; ++t) {
+    const auto tier = (Resampler::Tier)t;
+    g_freq = 1000.0;
+    ymfm::ym2151::wave = &sine_wave;
+    YM2151Wrap pass(kClock, 22050, tier);
+    const double pass_db = rms_db(run(pass, kOut, 256, kUnity));
+    CHECK_MSG(std::fabs(pass_db) < 0.5, "%s 1k: %.2f dB", kTierNames[t], pass_db);
+    double worst = -200.0;
+    for (double f : { 16000.0, 22000.0, 30000.0 }) {
+      g_freq = f;
+      YM2151Wrap w(kClock, 22050, tier);
+      const double db = rms_db(run(w, kOut, 256, kUnity));
+      if (db > worst) worst = db;
+    }
+    std::printf("  62500 -> 22050 %-6s  1k %+5.2f dB  alias %6.1f dB\n", kTierNames[t], pass_db, worst);
+    CHECK_MSG(worst < kAliasMax[t], "%s alias %.1f dB", kTierNames[t], worst);
+  }
+  ymfm::ym2151::wave = &ymfm::ym2151::ramp;
+}
+
+// 分け方（1サンプルずつ・乱数・作業バッファをまたぐ長さ）で結果が変わらない
+void test_block_split() {
+  for (uint32_t sr : kRates) {
+    YM2151Wrap whole(kClock, sr);
+    const auto ref = run(whole, kOut, kOut, kUnity);
+    for (uint32_t chunk : { 1u, 0u, 181u, 256u, 700u }) {
+      YM2151Wrap w(kClock, sr);
+      const auto got = run(w, kOut, chunk, kUnity);
+      size_t i = 0;
+      while (i < kOut && got[i] == ref[i]) ++i;
+      CHECK_MSG(i == kOut, "sr %u chunk %u: first difference at %zu", (unsigned)sr, (unsigned)chunk, i);
+    }
+  }
+}
+
+// gain は Q15 で掛けて acc へ足す
+void test_gain_add() {
+  YM2151Wrap a(kClock, 44100), b(kClock, 44100);
+  const auto full = run(a, kOut, kOut, kUnity);
+  const auto half = run(b, kOut, kOut, kUnity / 2, 1000);
+  uint32_t bad = 0;
+  for (uint32_t i = 0; i < kOut; ++i)
+    if (half[i] != 1000 + ((full[i] * (kUnity / 2)) >> 15) && bad++ == 0)
+      CHECK_MSG(false, "[%u]: %d, full %d", (unsigned)i, half[i], full[i]);
+}
+
+// reset() は位置と Resampler の履歴を捨てて最初から。set_tier は途中で変えても続けて出せる
+void test_reset_and_tier() {
+  YM2151Wrap w(kClock, 44100);
+  const auto first = run(w, kOut, 0, kUnity);
+  w.reset();
+  const auto again = run(w, kOut, 0, kUnity);
+  CHECK(first == again);
+  w.set_tier(Resampler::kBest);
+  CHECK(w.tier() == Resampler::kBest);
+  run(w, kOut, 0, kUnity);
+}
+
+}  // namespace
+
+int main() {
+  srand(1);
+  test_matches_resampler();
+  test_band_limited();
+  test_block_split();
+  test_gain_add();
+  test_reset_and_tier();
+  return check_result("test_ym2151_wrap");
+}
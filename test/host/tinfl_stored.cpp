@@ -0,0 +1,84 @@
+// miniz(tinfl) のホスト用代役。deflate の stored ブロック（BTYPE=00）だけを展開する。
+// テストは gzip_stored() で作った .vgz しか読まないので、圧縮ブロックは失敗扱いでよい。
+// 状態は tinfl と同じく呼ぶ側のゼロ埋めしたメモリの中に置き、ポインタは持たない（控えて戻せる）
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr int kFailed = -1;
+constexpr int kDone = 0;
+constexpr int kNeedsMoreInput = 1;
+constexpr int kHasMoreOutput = 2;
+
+struct StoredState {
+  uint32_t stage;    // 0 = ブロック先頭（5バイト）待ち, 1 = 中身, 2 = 完了
+  uint32_t remain;   // 中身の残り
+  uint32_t final_block;
+  uint32_t head_len;
+  uint8_t head[5];
+};
+
+}  // namespace
+
+// 展開したバイト数の累計（ループで先頭から展開し直していないかをテストが見る）
+uint64_t tinfl_stored_output_bytes = 0;
+
+extern "C" {
+
+struct tinfl_decompressor_tag;
+
+int tinfl_decompress(tinfl_decompressor_tag* r, const uint8_t* in, size_t* in_size,
+                     uint8_t* out_start, uint8_t* out_next, size_t* out_size, uint32_t flags) {
+  (void)out_start;
+  (void)flags;
+  StoredState* s = (StoredState*)r;
+  const size_t in_len = *in_size, out_len = *out_size;
+  size_t ip = 0, op = 0;
+  int status = kDone;
+
+  for (;;) {
+    if (s->stage == 2) { status = kDone; break; }
+    if (s->stage == 0) {
+      while (s->head_len < 5 && ip < in_len) s->head[s->head_len++] = in[ip++];
+      if (s->head_len < 5) { status = kNeedsMoreInput; break; }
+      // BFINAL, BTYPE=00 の後はバイト境界から LEN / NLEN
+      const uint32_t len = s->head[1] | (s->head[2] << 8);
+      const uint32_t nlen = s->head[3] | (s->head[4] << 8);
+      if ((s->head[0] & 0x06) != 0 || (len ^ 0xFFFF) != nlen) { status = kFailed; break; }
+      s->final_block = s->head[0] & 1;
+      s->remain = len;
+      s->head_len = 0;
+      s->stage = 1;
+    }
+    size_t k = s->remain;
+    if (k > in_len - ip) k = in_len - ip;
+    if (k > out_len - op) k = out_len - op;
+    memcpy(out_next + op, in + ip, k);
+    ip += k;
+    op += k;
+    s->remain -= (uint32_t)k;
+    if (s->remain == 0) {
+      s->stage = s->final_block ? 2 : 0;
+      continue;
+    }
+    status = (op == out_len) ? kHasMoreOutput : kNeedsMoreInput;
+    break;
+  }
+  *in_size = ip;
+  *out_size = op;
+  tinfl_stored_output_bytes += op;
+  return status;
+}
+
+int tinfl_decompress_mem_to_mem(void* out_buf, size_t out_len, const void* src_buf, size_t src_len, int flags) {
+  (void)flags;
+  StoredState s{};
+  size_t in_size = src_len, out_size = out_len;
+  const int st = tinfl_decompress((tinfl_decompressor_tag*)&s, (const uint8_t*)src_buf, &in_size,
+                                  (uint8_t*)out_buf, (uint8_t*)out_buf, &out_size, 0);
+  return st == kDone ? (int)out_size : -1;
+}
+
+}  // extern "C"